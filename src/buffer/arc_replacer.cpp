@@ -0,0 +1,170 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// arc_replacer.cpp
+//
+// Identification: src/buffer/arc_replacer.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/arc_replacer.h"
+
+#include <algorithm>
+
+namespace bustub {
+
+ARCReplacer::ARCReplacer(size_t num_pages, uint64_t correlated_reference_period)
+    : capacity_(num_pages),
+      correlated_reference_period_(correlated_reference_period),
+      list_type_(num_pages, ListType::NONE),
+      last_access_(num_pages),
+      is_evictable_(num_pages) {}
+
+ARCReplacer::~ARCReplacer() = default;
+
+auto ARCReplacer::Victim(frame_id_t *frame_id) -> bool {
+  std::lock_guard<std::mutex> lck(latch_);
+  EvictableSet *from;
+  if (!t1_.empty() && (t1_size_ > p_ || t2_.empty())) {
+    from = &t1_;
+  } else if (!t2_.empty()) {
+    from = &t2_;
+  } else {
+    return false;
+  }
+  *frame_id = from->begin()->second;
+  from->erase(from->begin());
+  is_evictable_[*frame_id] = false;
+  // The frame stays in its list until RecordEviction, since the buffer pool may still give up on it.
+  return true;
+}
+
+void ARCReplacer::Pin(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lck(latch_);
+  if (is_evictable_[frame_id]) {
+    GetEvictableSet(list_type_[frame_id])->erase({last_access_[frame_id], frame_id});
+    is_evictable_[frame_id] = false;
+  }
+}
+
+void ARCReplacer::Unpin(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lck(latch_);
+  if (is_evictable_[frame_id]) {
+    return;
+  }
+  if (list_type_[frame_id] == ListType::NONE) {
+    // A frame the replacer was never told about is treated like a page referenced once.
+    last_access_[frame_id] = ++current_timestamp_;
+    MoveFrame(frame_id, ListType::T1);
+  }
+  GetEvictableSet(list_type_[frame_id])->insert({last_access_[frame_id], frame_id});
+  is_evictable_[frame_id] = true;
+}
+
+void ARCReplacer::RecordAccess(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lck(latch_);
+  if (list_type_[frame_id] == ListType::NONE) {
+    return;
+  }
+  ++current_timestamp_;
+  // A hit on a resident page makes it frequently used, unless it is correlated with the load of the page.
+  bool in_t1 = list_type_[frame_id] == ListType::T1;
+  if (in_t1 && current_timestamp_ - last_access_[frame_id] < correlated_reference_period_) {
+    return;
+  }
+  bool is_evictable = is_evictable_[frame_id];
+  MoveFrame(frame_id, ListType::NONE);
+  last_access_[frame_id] = current_timestamp_;
+  is_evictable_[frame_id] = is_evictable;
+  MoveFrame(frame_id, ListType::T2);
+}
+
+void ARCReplacer::RecordMiss(frame_id_t frame_id, page_id_t page_id) {
+  std::lock_guard<std::mutex> lck(latch_);
+  MoveFrame(frame_id, ListType::NONE);
+  last_access_[frame_id] = ++current_timestamp_;
+
+  auto it = ghosts_.find(page_id);
+  if (it == ghosts_.end()) {
+    MoveFrame(frame_id, ListType::T1);
+    TrimGhosts();
+    return;
+  }
+  // The page was evicted too early: grow the list it was evicted from, proportionally to how much smaller its ghost
+  // list is than the other one.
+  if (!it->second.in_b2_) {
+    p_ = std::min(capacity_, p_ + std::max<size_t>(b2_.size() / b1_.size(), 1));
+    b1_.erase(it->second.pos_);
+  } else {
+    auto delta = std::max<size_t>(b1_.size() / b2_.size(), 1);
+    p_ = p_ > delta ? p_ - delta : 0;
+    b2_.erase(it->second.pos_);
+  }
+  ghosts_.erase(it);
+  MoveFrame(frame_id, ListType::T2);
+}
+
+void ARCReplacer::RecordEviction(frame_id_t frame_id, page_id_t page_id) {
+  std::lock_guard<std::mutex> lck(latch_);
+  auto list_type = list_type_[frame_id];
+  if (list_type == ListType::NONE) {
+    return;
+  }
+  MoveFrame(frame_id, ListType::NONE);
+  auto *ghost_list = list_type == ListType::T1 ? &b1_ : &b2_;
+  ghosts_[page_id] = {list_type == ListType::T2, ghost_list->insert(ghost_list->end(), page_id)};
+  TrimGhosts();
+}
+
+void ARCReplacer::Remove(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lck(latch_);
+  // A deleted page will not come back, so it leaves no ghost.
+  MoveFrame(frame_id, ListType::NONE);
+}
+
+auto ARCReplacer::Size() -> size_t {
+  std::lock_guard<std::mutex> lck(latch_);
+  return t1_.size() + t2_.size();
+}
+
+void ARCReplacer::MoveFrame(frame_id_t frame_id, ListType list_type) {
+  auto old_list_type = list_type_[frame_id];
+  if (old_list_type != ListType::NONE) {
+    if (is_evictable_[frame_id]) {
+      GetEvictableSet(old_list_type)->erase({last_access_[frame_id], frame_id});
+    }
+    --(old_list_type == ListType::T1 ? t1_size_ : t2_size_);
+  }
+  list_type_[frame_id] = list_type;
+  if (list_type == ListType::NONE) {
+    is_evictable_[frame_id] = false;
+    return;
+  }
+  ++(list_type == ListType::T1 ? t1_size_ : t2_size_);
+  if (is_evictable_[frame_id]) {
+    GetEvictableSet(list_type)->insert({last_access_[frame_id], frame_id});
+  }
+}
+
+void ARCReplacer::SetCapacity(size_t num_frames) {
+  std::lock_guard<std::mutex> lck(latch_);
+  capacity_ = num_frames;
+  p_ = std::min(p_, capacity_);
+  TrimGhosts();
+}
+
+void ARCReplacer::TrimGhosts() {
+  while (!b1_.empty() && t1_size_ + b1_.size() > capacity_) {
+    ghosts_.erase(b1_.front());
+    b1_.pop_front();
+  }
+  while (!b2_.empty() && t1_size_ + t2_size_ + b1_.size() + b2_.size() > 2 * capacity_) {
+    ghosts_.erase(b2_.front());
+    b2_.pop_front();
+  }
+}
+
+}  // namespace bustub
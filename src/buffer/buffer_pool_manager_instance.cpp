@@ -12,147 +12,457 @@
 
 #include "buffer/buffer_pool_manager_instance.h"
 
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#endif
+
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#include "buffer/arc_replacer.h"
+#include "buffer/clock_replacer.h"
+#include "buffer/lru_k_replacer.h"
+#include "buffer/lru_replacer.h"
+#include "common/exception.h"
+#include "common/logger.h"
 #include "common/macros.h"
 
 namespace bustub {
 
 BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager,
-                                                     LogManager *log_manager)
-    : BufferPoolManagerInstance(pool_size, 1, 0, disk_manager, log_manager) {}
+                                                     LogManager *log_manager, ReplacerType replacer_type,
+                                                     size_t max_pool_size)
+    : BufferPoolManagerInstance(pool_size, 1, 0, disk_manager, log_manager, replacer_type, 1, -1, max_pool_size) {}
 
 BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, uint32_t num_instances, uint32_t instance_index,
-                                                     DiskManager *disk_manager, LogManager *log_manager)
+                                                     DiskManager *disk_manager, LogManager *log_manager,
+                                                     ReplacerType replacer_type, uint32_t extent_size, int numa_node,
+                                                     size_t max_pool_size)
     : pool_size_(pool_size),
+      max_pool_size_(std::max(pool_size, max_pool_size)),
       num_instances_(num_instances),
       instance_index_(instance_index),
-      next_page_id_(instance_index),
+      extent_size_(extent_size),
       disk_manager_(disk_manager),
-      log_manager_(log_manager) {
+      log_manager_(log_manager),
+      page_table_(max_pool_size_) {
   BUSTUB_ASSERT(num_instances > 0, "If BPI is not part of a pool, then the pool size should just be 1");
   BUSTUB_ASSERT(
       instance_index < num_instances,
       "BPI index cannot be greater than the number of BPIs in the pool. In non-parallel case, index should just be 1.");
-  // We allocate a consecutive memory space for the buffer pool.
-  pages_ = new Page[pool_size_];
-  replacer_ = new LRUReplacer(pool_size);
-
-  // Initially, every page is in the free list.
-  for (size_t i = 0; i < pool_size_; ++i) {
-    free_list_.emplace_back(static_cast<int>(i));
+  BUSTUB_ASSERT(extent_size > 0, "An extent holds at least one page");
+  next_page_id_ = FirstOwnedPageIdFrom(disk_manager_->GetPageIdBound());
+  // Each instance allocates the free pages it owns from its own partition of the free-space map.
+  disk_manager_->PartitionFreePages(num_instances_, extent_size_);
+  // We allocate a consecutive memory space for the buffer pool, large enough for it to grow to its maximum size.
+  AllocateFrames(numa_node);
+  switch (replacer_type) {
+    case ReplacerType::CLOCK:
+      replacer_ = new ClockReplacer(max_pool_size_);
+      break;
+    case ReplacerType::LRU_K:
+      replacer_ = new LRUKReplacer(max_pool_size_, LRUK_REPLACER_K, LRUK_CORRELATED_REFERENCE_PERIOD);
+      break;
+    case ReplacerType::ARC:
+      replacer_ = new ARCReplacer(max_pool_size_, LRUK_CORRELATED_REFERENCE_PERIOD);
+      break;
+    case ReplacerType::LRU:
+    default:
+      replacer_ = new LRUReplacer(max_pool_size_);
+      break;
+  }
+  replacer_->SetCapacity(pool_size_);
+  io_in_progress_ = std::make_unique<std::atomic<bool>[]>(max_pool_size_);
+  clean_lsns_ = std::make_unique<std::atomic<lsn_t>[]>(max_pool_size_);
+  in_replacer_ = std::make_unique<std::atomic<bool>[]>(max_pool_size_);
+  cleaning_.resize(max_pool_size_, false);
+  hit_pending_ = std::make_unique<std::atomic<bool>[]>(max_pool_size_);
+  hit_queue_ = std::make_unique<std::atomic<frame_id_t>[]>(max_pool_size_);
+
+  // Initially, every page is in the free list, and the frames beyond the pool size are retired.
+  for (size_t i = 0; i < max_pool_size_; ++i) {
+    pages_[i].pin_count_ = FRAME_CLAIMED;
+    io_in_progress_[i] = false;
+    clean_lsns_[i] = INVALID_LSN;
+    in_replacer_[i] = false;
+    hit_pending_[i] = false;
+    hit_queue_[i] = 0;
+    if (i < pool_size_) {
+      free_list_.emplace_back(static_cast<int>(i));
+    }
   }
+  free_frame_count_ = pool_size_.load();
 
-  // printf("basic info: pool size: %d\n num_instances: %d\n, instance_index: %d\n", (int)pool_size, (int)num_instances, (int)instance_index);
+  page_cleaner_thread_ = std::thread(&BufferPoolManagerInstance::RunPageCleaner, this);
 }
 
 BufferPoolManagerInstance::~BufferPoolManagerInstance() {
-  delete[] pages_;
+  {
+    std::unique_lock<std::mutex> io_lck(frame_io_latch_);
+    // Read-ahead completions still need the frames.
+    frame_io_cv_.wait(io_lck, [&] { return read_aheads_in_flight_ == 0; });
+  }
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    stop_page_cleaner_ = true;
+  }
+  page_cleaner_cv_.notify_one();
+  page_cleaner_thread_.join();
+  FreeFrames();
   delete replacer_;
 }
 
 // use the page_id to find the corresponding frame_id
-int BufferPoolManagerInstance::find_frame_id(page_id_t page_id) {
-  // std::lock_guard<std::mutex> lock_guard(latch_);
-  auto it = page_table_.find(page_id);
-  if (it == page_table_.end()) {
-    return -1;
-  }
-
-  return it->second;
-}
+int BufferPoolManagerInstance::find_frame_id(page_id_t page_id) { return page_table_.Find(page_id); }
 
 auto BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) -> bool {
   // Make sure you call DiskManager::WritePage!
-  std::lock_guard<std::mutex> lck(latch_);
-  // printf("flushing %d\n", (int)page_id);
+  if (page_id == INVALID_PAGE_ID) {
+    return false;
+  }
 
-  if (page_id == INVALID_PAGE_ID) return false;
+  std::unique_lock<std::mutex> lck(latch_);
+  // The page cleaner clears the dirty flags of its batch before writing it, and so does a concurrent flush of the same
+  // page, so the page may be clean but not on disk yet; a flush only returns once the page is durable. Only the frame
+  // of the page matters, so a busy cleaner does not hold up flushes of other pages.
+  io_cv_.wait(lck, [&] { return !IsBeingCleaned(page_id) && flushing_pages_.count(page_id) == 0; });
 
   int frame_id = find_frame_id(page_id);
-  if (frame_id == -1) return false;
-
+  if (frame_id == -1) {
+    return false;
+  }
+  // Mapped frames are never claimed while latch_ is held, so the pin always takes. It keeps the page in the frame while
+  // the log is forced and the page written without latch_, and like the page cleaner's it is no access to the page.
+  pages_[frame_id].pin_count_.fetch_add(1);
+  flushing_pages_.insert(page_id);
+  lck.unlock();
+
+  // The frame may still be reading the page in; its contents are not valid until that is done.
+  WaitForFrameIo(frame_id);
   flush_pg(page_id, frame_id);
+  ReleasePin(frame_id);
 
-  // if (pages_[frame_id].is_dirty_ == true){
-  pages_[frame_id].is_dirty_ = false;
-  // }
-
+  lck.lock();
+  flushing_pages_.erase(page_id);
+  io_cv_.notify_all();
   return true;
 }
 
 void BufferPoolManagerInstance::flush_pg(page_id_t page_id, int frame_id) {
-  if (pages_[frame_id].IsDirty()) {
-    disk_manager_->WritePage(page_id, pages_[frame_id].GetData());
+  // The dirty flag is cleared before the write, so that a change made meanwhile marks the page dirty again.
+  auto clean_lsn = GetNextLsn();
+  if (pages_[frame_id].is_dirty_.exchange(false)) {
+    WritePageBack(page_id, frame_id);
+  }
+  // The page is not latched, so only a frame nobody else has pinned certainly had no change in progress.
+  if (pages_[frame_id].pin_count_ == 1) {
+    MarkClean(frame_id, clean_lsn);
   }
-  return;
 }
 
 void BufferPoolManagerInstance::FlushAllPgsImp() {
-  // You can do it!
-  // page_id_t page_id;
-  // printf("flushing all\n");
-
-  for (const auto &page : page_table_) {
-    FlushPage(page.first);
+  std::vector<page_id_t> page_ids;
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    for (size_t i = 0; i < pool_size_; ++i) {
+      if (pages_[i].GetPageId() != INVALID_PAGE_ID) {
+        page_ids.push_back(pages_[i].GetPageId());
+      }
+    }
+  }
+  for (auto page_id : page_ids) {
+    FlushPgImp(page_id);
   }
 }
 
-auto BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) -> Page * {
-  // 0.   Make sure you call AllocatePage!
-  // 1.   If all the pages in the buffer pool are pinned, return nullptr.
-  // 2.   Pick a victim page P from either the free list or the replacer. Always pick from the free list first.
-  // 3.   Update P's metadata, zero out memory and add P to the page table.
-  // 4.   Set the page ID output parameter. Return a pointer to P.
-  std::lock_guard<std::mutex> lck(latch_);
-
-  // printf("new pg imp\n");
+auto BufferPoolManagerInstance::ResizeImp(size_t pool_size) -> bool {
+  if (pool_size == 0 || pool_size > max_pool_size_) {
+    return false;
+  }
+  std::lock_guard<std::mutex> resize_lck(resize_latch_);
+  std::unique_lock<std::mutex> lck(latch_);
+  size_t old_pool_size = pool_size_;
+  if (pool_size >= old_pool_size) {
+    // Retired frames are claimed and empty, just like free ones.
+    for (size_t frame_id = old_pool_size; frame_id < pool_size; ++frame_id) {
+      free_list_.push_back(static_cast<frame_id_t>(frame_id));
+    }
+    free_frame_count_.fetch_add(pool_size - old_pool_size, std::memory_order_relaxed);
+    pool_size_ = pool_size;
+    replacer_->SetCapacity(pool_size);
+    return true;
+  }
 
-  bool all_pinned = true;
-  for (size_t i =0; i<pool_size_; ++i){
-    if (pages_[i].GetPinCount() <= 0){
-      all_pinned = false;
+  // The frames the page cleaner holds are pinned, but only for as long as its batch takes.
+  io_cv_.wait(lck, [&] { return cleaning_frames_ == 0; });
+  std::vector<std::pair<frame_id_t, page_id_t>> write_backs;
+  size_t new_pool_size = old_pool_size;
+  for (; new_pool_size > pool_size; --new_pool_size) {
+    auto frame_id = static_cast<frame_id_t>(new_pool_size - 1);
+    auto free_frame = std::find(free_list_.begin(), free_list_.end(), frame_id);
+    if (free_frame != free_list_.end()) {
+      free_list_.erase(free_frame);
+      free_frame_count_.fetch_sub(1, std::memory_order_relaxed);
+      continue;
+    }
+    // Claimed frames off the free list are only ever claimed under latch_, so the frame is mapped; it can be retired
+    // unless it is pinned.
+    if (!ClaimFrame(frame_id)) {
       break;
     }
+    page_id_t write_back_page_id = INVALID_PAGE_ID;
+    RemoveFromReplacer(frame_id);
+    EvictPage(frame_id, &write_back_page_id);
+    pages_[frame_id].page_id_ = INVALID_PAGE_ID;
+    pages_[frame_id].is_dirty_ = false;
+    pages_[frame_id].rec_lsn_ = INVALID_LSN;
+    if (write_back_page_id != INVALID_PAGE_ID) {
+      write_backs.emplace_back(frame_id, write_back_page_id);
+    }
+  }
+  pool_size_ = new_pool_size;
+  replacer_->SetCapacity(new_pool_size);
+
+  lck.unlock();
+  for (auto &[frame_id, page_id] : write_backs) {
+    WritePageBack(page_id, frame_id);
   }
+  ReleaseFrames(new_pool_size, old_pool_size);
+  lck.lock();
 
-  if (all_pinned){
-    return nullptr;
+  for (auto &[frame_id, page_id] : write_backs) {
+    write_back_pages_.erase(page_id);
   }
+  io_cv_.notify_all();
+  return new_pool_size == pool_size;
+}
 
-  frame_id_t frame_id_;
+auto BufferPoolManagerInstance::ClaimFrame(frame_id_t frame_id) -> bool {
+  int expected = 0;
+  return pages_[frame_id].pin_count_.compare_exchange_strong(expected, FRAME_CLAIMED);
+}
 
-  if (!free_list_.empty()){
-    frame_id_ = free_list_.front();
-    free_list_.pop_front();
-  } else if (replacer_->Victim(&frame_id_)){
-    auto old_page_id_ = pages_[frame_id_].GetPageId();
-    if (pages_[frame_id_].IsDirty()){
-      disk_manager_->WritePage(old_page_id_, pages_[frame_id_].GetData());
-      pages_[frame_id_].is_dirty_ = false;
+auto BufferPoolManagerInstance::TryPin(frame_id_t frame_id, page_id_t page_id) -> bool {
+  Page *page = &pages_[frame_id];
+  int pin_count = page->pin_count_.load();
+  do {
+    if (pin_count < 0) {
+      // The frame is free or being repurposed.
+      return false;
+    }
+  } while (!page->pin_count_.compare_exchange_weak(pin_count, pin_count + 1));
+
+  // Once pinned the frame cannot be claimed, so if it still holds the page it will keep holding it.
+  if (page->GetPageId() != page_id) {
+    ReleasePin(frame_id);
+    return false;
+  }
+  // The replacer is left alone: the frame stays in it while pinned, and the hit is queued for the next miss to apply.
+  // A frame already queued is not queued again, so a hot frame costs no shared write.
+  if (!hit_pending_[frame_id] && !hit_pending_[frame_id].exchange(true)) {
+    auto slot = hit_queue_tail_.fetch_add(1);
+    hit_queue_[slot % max_pool_size_] = frame_id + 1;
+  }
+  return true;
+}
+
+void BufferPoolManagerInstance::ReleasePin(frame_id_t frame_id) {
+  if (pages_[frame_id].pin_count_.fetch_sub(1) == 1) {
+    ReturnToReplacer(frame_id);
+  }
+}
+
+void BufferPoolManagerInstance::ReturnToReplacer(frame_id_t frame_id) {
+  // Checked after the pin was dropped: a Victim that drops the frame from then on finds it unpinned and claims it.
+  if (!in_replacer_[frame_id] && !in_replacer_[frame_id].exchange(true)) {
+    replacer_->Unpin(frame_id);
+  }
+}
+
+void BufferPoolManagerInstance::ApplyHits() {
+  auto tail = hit_queue_tail_.load();
+  for (; hit_queue_head_ < tail; ++hit_queue_head_) {
+    auto *slot = &hit_queue_[hit_queue_head_ % max_pool_size_];
+    frame_id_t entry;
+    // The hitter has taken the slot but may not have filled it in yet.
+    while ((entry = slot->load()) == 0) {
+      std::this_thread::yield();
     }
-    page_table_.erase(old_page_id_);
+    // The slot is free again before the frame can be queued again, so the queue never holds more than one slot per
+    // frame.
+    *slot = 0;
+    hit_pending_[entry - 1] = false;
+    replacer_->RecordAccess(entry - 1);
+  }
+}
+
+void BufferPoolManagerInstance::RemoveFromReplacer(frame_id_t frame_id) {
+  // Hits queued before the frame was claimed belong to the page it is losing.
+  ApplyHits();
+  replacer_->Remove(frame_id);
+  in_replacer_[frame_id] = false;
+}
+
+void BufferPoolManagerInstance::WaitForFrameIo(frame_id_t frame_id) {
+  if (!io_in_progress_[frame_id]) {
+    return;
+  }
+  std::unique_lock<std::mutex> io_lck(frame_io_latch_);
+  frame_io_cv_.wait(io_lck, [&] { return !io_in_progress_[frame_id]; });
+}
+
+auto BufferPoolManagerInstance::ReserveFrame(frame_id_t *frame_id, page_id_t *write_back_page_id,
+                                             BufferAccessStrategy *strategy) -> bool {
+  *write_back_page_id = INVALID_PAGE_ID;
+  // The hits since the last miss come before this one in the replacer's order.
+  ApplyHits();
+  if (strategy != nullptr && ClaimRingFrame(strategy, frame_id)) {
+    // The ring's pages are only of use to the scan that loaded them, so the replacer forgets them without a trace.
+    RemoveFromReplacer(*frame_id);
+    EvictPage(*frame_id, write_back_page_id);
+  } else if (!free_list_.empty()) {
+    *frame_id = free_list_.front();
+    free_list_.pop_front();
+    free_frame_count_.fetch_sub(1, std::memory_order_relaxed);
+  } else if (Victim(frame_id)) {
+    replacer_->RecordEviction(*frame_id, pages_[*frame_id].GetPageId());
+    EvictPage(*frame_id, write_back_page_id);
   } else {
-    return nullptr;
+    return false;
+  }
+
+  io_in_progress_[*frame_id] = true;
+  return true;
+}
+
+auto BufferPoolManagerInstance::MapPage(frame_id_t frame_id, page_id_t page_id) -> Page * {
+  Page *page = &pages_[frame_id];
+  page->page_id_ = page_id;
+  page->is_dirty_ = false;
+  // The frame is claimed, so nothing changes it before it holds the page as it is on disk, or zeroed for a new page.
+  page->rec_lsn_ = INVALID_LSN;
+  clean_lsns_[frame_id] = GetNextLsn();
+  page_table_.Insert(page_id, frame_id);
+  replacer_->RecordMiss(frame_id, page_id);
+  // The frame enters the replacer right away and stays there while it is pinned, so pins need not tell it.
+  in_replacer_[frame_id] = true;
+  replacer_->Unpin(frame_id);
+  // Handing the claimed frame out as pinned makes it visible to lock-free hits, which wait for its I/O to finish.
+  page->pin_count_ = 1;
+  return page;
+}
+
+void BufferPoolManagerInstance::EvictPage(frame_id_t frame_id, page_id_t *write_back_page_id) {
+  auto old_page_id = pages_[frame_id].GetPageId();
+  if (pages_[frame_id].IsDirty()) {
+    // Fetchers of the old page must not read it from disk until the write-back has landed.
+    *write_back_page_id = old_page_id;
+    lsn_t rec_lsn = pages_[frame_id].rec_lsn_;
+    write_back_pages_.emplace(old_page_id, rec_lsn != INVALID_LSN ? rec_lsn : clean_lsns_[frame_id].load());
+    // The cleaner is falling behind if evictions have to write back themselves.
+    page_cleaner_cv_.notify_one();
+  }
+  page_table_.Remove(old_page_id);
+}
+
+auto BufferPoolManagerInstance::ClaimRingFrame(BufferAccessStrategy *strategy, frame_id_t *frame_id) -> bool {
+  auto *ring = strategy->GetRing(instance_index_);
+  if (strategy->ring_size_ == 0 || ring->pages_.size() < strategy->ring_size_) {
+    return false;
+  }
+  auto ring_page_id = ring->pages_[ring->next_];
+  auto ring_frame_id = find_frame_id(ring_page_id);
+  // The page may have been evicted or deleted since, or someone else may be using it; then the ring slot is refilled
+  // from the replacer instead.
+  if (ring_frame_id < 0 || !ClaimFrame(ring_frame_id)) {
+    return false;
+  }
+  *frame_id = ring_frame_id;
+  return true;
+}
+
+void BufferPoolManagerInstance::AddToRing(BufferAccessStrategy *strategy, page_id_t page_id) {
+  auto *ring = strategy->GetRing(instance_index_);
+  if (ring->pages_.size() < strategy->ring_size_) {
+    ring->pages_.push_back(page_id);
+    return;
+  }
+  if (strategy->ring_size_ > 0) {
+    ring->pages_[ring->next_] = page_id;
+    ring->next_ = (ring->next_ + 1) % strategy->ring_size_;
+  }
+}
+
+void BufferPoolManagerInstance::FinishFrameIo(frame_id_t frame_id, page_id_t write_back_page_id) {
+  if (write_back_page_id != INVALID_PAGE_ID) {
+    write_back_pages_.erase(write_back_page_id);
+    io_cv_.notify_all();
   }
+  FinishFrameRead(frame_id);
+}
+
+void BufferPoolManagerInstance::FinishFrameRead(frame_id_t frame_id) {
+  {
+    std::lock_guard<std::mutex> io_lck(frame_io_latch_);
+    io_in_progress_[frame_id] = false;
+  }
+  frame_io_cv_.notify_all();
+}
 
-  replacer_->Pin(frame_id_);
+auto BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) -> Page * {
+  // 0.   Make sure you call AllocatePage!
+  // 1.   If all the pages in the buffer pool are pinned, return nullptr.
+  // 2.   Pick a victim page P from either the free list or the replacer. Always pick from the free list first.
+  // 3.   Update P's metadata, zero out memory and add P to the page table.
+  // 4.   Set the page ID output parameter. Return a pointer to P.
+  // Reusing a free page syncs the free-space map, so it is taken before latch_, and given back if no frame is found.
+  auto free_page_id = disk_manager_->AllocateFreePage(instance_index_);
+  std::unique_lock<std::mutex> lck(latch_);
+
+  // Every unpinned frame is either on the free list or in the replacer, and Victim drops the pinned frames it finds
+  // there until they are unpinned, so ReserveFrame fails in amortized constant time when all the frames are pinned;
+  // there is no need to look at the frames themselves.
+  frame_id_t frame_id;
+  page_id_t write_back_page_id;
+  while (!ReserveFrame(&frame_id, &write_back_page_id)) {
+    if (cleaning_frames_ == 0) {
+      if (free_page_id != INVALID_PAGE_ID) {
+        disk_manager_->DeallocatePage(free_page_id);
+      }
+      return nullptr;
+    }
+    // The only unpinned frames are being written back by the page cleaner; they are evictable once it is done.
+    io_cv_.wait(lck);
+  }
 
-  auto new_page_id_ = AllocatePage();
+  auto new_page_id = free_page_id != INVALID_PAGE_ID ? free_page_id : AllocatePage();
+  *page_id = new_page_id;
 
-  *page_id = new_page_id_;
+  Page *page = MapPage(frame_id, new_page_id);
 
-  memset(pages_[frame_id_].GetData(), 0, PAGE_SIZE);
-  pages_[frame_id_].page_id_ = new_page_id_;
-  pages_[frame_id_].pin_count_ =1;
-  pages_[frame_id_].is_dirty_ = false;
+  // The frame is pinned and marked in flight, so it is safe to write back its old contents and zero it without latch_.
+  lck.unlock();
+  if (write_back_page_id != INVALID_PAGE_ID) {
+    WritePageBack(write_back_page_id, frame_id);
+  }
+  memset(page->GetData(), 0, PAGE_SIZE);
+  lck.lock();
 
-  page_table_.emplace(new_page_id_, frame_id_);
+  FinishFrameIo(frame_id, write_back_page_id);
+  return page;
+}
 
-  // printf("done new paging and the new page id is %d, frame id is %d\n", new_page_id_, frame_id_);
+auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) -> Page * { return PinPage(page_id, nullptr); }
 
-  return &pages_[frame_id_];
+auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) -> Page * {
+  return PinPage(page_id, strategy);
 }
 
-auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) -> Page * {
+auto BufferPoolManagerInstance::PinPage(page_id_t page_id, BufferAccessStrategy *strategy) -> Page * {
   // 1.     Search the page table for the requested page (P).
   // 1.1    If P exists, pin it and return it immediately.
   // 1.2    If P does not exist, find a replacement page (R) from either the free list or the replacer.
@@ -161,45 +471,152 @@ auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) -> Page * {
   // 3.     Delete R from the page table and insert P.
   // 4.     Update P's metadata, read in the page content from disk, and then return a pointer to P.
 
-  std::lock_guard<std::mutex> lck(latch_);
-
-  // printf("fetching page %d\n", page_id);
-  // page_id_t page_id;
-
+  // Fast path: an optimistic lookup and an atomic pin, validated against the frame's page id, without latch_.
   frame_id_t frame_id = find_frame_id(page_id);
-  if (frame_id >= 0) {
-    replacer_->Pin(frame_id);
-    pages_[frame_id].pin_count_++;
-    // printf("fetching: page %d found in the page table\n", page_id);
-    // pages_[frame_id].is_dirty_=true;
+  if (frame_id >= 0 && TryPin(frame_id, page_id)) {
+    WaitForFrameIo(frame_id);
     return &pages_[frame_id];
-  } else {
-    if (!free_list_.empty()){
-      frame_id = free_list_.front();
-      free_list_.pop_front();    
-      // printf("fetching page %d: get from freelist \n", page_id);
-    } else if (replacer_->Victim(&frame_id)) {
-      // printf("fetching page %d: got from lru waitlist, frame id: %d\n", page_id, frame_id);
-      auto old_page_id = pages_[frame_id].GetPageId();
-      if (pages_[frame_id].IsDirty()){
-        disk_manager_->WritePage(old_page_id, pages_[frame_id].GetData());
-        pages_[frame_id].is_dirty_ = false;
-      }
-      page_table_.erase(old_page_id);
-      // pages_[frame_id].is_dirty_ = false;
-    } else{
+  }
+
+  std::unique_lock<std::mutex> lck(latch_);
+  page_id_t write_back_page_id;
+  switch (PinOrMapPage(&lck, page_id, strategy, &frame_id, &write_back_page_id)) {
+    case PinResult::NO_FRAME:
+    case PinResult::WOULD_WAIT:
       return nullptr;
+    case PinResult::HIT:
+      // Pinned first so the frame cannot be evicted, then wait for any read of the page that is still in flight.
+      lck.unlock();
+      WaitForFrameIo(frame_id);
+      return &pages_[frame_id];
+    case PinResult::MISS:
+      break;
+  }
+
+  Page *page = &pages_[frame_id];
+  lck.unlock();
+  if (write_back_page_id != INVALID_PAGE_ID) {
+    WritePageBack(write_back_page_id, frame_id);
+  }
+  disk_manager_->ReadPage(page_id, page->GetData());
+  lck.lock();
+
+  FinishFrameIo(frame_id, write_back_page_id);
+  return page;
+}
+
+auto BufferPoolManagerInstance::PinOrMapPage(std::unique_lock<std::mutex> *lck, page_id_t page_id,
+                                             BufferAccessStrategy *strategy, frame_id_t *frame_id,
+                                             page_id_t *write_back_page_id, bool may_wait) -> PinResult {
+  while (true) {
+    *frame_id = find_frame_id(page_id);
+    // Mapped frames are never claimed while latch_ is held, so pinning a frame found here always succeeds.
+    if (*frame_id >= 0 && TryPin(*frame_id, page_id)) {
+      return PinResult::HIT;
     }
+    // A page that was just evicted cannot be read until its write-back has landed, or the read would see stale data.
+    if (write_back_pages_.count(page_id) == 0) {
+      if (ReserveFrame(frame_id, write_back_page_id, strategy)) {
+        break;
+      }
+      if (cleaning_frames_ == 0) {
+        return PinResult::NO_FRAME;
+      }
+    }
+    if (!may_wait) {
+      return PinResult::WOULD_WAIT;
+    }
+    // Wait for the write-back, or for the page cleaner to hand back the only unpinned frames, and look again.
+    io_cv_.wait(*lck);
+  }
 
-    replacer_->Pin(frame_id);
-    page_table_.emplace(page_id, frame_id);
-    pages_[frame_id].page_id_=page_id;
-    pages_[frame_id].pin_count_++;
-    pages_[frame_id].is_dirty_ = false;
-    disk_manager_->ReadPage(page_id, pages_[frame_id].GetData());
+  if (strategy != nullptr) {
+    AddToRing(strategy, page_id);
+  }
+  MapPage(*frame_id, page_id);
+  return PinResult::MISS;
+}
 
-    return &pages_[frame_id];
+auto BufferPoolManagerInstance::FetchPgsImp(const std::vector<page_id_t> &page_ids) -> std::vector<Page *> {
+  auto batch = BeginFetchPgs(page_ids);
+  if (!batch.miss_frames_.empty()) {
+    disk_manager_->ReadPages(batch.miss_page_ids_, batch.miss_data_);
+  }
+  return EndFetchPgs(&batch);
+}
+
+auto BufferPoolManagerInstance::BeginFetchPgs(const std::vector<page_id_t> &page_ids, bool may_wait) -> FetchBatch {
+  FetchBatch batch;
+  batch.pages_.resize(page_ids.size(), nullptr);
+  std::vector<std::pair<page_id_t, frame_id_t>> write_backs;
+
+  std::unique_lock<std::mutex> lck(latch_);
+  // Write back the victims evicted so far, before the reads overwrite them.
+  auto write_back = [&] {
+    lck.unlock();
+    for (auto &[write_back_page_id, frame_id] : write_backs) {
+      WritePageBack(write_back_page_id, frame_id);
+    }
+    lck.lock();
+    for (auto &[write_back_page_id, frame_id] : write_backs) {
+      write_back_pages_.erase(write_back_page_id);
+    }
+    io_cv_.notify_all();
+    write_backs.clear();
+  };
+
+  // Pin or map every page in one latch acquisition. A page that appears twice is a miss the first time and a hit,
+  // waiting for that same read, the second time.
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    frame_id_t frame_id;
+    page_id_t write_back_page_id;
+    // The batch never waits while it owes write-backs: what it waits for may be a page evicted by itself, or by another
+    // batch that is in turn waiting for one of the victims of this one.
+    auto result =
+        PinOrMapPage(&lck, page_ids[i], nullptr, &frame_id, &write_back_page_id, may_wait && write_backs.empty());
+    if (result == PinResult::WOULD_WAIT && !write_backs.empty()) {
+      write_back();
+      result = PinOrMapPage(&lck, page_ids[i], nullptr, &frame_id, &write_back_page_id, may_wait);
+    }
+    if (result == PinResult::WOULD_WAIT) {
+      batch.wait_page_id_ = page_ids[i];
+      break;
+    }
+    if (result == PinResult::NO_FRAME) {
+      continue;
+    }
+    batch.pages_[i] = &pages_[frame_id];
+    if (result == PinResult::HIT) {
+      batch.hit_frames_.push_back(frame_id);
+      continue;
+    }
+    batch.miss_frames_.push_back(frame_id);
+    batch.miss_page_ids_.push_back(page_ids[i]);
+    batch.miss_data_.push_back(pages_[frame_id].GetData());
+    if (write_back_page_id != INVALID_PAGE_ID) {
+      write_backs.emplace_back(write_back_page_id, frame_id);
+    }
+  }
+  if (!write_backs.empty()) {
+    write_back();
+  }
+  return batch;
+}
+
+void BufferPoolManagerInstance::WaitToFetch(page_id_t page_id) {
+  std::unique_lock<std::mutex> lck(latch_);
+  io_cv_.wait(lck, [&] { return write_back_pages_.count(page_id) == 0 && cleaning_frames_ == 0; });
+}
+
+auto BufferPoolManagerInstance::EndFetchPgs(FetchBatch *batch) -> std::vector<Page *> {
+  for (auto frame_id : batch->miss_frames_) {
+    FinishFrameRead(frame_id);
+  }
+  // Hits may be on pages other fetchers are still reading in.
+  for (auto frame_id : batch->hit_frames_) {
+    WaitForFrameIo(frame_id);
   }
+  return std::move(batch->pages_);
 }
 
 auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
@@ -208,83 +625,394 @@ auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
   // 1.   If P does not exist, return true.
   // 2.   If P exists, but has a non-zero pin-count, return false. Someone is using the page.
   // 3.   Otherwise, P can be deleted. Remove P from the page table, reset its metadata and return it to the free list.
-  std::lock_guard<std::mutex> lck(latch_);
-
-  // printf("deleting\n");
-
+  std::unique_lock<std::mutex> lck(latch_);
 
+  // A page on its way out of the pool is freed once its write-back has landed, or the write could clobber a reuse of
+  // the page id.
+  // Nor is a page the page cleaner has pinned for a write in use.
+  io_cv_.wait(lck, [&] { return write_back_pages_.count(page_id) == 0 && !IsBeingCleaned(page_id); });
   frame_id_t frame_id = find_frame_id(page_id);
   if (frame_id < 0) {
+    DeallocatePage(page_id);
     return true;
-  } else if (frame_id >= 0) {
-    if (pages_[frame_id].GetPinCount() > 0) {
+  }
+  // Frames with I/O in flight are always pinned, so they are rejected here as well.
+  if (!ClaimFrame(frame_id)) {
+    return false;
+  }
+
+  // The page is going away, so there is no point in writing its contents back.
+  page_table_.Remove(page_id);
+  RemoveFromReplacer(frame_id);
+  pages_[frame_id].page_id_ = INVALID_PAGE_ID;
+  pages_[frame_id].is_dirty_ = false;
+  pages_[frame_id].rec_lsn_ = INVALID_LSN;
+  DeallocatePage(page_id);
+
+  memset(pages_[frame_id].GetData(), 0, PAGE_SIZE);
+  // The frame stays claimed while it is on the free list.
+  free_list_.push_back(frame_id);
+  free_frame_count_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+auto BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) -> bool {
+  // The caller holds a pin, so the frame keeps its page and the lock-free lookup can be trusted once validated. It may
+  // only miss while a concurrent removal is shifting entries around, in which case the latched lookup settles it.
+  auto frame_id = find_frame_id(page_id);
+  if (frame_id < 0 || pages_[frame_id].GetPageId() != page_id) {
+    std::lock_guard<std::mutex> lck(latch_);
+    frame_id = find_frame_id(page_id);
+    if (frame_id < 0) {
       return false;
     }
+  }
 
-    // flush the content
-    if (pages_[frame_id].IsDirty()){
-      disk_manager_->WritePage(page_id, pages_[frame_id].GetData());
+  Page *page = &pages_[frame_id];
+  int pin_count = page->pin_count_.load();
+  if (pin_count <= 0) {
+    return false;
+  }
+  // Dirty frames stay dirty until they are evicted or the page cleaner writes them back. The flag is set once the page
+  // is known to be pinned, and before the pin is dropped, so whoever claims or cleans the frame next is guaranteed to
+  // see it.
+  if (is_dirty) {
+    page->is_dirty_ = true;
+    // A logged change has set the recLSN already. One that was not, or whose recLSN a write-back racing with it reset,
+    // is no older than the frame's clean LSN.
+    lsn_t rec_lsn = INVALID_LSN;
+    page->rec_lsn_.compare_exchange_strong(rec_lsn, clean_lsns_[frame_id]);
+  }
+  while (!page->pin_count_.compare_exchange_weak(pin_count, pin_count - 1)) {
+    if (pin_count <= 0) {
+      return false;
     }
-    // remove it fron the page table
-    page_table_.erase(page_id);
-    // reset metadata
-    pages_[frame_id].page_id_ = INVALID_PAGE_ID;
-    pages_[frame_id].is_dirty_ = false;
-    pages_[frame_id].pin_count_ = 0;
-    DeallocatePage(page_id);
+  }
 
-    memset(pages_[frame_id].GetData(), 0, PAGE_SIZE);
-    // return it to the free list;
-    free_list_.push_back(frame_id);
-    return true;
+  if (pin_count == 1) {
+    ReturnToReplacer(frame_id);
+  }
+  return true;
+}
+
+auto BufferPoolManagerInstance::Victim(frame_id_t *frame_id) -> bool {
+  while (replacer_->Victim(frame_id)) {
+    // Frames stay in the replacer while they are pinned, so it may hand out pinned ones. They are dropped and given
+    // back to the replacer when their last pin is released.
+    in_replacer_[*frame_id] = false;
+    if (ClaimFrame(*frame_id)) {
+      return true;
+    }
   }
   return false;
 }
 
-auto BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) -> bool {
-  std::lock_guard<std::mutex> lck(latch_);
+auto BufferPoolManagerInstance::PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) -> bool {
+  // A page that is resident already needs no read; the check is only a hint, so it takes no latch.
+  frame_id_t frame_id = find_frame_id(page_id);
+  if (frame_id >= 0) {
+    return !io_in_progress_[frame_id];
+  }
 
-  // printf("unpinning %d\n", page_id);
+  page_id_t write_back_page_id;
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    // Only pages this instance has allocated exist on disk, and a page being written back is read after the write.
+    if (!OwnsPageId(page_id) || page_id >= next_page_id_ || find_frame_id(page_id) >= 0 ||
+        write_back_pages_.count(page_id) > 0) {
+      return false;
+    }
+    // Read-ahead is only a hint, so it never waits for a frame.
+    if (!ReserveFrame(&frame_id, &write_back_page_id, strategy)) {
+      return false;
+    }
+    AddToRing(strategy, page_id);
+    MapPage(frame_id, page_id);
+    std::lock_guard<std::mutex> io_lck(frame_io_latch_);
+    ++read_aheads_in_flight_;
+  }
 
-  // printf("finding\n");
-  auto frame_id = find_frame_id(page_id);
-  // printf("return from find\n");
-  // printf("the frame id found: %d\n", frame_id);
+  // The old contents of the frame must reach the disk before the read overwrites them. The reader writes them back
+  // itself, which is rare since the page cleaner keeps victims clean.
+  if (write_back_page_id != INVALID_PAGE_ID) {
+    WritePageBack(write_back_page_id, frame_id);
+    std::lock_guard<std::mutex> lck(latch_);
+    write_back_pages_.erase(write_back_page_id);
+    io_cv_.notify_all();
+  }
+  // The read completes on an I/O thread of the disk manager, which must not wait for latch_: the I/O of whoever holds
+  // it may complete on the same thread.
+  std::vector<PageIoRequest> requests;
+  requests.push_back({false, page_id, pages_[frame_id].GetData(), [this, frame_id] {
+                        FinishFrameRead(frame_id);
+                        // Nobody asked for the page yet; it stays resident but evictable until the reader gets to it.
+                        ReleasePin(frame_id);
+                        std::lock_guard<std::mutex> io_lck(frame_io_latch_);
+                        --read_aheads_in_flight_;
+                        frame_io_cv_.notify_all();
+                      }});
+  disk_manager_->SubmitPageIo(&requests);
+  return false;
+}
 
-  if (frame_id < 0 || pages_[frame_id].pin_count_ <= 0) {
-    // printf("test failed\n");
-    return false;
+void BufferPoolManagerInstance::RunPageCleaner() {
+  std::unique_lock<std::mutex> lck(latch_);
+  while (!stop_page_cleaner_) {
+    page_cleaner_cv_.wait_for(lck, page_cleaner_interval);
+    if (stop_page_cleaner_) {
+      break;
+    }
+    CleanPages(&lck);
   }
+}
 
-  // printf("check done\n");
-  if (pages_[frame_id].pin_count_<=0){
-    return false;
+auto BufferPoolManagerInstance::CleanPages(std::unique_lock<std::mutex> *lck) -> size_t {
+  std::vector<frame_id_t> batch;
+  for (size_t i = 0; i < pool_size_ && batch.size() < static_cast<size_t>(PAGE_CLEANER_BATCH_SIZE); ++i) {
+    auto frame_id = static_cast<frame_id_t>((page_cleaner_hand_ + i) % pool_size_);
+    Page *page = &pages_[frame_id];
+    if (!page->is_dirty_ || io_in_progress_[frame_id]) {
+      continue;
+    }
+    // Pin the frame without taking it out of the replacer so that cleaning does not change its eviction order.
+    int expected = 0;
+    if (page->pin_count_.compare_exchange_strong(expected, 1)) {
+      cleaning_[frame_id] = true;
+      batch.push_back(frame_id);
+    }
+  }
+  page_cleaner_hand_ = batch.empty() ? 0 : (batch.back() + 1) % pool_size_;
+  if (batch.empty()) {
+    return 0;
   }
 
-  if (--pages_[frame_id].pin_count_ == 0) {
-    replacer_->Unpin(frame_id);
-    if (pages_[frame_id].is_dirty_){
-      disk_manager_->WritePage(page_id, pages_[frame_id].GetData());
+  // Write the batch in page order, so that it reaches the disk as sequentially as possible.
+  std::sort(batch.begin(), batch.end(),
+            [&](frame_id_t a, frame_id_t b) { return pages_[a].GetPageId() < pages_[b].GetPageId(); });
+  cleaning_frames_ = batch.size();
+  lck->unlock();
+  // The whole batch is in flight at once; each frame is released, and handed back under latch_, as soon as its own
+  // write completes.
+  std::mutex done_latch;
+  std::condition_variable done_cv;
+  std::vector<frame_id_t> done;
+  auto release = [&](frame_id_t frame_id) {
+    ReleasePin(frame_id);
+    {
+      std::lock_guard<std::mutex> done_lck(done_latch);
+      done.push_back(frame_id);
+    }
+    done_cv.notify_one();
+  };
+  size_t written = 0;
+  std::vector<PageIoRequest> requests;
+  requests.reserve(batch.size());
+  for (auto frame_id : batch) {
+    Page *page = &pages_[frame_id];
+    // A fetcher may be modifying the page concurrently; the read latch, held until the write completes, makes sure a
+    // consistent image is written. The cleaner holds frames that misses wait for, so it never waits for a latch:
+    // whoever has it may be one of them. The page stays dirty for the next pass.
+    if (!page->TryRLatch()) {
+      release(frame_id);
+      continue;
     }
+    // The flag is cleared once changes are kept out; a change made before dirties the page again, at worst.
+    page->is_dirty_ = false;
+    ForceLog(frame_id);
+    ++written;
+    requests.push_back({true, page->GetPageId(), page->GetData(), [&, page, frame_id] {
+                          // The read latch kept changes out since the image was taken.
+                          MarkClean(frame_id, GetNextLsn());
+                          page->RUnlatch();
+                          release(frame_id);
+                        }});
+  }
+  if (!requests.empty()) {
+    disk_manager_->SubmitPageIo(&requests);
+  }
+  for (size_t remaining = batch.size(); remaining > 0;) {
+    std::vector<frame_id_t> released;
+    {
+      std::unique_lock<std::mutex> done_lck(done_latch);
+      done_cv.wait(done_lck, [&] { return !done.empty(); });
+      released.swap(done);
+    }
+    remaining -= released.size();
+    lck->lock();
+    for (auto frame_id : released) {
+      cleaning_[frame_id] = false;
+    }
+    cleaning_frames_ -= released.size();
+    io_cv_.notify_all();
+    lck->unlock();
+  }
+  lck->lock();
+  return written;
+}
 
+auto BufferPoolManagerInstance::IsBeingCleaned(page_id_t page_id) -> bool {
+  frame_id_t frame_id = find_frame_id(page_id);
+  return frame_id >= 0 && cleaning_[frame_id];
+}
 
+void BufferPoolManagerInstance::MarkClean(frame_id_t frame_id, lsn_t clean_lsn) {
+  clean_lsns_[frame_id] = clean_lsn;
+  // A page dirtied again while it was written keeps the recLSN it had, which is older than any change it holds.
+  if (!pages_[frame_id].is_dirty_) {
+    pages_[frame_id].rec_lsn_ = INVALID_LSN;
   }
+}
 
-  pages_[frame_id].is_dirty_ = is_dirty;
-  // printf("done setting the is dirty bit to %d\n", is_dirty);
-  // printf("done unpinning\n");
-  return true;
+auto BufferPoolManagerInstance::GetDirtyPageTableImp() -> std::unordered_map<page_id_t, lsn_t> {
+  std::lock_guard<std::mutex> lck(latch_);
+  std::unordered_map<page_id_t, lsn_t> dirty_page_table(write_back_pages_);
+  for (size_t i = 0; i < pool_size_; ++i) {
+    Page *page = &pages_[i];
+    auto page_id = page->GetPageId();
+    // Frames that are claimed under latch_ are free.
+    if (page_id == INVALID_PAGE_ID || page->pin_count_ < 0) {
+      continue;
+    }
+    lsn_t rec_lsn = page->rec_lsn_;
+    if (rec_lsn != INVALID_LSN) {
+      dirty_page_table[page_id] = rec_lsn;
+    } else if (page->pin_count_ > 0) {
+      // A change to a pinned page may be logged already without having set the page LSN yet.
+      dirty_page_table[page_id] = clean_lsns_[i];
+    }
+  }
+  return dirty_page_table;
+}
+
+void BufferPoolManagerInstance::WritePageBack(page_id_t page_id, frame_id_t frame_id) {
+  ForceLog(frame_id);
+  disk_manager_->WritePage(page_id, pages_[frame_id].GetData());
+}
+
+void BufferPoolManagerInstance::ForceLog(frame_id_t frame_id) {
+  // Recovery logs the changes it undoes before logging is enabled, so the log is forced whenever there is one.
+  if (log_manager_ == nullptr) {
+    return;
+  }
+  // The frame's book-keeping has the LSN of the last logged change; pages without logged changes never have one.
+  lsn_t lsn = pages_[frame_id].lsn_;
+  if (lsn != INVALID_LSN && lsn > log_manager_->GetPersistentLSN()) {
+    log_manager_->GetDurableFuture(lsn).wait();
+  }
 }
 
 auto BufferPoolManagerInstance::AllocatePage() -> page_id_t {
   const page_id_t next_page_id = next_page_id_;
-  next_page_id_ += num_instances_;
+  next_page_id_ = NextOwnedPageId(next_page_id);
   ValidatePageId(next_page_id);
   return next_page_id;
 }
 
+void BufferPoolManagerInstance::DeallocatePage(page_id_t page_id) {
+  // Ids that were never handed out must stay out of the free-space map, or they would be allocated twice.
+  if (page_id >= 0 && page_id < next_page_id_) {
+    disk_manager_->DeallocatePage(page_id);
+  }
+}
+
+auto BufferPoolManagerInstance::FirstOwnedPageIdFrom(page_id_t page_id) const -> page_id_t {
+  const auto stride = static_cast<page_id_t>(extent_size_ * num_instances_);
+  const auto extent_start = page_id / stride * stride + static_cast<page_id_t>(instance_index_ * extent_size_);
+  if (page_id <= extent_start) {
+    return extent_start;
+  }
+  if (page_id < extent_start + static_cast<page_id_t>(extent_size_)) {
+    return page_id;
+  }
+  return extent_start + stride;
+}
+
 void BufferPoolManagerInstance::ValidatePageId(const page_id_t page_id) const {
-  assert(page_id % num_instances_ == instance_index_);  // allocated pages mod back to this BPI
+  assert(OwnsPageId(page_id));  // allocated pages map back to this BPI
+}
+
+auto BufferPoolManagerInstance::NextOwnedPageId(page_id_t page_id) const -> page_id_t {
+  // Within an extent the pages are consecutive; past its end, the extents of the other BPIs are skipped.
+  if ((page_id + 1) % extent_size_ != 0) {
+    return page_id + 1;
+  }
+  return page_id + 1 + static_cast<page_id_t>((num_instances_ - 1) * extent_size_);
+}
+
+void BufferPoolManagerInstance::AllocateFrames(int numa_node) {
+  frames_size_ = (max_pool_size_ * PAGE_SIZE + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  void *frames = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  frames = mmap(nullptr, frames_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  frames_huge_ = frames != MAP_FAILED;
+#endif
+  if (frames == MAP_FAILED) {
+    // No huge pages are reserved, so fall back to normal pages and ask for transparent huge pages instead.
+    frames = mmap(nullptr, frames_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (frames == MAP_FAILED) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "could not map the buffer pool frames");
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(frames, frames_size_, MADV_HUGEPAGE);
+#endif
+  }
+  BindToNode(frames, frames_size_, numa_node);
+  // Anonymous mappings are zeroed, so the frames start out as empty pages. They are also page aligned, so every frame
+  // meets the alignment O_DIRECT requires and is read and written in place.
+  static_assert(PAGE_SIZE % DIRECT_IO_ALIGNMENT == 0, "frames must stay aligned for O_DIRECT");
+  frames_ = static_cast<char *>(frames);
+
+  // The book-keeping of the pages is touched by every access, so it lives on the same node as the frames.
+  auto system_page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  pages_size_ = (max_pool_size_ * sizeof(Page) + system_page_size - 1) / system_page_size * system_page_size;
+  void *pages = mmap(nullptr, pages_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (pages == MAP_FAILED) {
+    munmap(frames_, frames_size_);
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "could not map the buffer pool pages");
+  }
+  BindToNode(pages, pages_size_, numa_node);
+  pages_ = static_cast<Page *>(pages);
+  for (size_t i = 0; i < max_pool_size_; ++i) {
+    new (&pages_[i]) Page();
+    pages_[i].data_ = frames_ + i * PAGE_SIZE;
+  }
+}
+
+void BufferPoolManagerInstance::BindToNode(void *memory, size_t size, int numa_node) {
+#ifdef __linux__
+  // The policy has to be in place before anything first touches the memory.
+  if (numa_node < 0) {
+    return;
+  }
+  constexpr size_t mask_bits = sizeof(unsigned long) * 8;  // NOLINT
+  std::vector<unsigned long> node_mask(numa_node / mask_bits + 1, 0);  // NOLINT
+  node_mask[numa_node / mask_bits] = 1UL << (numa_node % mask_bits);
+  if (syscall(SYS_mbind, memory, size, MPOL_BIND, node_mask.data(), node_mask.size() * mask_bits, 0) != 0) {
+    LOG_WARN("could not bind buffer pool memory to NUMA node %d", numa_node);
+  }
+#endif
+}
+
+void BufferPoolManagerInstance::ReleaseFrames(size_t begin_frame, size_t end_frame) {
+  size_t begin = begin_frame * PAGE_SIZE;
+  size_t end = end_frame * PAGE_SIZE;
+  if (frames_huge_) {
+    // Reserved huge pages are only released whole, so the huge page the first retired frame shares with frames still
+    // in use keeps its memory. The frames past end_frame were retired before, so the huge page of the last one goes.
+    begin = (begin + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    end = (end + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  }
+  if (begin < end) {
+    madvise(frames_ + begin, end - begin, MADV_DONTNEED);
+  }
+}
+
+void BufferPoolManagerInstance::FreeFrames() {
+  for (size_t i = 0; i < max_pool_size_; ++i) {
+    pages_[i].~Page();
+  }
+  munmap(pages_, pages_size_);
+  munmap(frames_, frames_size_);
 }
 
 }  // namespace bustub
@@ -12,18 +12,60 @@
 
 #include "buffer/clock_replacer.h"
 
+#include <algorithm>
+
 namespace bustub {
 
-ClockReplacer::ClockReplacer(size_t num_pages) {}
+ClockReplacer::ClockReplacer(size_t num_pages)
+    : num_pages_(num_pages),
+      in_replacer_(std::make_unique<std::atomic<bool>[]>(num_pages)),
+      ref_(std::make_unique<std::atomic<bool>[]>(num_pages)) {
+  for (size_t i = 0; i < num_pages_; ++i) {
+    in_replacer_[i] = false;
+    ref_[i] = false;
+  }
+}
 
 ClockReplacer::~ClockReplacer() = default;
 
-auto ClockReplacer::Victim(frame_id_t *frame_id) -> bool { return false; }
+auto ClockReplacer::Victim(frame_id_t *frame_id) -> bool {
+  std::lock_guard<std::mutex> lck(latch_);
+  // Every frame in the replacer is evicted by the end of the second sweep at the latest. The size is only a hint while
+  // pins and unpins race with the sweep, so a sweep that finds nothing in two passes gives up, as if it were empty.
+  for (size_t steps = 0; steps < 2 * num_pages_ && size_ > 0; ++steps) {
+    auto frame = static_cast<frame_id_t>(hand_);
+    hand_ = (hand_ + 1) % num_pages_;
+    if (!in_replacer_[frame]) {
+      continue;
+    }
+    if (ref_[frame].exchange(false)) {
+      continue;
+    }
+    // A concurrent Pin may have taken the frame out since the check above; whoever clears the flag owns the removal.
+    if (in_replacer_[frame].exchange(false)) {
+      --size_;
+      *frame_id = frame;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ClockReplacer::Pin(frame_id_t frame_id) {
+  if (in_replacer_[frame_id].exchange(false)) {
+    --size_;
+  }
+}
 
-void ClockReplacer::Pin(frame_id_t frame_id) {}
+void ClockReplacer::Unpin(frame_id_t frame_id) {
+  ref_[frame_id] = true;
+  if (!in_replacer_[frame_id].exchange(true)) {
+    ++size_;
+  }
+}
 
-void ClockReplacer::Unpin(frame_id_t frame_id) {}
+void ClockReplacer::RecordAccess(frame_id_t frame_id) { ref_[frame_id] = true; }
 
-auto ClockReplacer::Size() -> size_t { return 0; }
+auto ClockReplacer::Size() -> size_t { return static_cast<size_t>(std::max<int64_t>(size_, 0)); }
 
 }  // namespace bustub
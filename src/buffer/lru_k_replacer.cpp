@@ -0,0 +1,116 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer.cpp
+//
+// Identification: src/buffer/lru_k_replacer.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/lru_k_replacer.h"
+
+#include "common/macros.h"
+
+namespace bustub {
+
+LRUKReplacer::LRUKReplacer(size_t num_pages, size_t k, uint64_t correlated_reference_period)
+    : k_(k),
+      correlated_reference_period_(correlated_reference_period),
+      history_(num_pages * k),
+      history_start_(num_pages),
+      history_size_(num_pages),
+      is_evictable_(num_pages) {
+  BUSTUB_ASSERT(k > 0, "LRU-K needs to remember at least one reference per frame");
+}
+
+LRUKReplacer::~LRUKReplacer() = default;
+
+auto LRUKReplacer::Victim(frame_id_t *frame_id) -> bool {
+  std::lock_guard<std::mutex> lck(latch_);
+  if (evictable_.empty()) {
+    return false;
+  }
+  *frame_id = std::get<2>(*evictable_.begin());
+  evictable_.erase(evictable_.begin());
+  is_evictable_[*frame_id] = false;
+  // The history stays until RecordEviction, since the buffer pool may still give up on the victim.
+  return true;
+}
+
+void LRUKReplacer::Pin(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lck(latch_);
+  if (is_evictable_[frame_id]) {
+    evictable_.erase(GetEvictionKey(frame_id));
+    is_evictable_[frame_id] = false;
+  }
+}
+
+void LRUKReplacer::Unpin(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lck(latch_);
+  if (!is_evictable_[frame_id]) {
+    evictable_.insert(GetEvictionKey(frame_id));
+    is_evictable_[frame_id] = true;
+  }
+}
+
+void LRUKReplacer::RecordAccess(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lck(latch_);
+  ++current_timestamp_;
+  // Accessed frames are normally pinned, but the ranking of an evictable one has to be kept in sync with its history.
+  if (is_evictable_[frame_id]) {
+    evictable_.erase(GetEvictionKey(frame_id));
+  }
+
+  auto start = history_start_[frame_id];
+  auto size = history_size_[frame_id];
+  auto *history = &history_[frame_id * k_];
+  if (size > 0 && current_timestamp_ - GetReference(frame_id, size - 1) < correlated_reference_period_) {
+    history[(start + size - 1) % k_] = current_timestamp_;
+  } else if (size < k_) {
+    history[(start + size) % k_] = current_timestamp_;
+    history_size_[frame_id] = size + 1;
+  } else {
+    // Overwrite the oldest reference, which is no longer among the last K.
+    history[start] = current_timestamp_;
+    history_start_[frame_id] = (start + 1) % k_;
+  }
+
+  if (is_evictable_[frame_id]) {
+    evictable_.insert(GetEvictionKey(frame_id));
+  }
+}
+
+void LRUKReplacer::RecordEviction(frame_id_t frame_id, page_id_t page_id) {
+  // The frame is about to hold another page, whose history starts from scratch.
+  Remove(frame_id);
+}
+
+void LRUKReplacer::Remove(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lck(latch_);
+  // The key depends on the history, so it is erased before the history is reset.
+  if (is_evictable_[frame_id]) {
+    evictable_.erase(GetEvictionKey(frame_id));
+    is_evictable_[frame_id] = false;
+  }
+  history_size_[frame_id] = 0;
+}
+
+auto LRUKReplacer::Size() -> size_t {
+  std::lock_guard<std::mutex> lck(latch_);
+  return evictable_.size();
+}
+
+auto LRUKReplacer::GetEvictionKey(frame_id_t frame_id) const -> EvictionKey {
+  auto size = history_size_[frame_id];
+  // With K references the oldest one is the K-th most recent; with fewer it is the earliest reference.
+  return {size == k_, size > 0 ? GetReference(frame_id, 0) : 0, frame_id};
+}
+
+auto LRUKReplacer::GetReference(frame_id_t frame_id, size_t i) const -> uint64_t {
+  return history_[frame_id * k_ + (history_start_[frame_id] + i) % k_];
+}
+
+}  // namespace bustub
@@ -108,6 +108,15 @@ void LRUReplacer::Unpin(frame_id_t frame_id) {
   page2iter_[frame_id] = wait_list_.begin();
 }
 
+void LRUReplacer::RecordAccess(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lock_guard(latch_);
+  // The buffer pool leaves pinned frames in the replacer, so an access makes the frame the most recently used.
+  if (!IsInReplacer(frame_id)) {
+    return;
+  }
+  wait_list_.splice(wait_list_.begin(), wait_list_, page2iter_[frame_id]);
+}
+
 size_t LRUReplacer::Size() {
   std::lock_guard<std::mutex> lock_guard(latch_);
   return wait_list_.size();
@@ -0,0 +1,85 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_table.cpp
+//
+// Identification: src/buffer/page_table.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/page_table.h"
+
+namespace bustub {
+
+PageTable::PageTable(size_t num_frames) : num_slots_(2), shift_(63) {
+  while (num_slots_ < 2 * num_frames) {
+    num_slots_ <<= 1;
+    shift_--;
+  }
+  slots_ = std::make_unique<std::atomic<uint64_t>[]>(num_slots_);
+  for (size_t i = 0; i < num_slots_; i++) {
+    slots_[i].store(EMPTY_SLOT, std::memory_order_relaxed);
+  }
+}
+
+auto PageTable::Find(page_id_t page_id) const -> frame_id_t {
+  size_t mask = num_slots_ - 1;
+  for (size_t i = Home(page_id), probes = 0; probes < num_slots_; i = (i + 1) & mask, probes++) {
+    uint64_t slot = slots_[i].load(std::memory_order_acquire);
+    if (slot == EMPTY_SLOT) {
+      return -1;
+    }
+    if (PageOf(slot) == page_id) {
+      return FrameOf(slot);
+    }
+  }
+  return -1;
+}
+
+void PageTable::Insert(page_id_t page_id, frame_id_t frame_id) {
+  size_t mask = num_slots_ - 1;
+  size_t i = Home(page_id);
+  while (slots_[i].load(std::memory_order_relaxed) != EMPTY_SLOT) {
+    BUSTUB_ASSERT(PageOf(slots_[i].load(std::memory_order_relaxed)) != page_id, "page is already mapped");
+    i = (i + 1) & mask;
+  }
+  slots_[i].store(Pack(page_id, frame_id), std::memory_order_release);
+}
+
+auto PageTable::Remove(page_id_t page_id) -> bool {
+  size_t mask = num_slots_ - 1;
+  size_t hole = Home(page_id);
+  while (true) {
+    uint64_t slot = slots_[hole].load(std::memory_order_relaxed);
+    if (slot == EMPTY_SLOT) {
+      return false;
+    }
+    if (PageOf(slot) == page_id) {
+      break;
+    }
+    hole = (hole + 1) & mask;
+  }
+
+  // Backward shift deletion: pull every following entry of the cluster that may live at the hole into it, so that no
+  // tombstones build up as pages come and go.
+  for (size_t next = (hole + 1) & mask;; next = (next + 1) & mask) {
+    uint64_t slot = slots_[next].load(std::memory_order_relaxed);
+    if (slot == EMPTY_SLOT) {
+      break;
+    }
+    size_t home = Home(PageOf(slot));
+    // The entry has to stay where it is if its home lies cyclically in (hole, next].
+    bool stays = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+    if (!stays) {
+      slots_[hole].store(slot, std::memory_order_release);
+      hole = next;
+    }
+  }
+  slots_[hole].store(EMPTY_SLOT, std::memory_order_release);
+  return true;
+}
+
+}  // namespace bustub
@@ -15,26 +15,27 @@
 namespace bustub {
 
 ParallelBufferPoolManager::ParallelBufferPoolManager(size_t num_instances, size_t pool_size, DiskManager *disk_manager,
-                                                     LogManager *log_manager)
-    : num_instances_(num_instances) {
+                                                     LogManager *log_manager, ReplacerType replacer_type,
+                                                     PartitionMode partition_mode, size_t numa_nodes,
+                                                     size_t max_pool_size)
+    : num_instances_(num_instances),
+      partition_mode_(partition_mode),
+      extent_size_(partition_mode == PartitionMode::EXTENT ? PARTITION_EXTENT_SIZE : 1),
+      disk_manager_(disk_manager) {
   // Allocate and create individual BufferPoolManagerInstances
-  BufferPoolManagerInstance *buffer_pool_manager_;
-
   for (size_t i = 0; i < num_instances; i++) {
-    buffer_pool_manager_ = new BufferPoolManagerInstance(pool_size, num_instances, i, disk_manager, log_manager);
-    managers_.push_back(buffer_pool_manager_);
+    // Instances are dealt out over the nodes, so that each node serves an equal share of the page id space.
+    int numa_node = numa_nodes > 0 ? static_cast<int>(i % numa_nodes) : -1;
+    managers_.push_back(new BufferPoolManagerInstance(pool_size, num_instances, i, disk_manager, log_manager,
+                                                      replacer_type, extent_size_, numa_node, max_pool_size));
   }
 }
 
 // Update constructor to destruct all BufferPoolManagerInstances and deallocate any associated memory
 ParallelBufferPoolManager::~ParallelBufferPoolManager() {
-  // printf("destructing...\n");
-  for (size_t i =0; i < num_instances_; i++){
-    delete managers_[i];
+  for (auto *manager : managers_) {
+    delete manager;
   }
-  // printf("done destructing each manager instance\n");
-  // delete &managers_;
-  // printf("done destructing all \n");
 }
 
 auto ParallelBufferPoolManager::GetPoolSize() -> size_t {
@@ -44,60 +45,128 @@ auto ParallelBufferPoolManager::GetPoolSize() -> size_t {
 
 auto ParallelBufferPoolManager::GetBufferPoolManager(page_id_t page_id) -> BufferPoolManager * {
   // Get BufferPoolManager responsible for handling given page id. You can use this method in your other methods.
-  return managers_[page_id % num_instances_];
-  // return nullptr;
+  return managers_[GetInstanceIndex(page_id)];
 }
 
 auto ParallelBufferPoolManager::FetchPgImp(page_id_t page_id) -> Page * {
   // Fetch page for page_id from responsible BufferPoolManagerInstance
-  BufferPoolManager *manager_;
-  manager_ = GetBufferPoolManager(page_id);
-  return manager_->FetchPage(page_id);
-  return nullptr;
+  return GetBufferPoolManager(page_id)->FetchPage(page_id);
+}
+
+auto ParallelBufferPoolManager::FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) -> Page * {
+  // Each instance keeps its own ring in the strategy.
+  return GetBufferPoolManager(page_id)->FetchPage(page_id, strategy);
+}
+
+auto ParallelBufferPoolManager::PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) -> bool {
+  return GetBufferPoolManager(page_id)->PrefetchPage(page_id, strategy);
+}
+
+auto ParallelBufferPoolManager::FetchPgsImp(const std::vector<page_id_t> &page_ids) -> std::vector<Page *> {
+  // Split the batch by owning instance, remembering where each page goes in the result.
+  std::vector<std::vector<page_id_t>> instance_page_ids(num_instances_);
+  std::vector<std::vector<size_t>> instance_positions(num_instances_);
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    auto instance = GetInstanceIndex(page_ids[i]);
+    instance_page_ids[instance].push_back(page_ids[i]);
+    instance_positions[instance].push_back(i);
+  }
+
+  // Pin or map the pages in each instance in turn, then read the misses of all the instances as one batch, which the
+  // disk manager keeps in flight together. An instance that would have to wait for a page stops there instead: the
+  // pages pinned so far are read in and released, so that no frame stays pinned on another instance while the batch
+  // waits, and the whole batch starts over once the page may be fetched.
+  std::vector<Page *> pages(page_ids.size(), nullptr);
+  while (true) {
+    std::vector<BufferPoolManagerInstance::FetchBatch> batches(num_instances_);
+    std::vector<page_id_t> miss_page_ids;
+    std::vector<char *> miss_data;
+    size_t wait_instance = num_instances_;
+    for (size_t instance = 0; instance < num_instances_ && wait_instance == num_instances_; ++instance) {
+      if (instance_page_ids[instance].empty()) {
+        continue;
+      }
+      batches[instance] = managers_[instance]->BeginFetchPgs(instance_page_ids[instance], false);
+      miss_page_ids.insert(miss_page_ids.end(), batches[instance].miss_page_ids_.begin(),
+                           batches[instance].miss_page_ids_.end());
+      miss_data.insert(miss_data.end(), batches[instance].miss_data_.begin(), batches[instance].miss_data_.end());
+      if (batches[instance].wait_page_id_ != INVALID_PAGE_ID) {
+        wait_instance = instance;
+      }
+    }
+    if (!miss_page_ids.empty()) {
+      disk_manager_->ReadPages(miss_page_ids, miss_data);
+    }
+
+    for (size_t instance = 0; instance < num_instances_; ++instance) {
+      if (batches[instance].pages_.empty()) {
+        continue;
+      }
+      auto instance_pages = managers_[instance]->EndFetchPgs(&batches[instance]);
+      for (size_t i = 0; i < instance_pages.size(); ++i) {
+        pages[instance_positions[instance][i]] = instance_pages[i];
+      }
+    }
+    if (wait_instance == num_instances_) {
+      return pages;
+    }
+
+    for (size_t i = 0; i < page_ids.size(); ++i) {
+      if (pages[i] != nullptr) {
+        UnpinPgImp(page_ids[i], false);
+        pages[i] = nullptr;
+      }
+    }
+    managers_[wait_instance]->WaitToFetch(batches[wait_instance].wait_page_id_);
+  }
 }
 
 auto ParallelBufferPoolManager::UnpinPgImp(page_id_t page_id, bool is_dirty) -> bool {
   // Unpin page_id from responsible BufferPoolManagerInstance
-  BufferPoolManager *manager_;
-  manager_ = GetBufferPoolManager(page_id);
-  return manager_->UnpinPage(page_id, is_dirty);
-  return false;
+  return GetBufferPoolManager(page_id)->UnpinPage(page_id, is_dirty);
 }
 
 auto ParallelBufferPoolManager::FlushPgImp(page_id_t page_id) -> bool {
   // Flush page_id from responsible BufferPoolManagerInstance
-  BufferPoolManager *manager_;
-  manager_ = GetBufferPoolManager(page_id);
-  return manager_->FlushPage(page_id);
-  return false;
+  return GetBufferPoolManager(page_id)->FlushPage(page_id);
 }
 
 auto ParallelBufferPoolManager::NewPgImp(page_id_t *page_id) -> Page * {
-  // create new page. We will request page allocation in a round robin manner from the underlying
-  // BufferPoolManagerInstances
-  // 1.   From a starting index of the BPMIs, call NewPageImpl until either 1) success and return 2) looped around to
-  // starting index and return nullptr
-  // 2.   Bump the starting index (mod number of instances) to start search at a different BPMI each time this function
-  // is called
-  // printf("calling new page imp\n");
-  // return nullptr;
-  size_t trials = 0;
-  Page *page_ptr;
-  while (trials++ < num_instances_) {
-    // starting_index = (starting_index + 1) % num_instances_;
-    if ((page_ptr = managers_[starting_index]->NewPage(page_id)) != nullptr) {
-      return page_ptr;
-    } else{
-      starting_index = (starting_index + 1) % num_instances_;
+  // Every call takes the next starting index, so concurrent callers start at different instances without a lock.
+  size_t start = starting_index_.fetch_add(1, std::memory_order_relaxed) % num_instances_;
+  // Prefer an instance that still has free frames over one that would have to evict.
+  for (size_t i = 0; i < num_instances_; ++i) {
+    size_t instance = (start + i) % num_instances_;
+    if (managers_[instance]->GetFreeFrameCount() > 0) {
+      start = instance;
+      break;
+    }
+  }
+  for (size_t i = 0; i < num_instances_; ++i) {
+    Page *page = managers_[(start + i) % num_instances_]->NewPage(page_id);
+    if (page != nullptr) {
+      return page;
     }
   }
   return nullptr;
 }
 
+auto ParallelBufferPoolManager::NewPgImp(page_id_t *page_id, page_id_t near_page_id) -> Page * {
+  // In page mode neighbouring pages belong to different instances anyway, and following the hint would pile every
+  // new page of a table onto the instance of its first page.
+  if (partition_mode_ != PartitionMode::EXTENT) {
+    return NewPgImp(page_id);
+  }
+  Page *page = managers_[GetInstanceIndex(near_page_id)]->NewPage(page_id);
+  if (page != nullptr) {
+    return page;
+  }
+  return NewPgImp(page_id);
+}
+
 auto ParallelBufferPoolManager::DeletePgImp(page_id_t page_id) -> bool {
   // Delete page_id from responsible BufferPoolManagerInstance
   return GetBufferPoolManager(page_id)->DeletePage(page_id);
-  // return false;
 }
 
 void ParallelBufferPoolManager::FlushAllPgsImp() {
@@ -107,4 +176,22 @@ void ParallelBufferPoolManager::FlushAllPgsImp() {
   }
 }
 
+auto ParallelBufferPoolManager::ResizeImp(size_t pool_size) -> bool {
+  // Every instance is resized even if an earlier one could not be, so that the pool gets as close as it can.
+  bool resized = true;
+  for (auto *manager : managers_) {
+    resized = manager->Resize(pool_size) && resized;
+  }
+  return resized;
+}
+
+auto ParallelBufferPoolManager::GetDirtyPageTableImp() -> std::unordered_map<page_id_t, lsn_t> {
+  // Every page belongs to a single instance, so the tables do not overlap.
+  std::unordered_map<page_id_t, lsn_t> dirty_page_table;
+  for (auto *manager : managers_) {
+    dirty_page_table.merge(manager->GetDirtyPageTable());
+  }
+  return dirty_page_table;
+}
+
 }  // namespace bustub
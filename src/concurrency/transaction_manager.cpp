@@ -33,6 +33,16 @@ auto TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level)
   txn_map_mutex.lock();
   txn_map[txn->GetTransactionId()] = txn;
   txn_map_mutex.unlock();
+
+  // A transaction joins the active-transaction table before it logs anything, so that no checkpoint misses its records.
+  {
+    std::lock_guard<std::mutex> lck(active_txns_latch_);
+    active_txns_[txn->GetTransactionId()] = txn;
+  }
+  if (enable_logging && log_manager_ != nullptr) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::BEGIN);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
+  }
   return txn;
 }
 
@@ -52,6 +62,19 @@ void TransactionManager::Commit(Transaction *txn) {
   }
   write_set->clear();
 
+  // The transaction has committed once its commit record is durable. The flush that makes it durable is shared with the
+  // transactions committing at the same time.
+  if (enable_logging && log_manager_ != nullptr) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::COMMIT);
+    auto lsn = log_manager_->AppendLogRecord(&log_record);
+    txn->SetPrevLSN(lsn);
+    log_manager_->GetDurableFuture(lsn).wait();
+  }
+  {
+    std::lock_guard<std::mutex> lck(active_txns_latch_);
+    active_txns_.erase(txn->GetTransactionId());
+  }
+
   // Release all the locks.
   ReleaseLocks(txn);
   // Release the global transaction latch.
@@ -102,12 +125,31 @@ void TransactionManager::Abort(Transaction *txn) {
   table_write_set->clear();
   index_write_set->clear();
 
+  // An abort needs no durability: a transaction without a durable commit record is rolled back by recovery anyway.
+  if (enable_logging && log_manager_ != nullptr) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ABORT);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
+  }
+  {
+    std::lock_guard<std::mutex> lck(active_txns_latch_);
+    active_txns_.erase(txn->GetTransactionId());
+  }
+
   // Release all the locks.
   ReleaseLocks(txn);
   // Release the global transaction latch.
   global_txn_latch_.RUnlock();
 }
 
+auto TransactionManager::GetActiveTransactions() -> std::unordered_map<txn_id_t, lsn_t> {
+  std::unordered_map<txn_id_t, lsn_t> active_txns;
+  std::lock_guard<std::mutex> lck(active_txns_latch_);
+  for (const auto &[txn_id, txn] : active_txns_) {
+    active_txns[txn_id] = txn->GetPrevLSN();
+  }
+  return active_txns;
+}
+
 void TransactionManager::BlockAllTransactions() { global_txn_latch_.WLock(); }
 
 void TransactionManager::ResumeTransactions() { global_txn_latch_.WUnlock(); }
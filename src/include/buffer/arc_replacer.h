@@ -0,0 +1,121 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// arc_replacer.h
+//
+// Identification: src/include/buffer/arc_replacer.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <list>
+#include <mutex>  // NOLINT
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "buffer/replacer.h"
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * ARCReplacer implements the Adaptive Replacement Cache policy.
+ *
+ * Resident frames are split into T1, the pages referenced once since they were loaded, and T2, the pages referenced
+ * again. The ghost lists B1 and B2 remember the ids of pages recently evicted from T1 and T2. A miss on a page in B1
+ * means T1 was too small and grows its target size p; a miss on a page in B2 shrinks it. Victims come from T1 while
+ * it is larger than p, and from T2 otherwise, least recently used first. This balances recency against frequency
+ * without any tuning parameter.
+ *
+ * Time is a logical clock advanced by every access and miss. A reference to a T1 page that comes less than the
+ * correlated reference period after its load is part of the same use and does not promote the page to T2. Otherwise a
+ * scan fetching a page once per tuple would promote every page it reads.
+ */
+class ARCReplacer : public Replacer {
+ public:
+  /**
+   * Create a new ARCReplacer.
+   * @param num_pages the maximum number of pages the ARCReplacer will be required to store
+   * @param correlated_reference_period references to a T1 page closer to its load than this many accesses do not
+   * promote it
+   */
+  ARCReplacer(size_t num_pages, uint64_t correlated_reference_period);
+
+  /**
+   * Destroys the ARCReplacer.
+   */
+  ~ARCReplacer() override;
+
+  auto Victim(frame_id_t *frame_id) -> bool override;
+
+  void Pin(frame_id_t frame_id) override;
+
+  void Unpin(frame_id_t frame_id) override;
+
+  void RecordAccess(frame_id_t frame_id) override;
+
+  void RecordMiss(frame_id_t frame_id, page_id_t page_id) override;
+
+  void RecordEviction(frame_id_t frame_id, page_id_t page_id) override;
+
+  void Remove(frame_id_t frame_id) override;
+
+  void SetCapacity(size_t num_frames) override;
+
+  auto Size() -> size_t override;
+
+ private:
+  /** The resident list a frame belongs to. */
+  enum class ListType { NONE, T1, T2 };
+
+  /** A ghost entry: which ghost list the page is in, and its position there. */
+  struct Ghost {
+    bool in_b2_;
+    std::list<page_id_t>::iterator pos_;
+  };
+
+  /** Evictable frames of a resident list, ordered by their last access. */
+  using EvictableSet = std::set<std::pair<uint64_t, frame_id_t>>;
+
+  /** Move a resident frame to another list (or to none), keeping the list sizes and evictable sets in sync. */
+  void MoveFrame(frame_id_t frame_id, ListType list_type);
+
+  /** Drop the least recently evicted ghosts until the ghost lists fit in the directory size ARC allows. */
+  void TrimGhosts();
+
+  auto GetEvictableSet(ListType list_type) -> EvictableSet * { return list_type == ListType::T1 ? &t1_ : &t2_; }
+
+  /** The cache size c of ARC: the number of frames in use, at most the number the replacer was created for. */
+  size_t capacity_;
+  const uint64_t correlated_reference_period_;
+  /** The target size of T1. */
+  size_t p_{0};
+  /** The logical time of the latest access. */
+  uint64_t current_timestamp_{0};
+
+  /** Per frame: its resident list, last access (its load while in T1) and whether it is evictable. */
+  std::vector<ListType> list_type_;
+  std::vector<uint64_t> last_access_;
+  std::vector<bool> is_evictable_;
+
+  /** Resident list sizes, including pinned frames. */
+  size_t t1_size_{0};
+  size_t t2_size_{0};
+  EvictableSet t1_;
+  EvictableSet t2_;
+
+  /** Ghost lists, most recently evicted page at the back. */
+  std::list<page_id_t> b1_;
+  std::list<page_id_t> b2_;
+  std::unordered_map<page_id_t, Ghost> ghosts_;
+
+  std::mutex latch_;
+};
+
+}  // namespace bustub
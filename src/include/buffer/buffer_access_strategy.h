@@ -0,0 +1,70 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_access_strategy.h
+//
+// Identification: src/include/buffer/buffer_access_strategy.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * BufferAccessStrategy lets a bulk reader, such as a sequential scan, recycle a small ring of frames instead of
+ * pulling every page it reads through the replacer.
+ *
+ * The ring remembers the last pages the reader missed on. Once it is full, the next miss evicts the page in the oldest
+ * slot, provided that nobody else has it pinned, and loads the new page into that frame. The pages of a large scan
+ * therefore displace each other and leave the rest of the pool alone. Pages the reader finds resident are used in
+ * place and do not enter the ring.
+ *
+ * A reader that knows which pages come next, such as a table scan following the chain of its table's pages, asks for
+ * up to the read-ahead window of them with BufferPoolManager::PrefetchPage. They are read asynchronously into frames
+ * of the ring, so the scan overlaps its I/O with processing tuples. The window is capped at half the ring so that
+ * read-ahead never recycles the frames of pages the reader has not reached yet.
+ *
+ * A strategy belongs to a single reader and is not thread-safe. Every buffer pool instance it is used with gets its
+ * own ring of ring_size slots.
+ */
+class BufferAccessStrategy {
+  friend class BufferPoolManagerInstance;
+
+ public:
+  /**
+   * Creates a new BufferAccessStrategy.
+   * @param ring_size the number of frames the reader may recycle in each buffer pool instance
+   * @param read_ahead_window the number of pages to read ahead of a sequential reader, 0 to disable read-ahead
+   */
+  explicit BufferAccessStrategy(size_t ring_size = BULK_READ_RING_SIZE, size_t read_ahead_window = READ_AHEAD_WINDOW)
+      : ring_size_(ring_size), read_ahead_window_(read_ahead_window) {}
+
+  /** @return the number of pages the reader may have read ahead of the page it is on */
+  auto GetReadAheadWindow() const -> size_t { return std::min(read_ahead_window_, ring_size_ / 2); }
+
+ private:
+  /** The pages loaded through the strategy by one buffer pool instance, oldest at next_ once the ring is full. */
+  struct Ring {
+    std::vector<page_id_t> pages_;
+    size_t next_{0};
+  };
+
+  /** @return the ring used with the buffer pool instance of the given index */
+  auto GetRing(uint32_t instance_index) -> Ring * { return &rings_[instance_index]; }
+
+  const size_t ring_size_;
+  const size_t read_ahead_window_;
+  std::unordered_map<uint32_t, Ring> rings_;
+};
+
+}  // namespace bustub
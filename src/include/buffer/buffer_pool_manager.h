@@ -15,7 +15,9 @@
 #include <list>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <vector>
 
+#include "buffer/buffer_access_strategy.h"
 #include "buffer/lru_replacer.h"
 #include "recovery/log_manager.h"
 #include "storage/disk/disk_manager.h"
@@ -45,6 +47,32 @@ class BufferPoolManager {
     return result;
   }
 
+  /**
+   * Fetch a page on behalf of a bulk reader, which recycles the frames of its strategy's ring on misses.
+   * @param page_id id of page to be fetched
+   * @param strategy the reader's access strategy, nullptr to fetch like FetchPage
+   * @return the requested page
+   */
+  auto FetchPage(page_id_t page_id, BufferAccessStrategy *strategy) -> Page * { return FetchPgImp(page_id, strategy); }
+
+  /**
+   * Start reading a page a bulk reader is about to fetch, into a frame of its strategy's ring. This is only a hint: it
+   * never waits, and does nothing if the page is resident or no frame is free.
+   * @param page_id id of the page the reader fetches soon
+   * @param strategy the reader's access strategy
+   * @return whether the page is resident and read in, so that fetching it does not wait for the disk
+   */
+  auto PrefetchPage(page_id_t page_id, BufferAccessStrategy *strategy) -> bool {
+    return PrefetchPgImp(page_id, strategy);
+  }
+
+  /**
+   * Fetch a batch of pages. Buffer pools that support it pin them in one go and read the misses together.
+   * @param page_ids ids of the pages to be fetched
+   * @return the requested pages, in the order of page_ids, with nullptr for those that could not be fetched
+   */
+  auto FetchPages(const std::vector<page_id_t> &page_ids) -> std::vector<Page *> { return FetchPgsImp(page_ids); }
+
   /** Grading function. Do not modify! */
   auto UnpinPage(page_id_t page_id, bool is_dirty, bufferpool_callback_fn callback = nullptr) -> bool {
     GradingCallback(callback, CallbackType::BEFORE, page_id);
@@ -69,6 +97,17 @@ class BufferPoolManager {
     return result;
   }
 
+  /**
+   * Create a new page that belongs with an existing one, such as the next page of a table. Partitioned buffer pools
+   * keep the two in the same partition where they can.
+   * @param[out] page_id id of created page
+   * @param near_page_id id of the page the new page belongs with
+   * @return nullptr if no new pages could be created, otherwise pointer to new page
+   */
+  auto NewPageNear(page_id_t *page_id, page_id_t near_page_id) -> Page * {
+    return NewPgImp(page_id, near_page_id);
+  }
+
   /** Grading function. Do not modify! */
   auto DeletePage(page_id_t page_id, bufferpool_callback_fn callback = nullptr) -> bool {
     GradingCallback(callback, CallbackType::BEFORE, page_id);
@@ -87,6 +126,20 @@ class BufferPoolManager {
   /** @return size of the buffer pool */
   virtual auto GetPoolSize() -> size_t = 0;
 
+  /**
+   * Grow or shrink the buffer pool while it is in use.
+   * @param pool_size the new size of the buffer pool
+   * @return false if the pool could not take the new size, e.g. because too many of its pages are pinned
+   */
+  auto Resize(size_t pool_size) -> bool { return ResizeImp(pool_size); }
+
+  /**
+   * Collect the dirty page table for a fuzzy checkpoint: every page whose changes may not be on disk yet, with its
+   * recLSN, an LSN that none of those changes is older than.
+   * @return the recLSN of each dirty page
+   */
+  auto GetDirtyPageTable() -> std::unordered_map<page_id_t, lsn_t> { return GetDirtyPageTableImp(); }
+
  protected:
   /**
    * Grading function. Do not modify!
@@ -108,6 +161,37 @@ class BufferPoolManager {
    */
   virtual auto FetchPgImp(page_id_t page_id) -> Page * = 0;
 
+  /**
+   * Fetch the requested page from the buffer pool using an access strategy. Buffer pools that do not support
+   * strategies ignore it.
+   * @param page_id id of page to be fetched
+   * @param strategy the access strategy, or nullptr
+   * @return the requested page
+   */
+  virtual auto FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) -> Page * { return FetchPgImp(page_id); }
+
+  /**
+   * Start reading a page ahead of a bulk reader. Buffer pools without read-ahead do nothing.
+   * @param page_id id of the page the reader fetches soon
+   * @param strategy the reader's access strategy
+   * @return whether the page is resident and read in
+   */
+  virtual auto PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) -> bool { return false; }
+
+  /**
+   * Fetch a batch of pages from the buffer pool. By default the pages are fetched one at a time.
+   * @param page_ids ids of the pages to be fetched
+   * @return the requested pages, with nullptr for those that could not be fetched
+   */
+  virtual auto FetchPgsImp(const std::vector<page_id_t> &page_ids) -> std::vector<Page *> {
+    std::vector<Page *> pages;
+    pages.reserve(page_ids.size());
+    for (auto page_id : page_ids) {
+      pages.push_back(FetchPgImp(page_id));
+    }
+    return pages;
+  }
+
   /**
    * Unpin the target page from the buffer pool.
    * @param page_id id of page to be unpinned
@@ -130,6 +214,14 @@ class BufferPoolManager {
    */
   virtual auto NewPgImp(page_id_t *page_id) -> Page * = 0;
 
+  /**
+   * Creates a new page in the buffer pool near an existing page. Buffer pools without partitions ignore the hint.
+   * @param[out] page_id id of created page
+   * @param near_page_id id of the page the new page belongs with
+   * @return nullptr if no new pages could be created, otherwise pointer to new page
+   */
+  virtual auto NewPgImp(page_id_t *page_id, page_id_t near_page_id) -> Page * { return NewPgImp(page_id); }
+
   /**
    * Deletes a page from the buffer pool.
    * @param page_id id of page to be deleted
@@ -141,5 +233,19 @@ class BufferPoolManager {
    * Flushes all the pages in the buffer pool to disk.
    */
   virtual void FlushAllPgsImp() = 0;
+
+  /**
+   * Resize the buffer pool. By default buffer pools have a fixed size.
+   * @param pool_size the new size of the buffer pool
+   * @return true if the buffer pool now has the new size, false otherwise
+   */
+  virtual auto ResizeImp(size_t pool_size) -> bool { return false; }
+
+  /**
+   * Collect the dirty page table. Buffer pools that do not track recLSNs report no pages, so they must not be
+   * checkpointed.
+   * @return the recLSN of each dirty page
+   */
+  virtual auto GetDirtyPageTableImp() -> std::unordered_map<page_id_t, lsn_t> { return {}; }
 };
 }  // namespace bustub
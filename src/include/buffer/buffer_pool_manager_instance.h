@@ -12,12 +12,19 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>  // NOLINT
 #include <list>
-#include <mutex>  // NOLINT
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
-#include "buffer/lru_replacer.h"
+#include "buffer/page_table.h"
+#include "buffer/replacer.h"
 #include "recovery/log_manager.h"
 #include "storage/disk/disk_manager.h"
 #include "storage/page/page.h"
@@ -34,8 +41,11 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    * @param pool_size the size of the buffer pool
    * @param disk_manager the disk manager
    * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param replacer_type the replacement policy used to pick victims
+   * @param max_pool_size the size the buffer pool may grow to, 0 to keep it at pool_size
    */
-  BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager = nullptr);
+  BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager = nullptr,
+                            ReplacerType replacer_type = ReplacerType::LRU, size_t max_pool_size = 0);
   /**
    * Creates a new BufferPoolManagerInstance.
    * @param pool_size the size of the buffer pool
@@ -43,9 +53,15 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    * @param instance_index index of this BPI in the parallel BPM
    * @param disk_manager the disk manager
    * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param replacer_type the replacement policy used to pick victims
+   * @param extent_size number of consecutive page ids owned by one BPI before the next BPI takes over
+   * @param numa_node the NUMA node to allocate the frames on, or -1 to leave it to the first thread touching them
+   * @param max_pool_size the size the buffer pool may grow to, 0 to keep it at pool_size
    */
   BufferPoolManagerInstance(size_t pool_size, uint32_t num_instances, uint32_t instance_index,
-                            DiskManager *disk_manager, LogManager *log_manager = nullptr);
+                            DiskManager *disk_manager, LogManager *log_manager = nullptr,
+                            ReplacerType replacer_type = ReplacerType::LRU, uint32_t extent_size = 1,
+                            int numa_node = -1, size_t max_pool_size = 0);
 
   /**
    * Destroys an existing BufferPoolManagerInstance.
@@ -58,6 +74,46 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** @return pointer to all the pages in the buffer pool */
   auto GetPages() -> Page * { return pages_; }
 
+  /** @return the number of frames on the free list; read without the latch, so it is only a hint */
+  auto GetFreeFrameCount() const -> size_t { return free_frame_count_.load(std::memory_order_relaxed); }
+
+  /** A batched fetch between BeginFetchPgs and EndFetchPgs: the pages pinned so far and the misses still to be read. */
+  struct FetchBatch {
+    std::vector<Page *> pages_;
+    std::vector<frame_id_t> hit_frames_;
+    std::vector<frame_id_t> miss_frames_;
+    std::vector<page_id_t> miss_page_ids_;
+    std::vector<char *> miss_data_;
+    /** The page the batch stopped at because it would have had to wait for it, or INVALID_PAGE_ID. */
+    page_id_t wait_page_id_{INVALID_PAGE_ID};
+  };
+
+  /**
+   * Start a batched fetch: pin or map every page in one acquisition of latch_, and write back the victims of the
+   * misses. The victims are written back early, with latch_ released, if a page has to be waited for. The caller then
+   * reads miss_page_ids_ into miss_data_, possibly in one batch with the misses of other instances, and finishes the
+   * fetch with EndFetchPgs.
+   * @param page_ids ids of the pages to be fetched
+   * @param may_wait false to stop at the first page that would have to be waited for, leaving it and the pages after
+   * it unpinned, and to record it in wait_page_id_
+   * @return the batch
+   */
+  auto BeginFetchPgs(const std::vector<page_id_t> &page_ids, bool may_wait = true) -> FetchBatch;
+
+  /**
+   * Wait until a batch that stopped at a page may be retried: the write-back of the page has landed and the page
+   * cleaner holds no frames. The caller must hold no pins, so that what it waits for cannot in turn wait for it.
+   * @param page_id the page the batch stopped at
+   */
+  void WaitToFetch(page_id_t page_id);
+
+  /**
+   * Finish a batched fetch once its misses are read, waiting for hits on pages other fetchers are still reading in.
+   * @param batch the batch started by BeginFetchPgs
+   * @return the requested pages, with nullptr for those that found every frame pinned
+   */
+  auto EndFetchPgs(FetchBatch *batch) -> std::vector<Page *>;
+
  protected:
   /**
    * Fetch the requested page from the buffer pool.
@@ -66,6 +122,24 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    */
   auto FetchPgImp(page_id_t page_id) -> Page * override;
 
+  /**
+   * Fetch the requested page from the buffer pool, recycling the frames of the strategy's ring on a miss.
+   * @param page_id id of page to be fetched
+   * @param strategy the access strategy, or nullptr
+   * @return the requested page
+   */
+  auto FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) -> Page * override;
+
+  /**
+   * Start an asynchronous read of a page a bulk reader fetches soon. The frame is reserved from the strategy's ring and
+   * mapped right away and the read submitted to the disk manager once latch_ is released; a fetch of the page waits
+   * for it like for any read in flight.
+   * @param page_id id of the page
+   * @param strategy the reader's access strategy
+   * @return whether the page is resident and read in
+   */
+  auto PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) -> bool override;
+
   /**
    * Unpin the target page from the buffer pool.
    * @param page_id id of page to be unpinned
@@ -81,11 +155,189 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    */
   auto FlushPgImp(page_id_t page_id) -> bool override;
 
+  /**
+   * Write a page back if it is dirty. The caller holds a pin on its frame and does not hold latch_.
+   * @param page_id the page held by the frame
+   * @param frame_id the frame to flush
+   */
   void flush_pg(page_id_t page_id, int frame_id);
 
   // auto find_frame_id(page_id_t page_id) ->
   int find_frame_id(page_id_t page_id);
 
+  /**
+   * Reserve a frame for a new resident page, taking it from the free list first and from the replacer otherwise.
+   * With a strategy whose ring is full, the frame of the ring's oldest page is recycled first if it is unpinned.
+   * If the victim is dirty its old page id is registered in write_back_pages_ and must be written back by the caller
+   * (outside of latch_) before calling FinishFrameIo. Must be called with latch_ held.
+   * @param[out] frame_id the reserved frame
+   * @param[out] write_back_page_id the page to be written back from the frame, or INVALID_PAGE_ID if it is clean
+   * @param strategy the access strategy of the reader, or nullptr
+   * @return false if every frame is pinned, true otherwise
+   */
+  auto ReserveFrame(frame_id_t *frame_id, page_id_t *write_back_page_id, BufferAccessStrategy *strategy = nullptr)
+      -> bool;
+
+  /**
+   * Fetch a batch of pages, pinning or mapping all of them in one acquisition of latch_ and reading the misses with a
+   * single DiskManager::ReadPages.
+   * @param page_ids ids of the pages to be fetched
+   * @return the requested pages, with nullptr for those that found every frame pinned
+   */
+  auto FetchPgsImp(const std::vector<page_id_t> &page_ids) -> std::vector<Page *> override;
+
+  /** What PinOrMapPage did with a page. */
+  enum class PinResult { HIT, MISS, NO_FRAME, WOULD_WAIT };
+
+  /**
+   * Pin a resident page, or reserve a frame for it and map it with its read still to be done. Waits for a pending
+   * write-back of the page and for frames held by the page cleaner. Must be called with latch_ held.
+   * @param lck the held latch_, released while waiting
+   * @param page_id the page
+   * @param strategy the access strategy, or nullptr
+   * @param[out] frame_id the frame of the page
+   * @param[out] write_back_page_id on a miss, the page to be written back from the frame before the read
+   * @param may_wait false to return instead of waiting, for callers that still owe write-backs of their own
+   * @return HIT if the page was pinned, MISS if it was mapped and its read is up to the caller, NO_FRAME if every frame
+   * is pinned, WOULD_WAIT if it had to wait but may not
+   */
+  auto PinOrMapPage(std::unique_lock<std::mutex> *lck, page_id_t page_id, BufferAccessStrategy *strategy,
+                    frame_id_t *frame_id, page_id_t *write_back_page_id, bool may_wait = true) -> PinResult;
+
+  /**
+   * The fetch itself: pin the requested page, reading it from disk on a miss.
+   * @param page_id id of page to be fetched
+   * @param strategy the access strategy, or nullptr
+   * @return the requested page, or nullptr if every frame is pinned
+   */
+  auto PinPage(page_id_t page_id, BufferAccessStrategy *strategy) -> Page *;
+
+  /**
+   * Map a page to a reserved frame and hand the frame out pinned once, with its I/O still marked in flight. Must be
+   * called with latch_ held.
+   * @param frame_id the reserved frame
+   * @param page_id the page the frame is going to hold
+   * @return the page
+   */
+  auto MapPage(frame_id_t frame_id, page_id_t page_id) -> Page *;
+
+  /**
+   * Unmap the page held by a claimed victim frame, registering it for write-back if it is dirty. Must be called with
+   * latch_ held.
+   * @param frame_id the claimed frame
+   * @param[out] write_back_page_id the page to be written back from the frame, or INVALID_PAGE_ID if it is clean
+   */
+  void EvictPage(frame_id_t frame_id, page_id_t *write_back_page_id);
+
+  /**
+   * Claim the frame holding the oldest page of a strategy's ring, if the ring is full and the page is still resident
+   * and unpinned. Must be called with latch_ held.
+   * @param strategy the access strategy
+   * @param[out] frame_id the claimed frame
+   * @return true if a ring frame was claimed, false otherwise
+   */
+  auto ClaimRingFrame(BufferAccessStrategy *strategy, frame_id_t *frame_id) -> bool;
+
+  /**
+   * Record a page loaded on behalf of a strategy in its ring, replacing the oldest page once the ring is full.
+   * @param strategy the access strategy
+   * @param page_id the page loaded
+   */
+  void AddToRing(BufferAccessStrategy *strategy, page_id_t page_id);
+
+  /**
+   * Ask the replacer for a victim and claim it, dropping the pinned frames it hands out from the replacer until their
+   * last unpin. Must be called with latch_ held.
+   * @param[out] frame_id the claimed victim frame
+   * @return true if an unpinned victim was found, false otherwise
+   */
+  auto Victim(frame_id_t *frame_id) -> bool;
+
+  /**
+   * Take exclusive ownership of an unpinned frame by moving its pin count from 0 to FRAME_CLAIMED, which makes
+   * lock-free pins on it fail until the frame is handed out again.
+   * @param frame_id the frame to claim
+   * @return false if the frame is pinned, true otherwise
+   */
+  auto ClaimFrame(frame_id_t frame_id) -> bool;
+
+  /**
+   * Pin a frame found through a lock-free page table lookup, if it still holds the given page, and queue the hit for
+   * the replacer. Only touches atomics.
+   * @param frame_id the frame returned by the page table
+   * @param page_id the page that is expected in the frame
+   * @return true if the frame was pinned and holds the page, false otherwise (the frame is left untouched)
+   */
+  auto TryPin(frame_id_t frame_id, page_id_t page_id) -> bool;
+
+  /**
+   * Drop one pin from a frame, handing it back to the replacer if that was the last one and Victim dropped it.
+   * @param frame_id the pinned frame
+   */
+  void ReleasePin(frame_id_t frame_id);
+
+  /**
+   * Hand a frame whose last pin was just dropped back to the replacer, if Victim dropped it while it was pinned. Takes
+   * the replacer's latch in that case, but never latch_.
+   * @param frame_id the unpinned frame
+   */
+  void ReturnToReplacer(frame_id_t frame_id);
+
+  /**
+   * Tell the replacer about the hits queued since the last miss, in the order they were queued. Must be called with
+   * latch_ held.
+   */
+  void ApplyHits();
+
+  /**
+   * Take a claimed frame out of the replacer until it is mapped again. Must be called with latch_ held.
+   * @param frame_id the claimed frame
+   */
+  void RemoveFromReplacer(frame_id_t frame_id);
+
+  /**
+   * Wait until the I/O in flight on a frame that the caller has pinned completes.
+   * @param frame_id the pinned frame
+   */
+  void WaitForFrameIo(frame_id_t frame_id);
+
+  /**
+   * Mark the I/O on a reserved frame as complete and wake up the threads waiting on it. Must be called with latch_
+   * held.
+   * @param frame_id the frame whose I/O has finished
+   * @param write_back_page_id the page that was written back from the frame, or INVALID_PAGE_ID
+   */
+  void FinishFrameIo(frame_id_t frame_id, page_id_t write_back_page_id);
+
+  /**
+   * Mark the read into a reserved frame as complete and wake up the threads waiting on it. Takes frame_io_latch_ only,
+   * so it may be called with or without latch_ held, and from an I/O completion.
+   * @param frame_id the frame whose read has finished
+   */
+  void FinishFrameRead(frame_id_t frame_id);
+
+  /**
+   * Body of the page cleaner thread. Every page_cleaner_interval, or sooner when an eviction has to write back a dirty
+   * victim itself, it cleans a batch of frames until it is stopped by the destructor.
+   */
+  void RunPageCleaner();
+
+  /**
+   * Write back up to PAGE_CLEANER_BATCH_SIZE dirty, unpinned frames, sweeping the pool from page_cleaner_hand_.
+   * The frames are pinned for the duration of the write (without being taken out of the replacer) so that they cannot
+   * be evicted, and are written outside of latch_ under their page read latch. Frames whose latch is not free right
+   * away are skipped, and each frame is handed back as soon as its write completes. Must be called with latch_ held.
+   * @param lck the held lock on latch_, released during the writes
+   * @return the number of pages written back
+   */
+  auto CleanPages(std::unique_lock<std::mutex> *lck) -> size_t;
+
+  /**
+   * @param page_id id of a page
+   * @return true if the page cleaner holds the frame of the page; must be called with latch_ held
+   */
+  auto IsBeingCleaned(page_id_t page_id) -> bool;
+
   /**
    * Creates a new page in the buffer pool.
    * @param[out] page_id id of created page
@@ -106,18 +358,59 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   void FlushAllPgsImp() override;
 
   /**
-   * Allocate a page on disk.∂
+   * Resize the buffer pool, up to the maximum size it was created with. Growing puts frames on the free list; shrinking
+   * evicts the pages of the frames at the end of the pool, writing back the dirty ones, and gives their memory back to
+   * the system. It stops at the first of those frames that is pinned.
+   * @param pool_size the new size of the buffer pool
+   * @return true if the buffer pool now has the new size, false if it is larger because pages are pinned
+   */
+  auto ResizeImp(size_t pool_size) -> bool override;
+
+  /**
+   * Collect the dirty page table. Besides the dirty frames it holds the pinned ones, which may be changed as the table
+   * is collected, and the pages whose write-back is still in flight.
+   * @return the recLSN of each dirty page
+   */
+  auto GetDirtyPageTableImp() -> std::unordered_map<page_id_t, lsn_t> override;
+
+  /** @return the LSN the next log record gets, which no change made from now on is older than */
+  auto GetNextLsn() const -> lsn_t { return log_manager_ == nullptr ? 0 : log_manager_->GetNextLSN(); }
+
+  /**
+   * Note that the image of a frame matched the page on disk as of clean_lsn, so that it holds no changes missing from
+   * disk unless it has been dirtied since.
+   * @param frame_id the frame
+   * @param clean_lsn the next LSN as of when the image was read or written, with no change to the page in progress
+   */
+  void MarkClean(frame_id_t frame_id, lsn_t clean_lsn);
+
+  /**
+   * Write a page back to disk once the log is durable up to the page's LSN.
+   * @param page_id id of the page
+   * @param frame_id the frame holding the contents of the page
+   */
+  void WritePageBack(page_id_t page_id, frame_id_t frame_id);
+
+  /**
+   * Write-ahead logging: wait until the log records up to the LSN of a page about to be written back from a frame are
+   * durable. The LSN is taken from the frame's book-keeping, not from the page, since only table pages keep one there.
+   * Does nothing while logging is disabled.
+   * @param frame_id the frame
+   */
+  void ForceLog(frame_id_t frame_id);
+
+  /**
+   * Allocate a page past the pages of this BPI on disk, with latch_ held. Free pages in the disk manager's free-space
+   * map are reused before this is called.
    * @return the id of the allocated page
    */
   auto AllocatePage() -> page_id_t;
 
   /**
-   * Deallocate a page on disk.
+   * Deallocate a page on disk, handing it to the disk manager's free-space map.
    * @param page_id id of the page to deallocate
    */
-  void DeallocatePage(__attribute__((unused)) page_id_t page_id) {
-    // This is a no-nop right now without a more complex data structure to track deallocated pages
-  }
+  void DeallocatePage(page_id_t page_id);
 
   /**
    * Validate that the page_id being used is accessible to this BPI. This can be used in all of the functions to
@@ -126,29 +419,146 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    */
   void ValidatePageId(page_id_t page_id) const;
 
-  /** Number of pages in the buffer pool. */
-  const size_t pool_size_;
+  /**
+   * @param page_id id of a page
+   * @return true if page ids like page_id are handed out by this BPI
+   */
+  auto OwnsPageId(page_id_t page_id) const -> bool {
+    return page_id / extent_size_ % num_instances_ == instance_index_;
+  }
+
+  /**
+   * @param page_id id of a page owned by this BPI
+   * @return the id of the next page owned by this BPI
+   */
+  auto NextOwnedPageId(page_id_t page_id) const -> page_id_t;
+
+  /**
+   * @param page_id id of any page
+   * @return the lowest page id owned by this BPI that is not below page_id
+   */
+  auto FirstOwnedPageIdFrom(page_id_t page_id) const -> page_id_t;
+
+  /**
+   * Map the frame arena, backed by huge pages where the system allows it, and the pages pointing at their frames, both
+   * bound to numa_node if it is not -1.
+   */
+  void AllocateFrames(int numa_node);
+
+  /** Bind a mapping that nothing has touched yet to a NUMA node, if numa_node is not -1. */
+  static void BindToNode(void *memory, size_t size, int numa_node);
+
+  /**
+   * Give the memory of retired frames back to the system, as far as the pages backing the frame arena allow.
+   * @param begin_frame the first retired frame
+   * @param end_frame the frame past the last retired one
+   */
+  void ReleaseFrames(size_t begin_frame, size_t end_frame);
+
+  /** Destroy the pages and unmap them and the frame arena. */
+  void FreeFrames();
+
+  /** Number of pages in the buffer pool. Frames from pool_size_ on are retired: claimed, empty and in no list. */
+  std::atomic<size_t> pool_size_;
+  /** Number of frames allocated, the size the buffer pool can grow to. */
+  const size_t max_pool_size_;
   /** How many instances are in the parallel BPM (if present, otherwise just 1 BPI) */
   const uint32_t num_instances_ = 1;
   /** Index of this BPI in the parallel BPM (if present, otherwise just 0) */
   const uint32_t instance_index_ = 0;
-  /** Each BPI maintains its own counter for page_ids to hand out, must ensure they mod back to its instance_index_ */
+  /** Number of consecutive page ids in an extent; extent i of the page id space belongs to BPI i % num_instances_. */
+  const uint32_t extent_size_ = 1;
+  /**
+   * Each BPI maintains its own counter for page_ids to hand out, must ensure they map back to its instance_index_.
+   * It is not persisted, so it starts past the pages the disk manager already knows of.
+   */
   std::atomic<page_id_t> next_page_id_ = instance_index_;
 
-  /** Array of buffer pool pages. */
+  /** Array of buffer pool pages. Holds only their book-keeping; the data is in frames_. */
   Page *pages_;
+  /** Size of the mapping holding pages_, rounded up to whole system pages. */
+  size_t pages_size_;
+  /** The frame arena, PAGE_SIZE aligned frames in one mapping of frames_size_ bytes. */
+  char *frames_;
+  /** Size of the frame arena, rounded up to whole huge pages. */
+  size_t frames_size_;
+  /** Whether the frame arena is backed by reserved huge pages rather than normal or transparent huge pages. */
+  bool frames_huge_{false};
   /** Pointer to the disk manager. */
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
   /** Pointer to the log manager. */
-  LogManager *log_manager_ __attribute__((__unused__));
-  /** Page table for keeping track of buffer pool pages. */
-  std::unordered_map<page_id_t, frame_id_t> page_table_;
+  LogManager *log_manager_;
+  /** Pin count of frames that are free or claimed for eviction, reuse or deletion. */
+  static constexpr int FRAME_CLAIMED = -1;
+
+  /** Page table for keeping track of buffer pool pages. Lookups are lock-free, updates happen under latch_. */
+  PageTable page_table_;
   /** Replacer to find unpinned pages for replacement. */
   Replacer *replacer_;
+  /**
+   * Whether each frame is in the replacer. A mapped frame stays in it while pinned, until Victim finds it pinned and
+   * drops it; its last unpin then hands it back.
+   */
+  std::unique_ptr<std::atomic<bool>[]> in_replacer_;
+  /** Whether each frame has a hit in hit_queue_ that the replacer has not heard of yet. */
+  std::unique_ptr<std::atomic<bool>[]> hit_pending_;
+  /**
+   * Frames hit since the last miss, as a ring of frame ids plus one; 0 marks a slot a hitter has taken but not filled
+   * in yet. Filled by hits without latch_, applied to the replacer by ApplyHits under it.
+   */
+  std::unique_ptr<std::atomic<frame_id_t>[]> hit_queue_;
+  std::atomic<uint64_t> hit_queue_tail_{0};
+  uint64_t hit_queue_head_{0};
   /** List of free pages. */
   std::list<frame_id_t> free_list_;
-  /** This latch protects shared data structures. We recommend updating this comment to describe what it protects. */
+  /** Size of free_list_, kept so that callers can pick an instance with free frames without taking latch_. */
+  std::atomic<size_t> free_frame_count_{0};
+  /**
+   * Frames whose contents are being read or written outside of latch_. A frame with I/O in flight is always pinned
+   * and already mapped in page_table_, so fetchers of its page pin it and wait on frame_io_cv_ instead of on the pool.
+   * Set under latch_ and cleared under frame_io_latch_, but read without either on the lock-free hit path.
+   */
+  std::unique_ptr<std::atomic<bool>[]> io_in_progress_;
+  /**
+   * Pages whose old contents are being written back from an evicted frame, with their recLSNs; a miss on them waits
+   * until it is done.
+   */
+  std::unordered_map<page_id_t, lsn_t> write_back_pages_;
+  /** The next LSN as of when each frame's image last matched its page on disk; later changes are no older. */
+  std::unique_ptr<std::atomic<lsn_t>[]> clean_lsns_;
+  /** Signalled under latch_ whenever a write-back completes or the page cleaner or a flush hands frames back. */
+  std::condition_variable io_cv_;
+  /**
+   * Protects the clearing of io_in_progress_ and read_aheads_in_flight_, and is never held across anything else, so
+   * that read-ahead completions on the disk manager's I/O threads need not take latch_. Taken after latch_.
+   */
+  std::mutex frame_io_latch_;
+  /** Signalled under frame_io_latch_ whenever the I/O on a frame completes. */
+  std::condition_variable frame_io_cv_;
+  /** Background thread writing dirty unpinned frames back ahead of eviction. */
+  std::thread page_cleaner_thread_;
+  /** Wakes the page cleaner early, or for shutdown. */
+  std::condition_variable page_cleaner_cv_;
+  /** Set by the destructor to stop the page cleaner. */
+  bool stop_page_cleaner_{false};
+  /** The frame the next cleaner pass starts sweeping from. */
+  size_t page_cleaner_hand_{0};
+  /** Read-ahead reads submitted and not completed yet; the destructor waits for them on frame_io_cv_. */
+  size_t read_aheads_in_flight_{0};
+  /** Pages being flushed; another flush of the same page waits for the first one, which may have cleared its flag. */
+  std::unordered_set<page_id_t> flushing_pages_;
+  /** Number of frames the page cleaner holds pinned; a miss that finds no victim waits for them instead of failing. */
+  size_t cleaning_frames_{0};
+  /** Whether the page cleaner holds each frame; protected by latch_. */
+  std::vector<bool> cleaning_;
+  /**
+   * This latch serializes the updates of page_table_, io_in_progress_ and the page ids of frames, and protects
+   * free_list_, write_back_pages_, flushing_pages_ and the page cleaner state. Hits, unpins and pin count or dirty
+   * flag changes do not need it. It is never held across a disk read or write of a page.
+   */
   std::mutex latch_;
+  /** Serializes resizes, which release the memory of retired frames without holding latch_. */
+  std::mutex resize_latch_;
 
   // std::unordered_map<page_id_t, int> page_to_frame;
 };
@@ -12,9 +12,9 @@
 
 #pragma once
 
-#include <list>
+#include <atomic>
+#include <memory>
 #include <mutex>  // NOLINT
-#include <vector>
 
 #include "buffer/replacer.h"
 #include "common/config.h"
@@ -23,6 +23,11 @@ namespace bustub {
 
 /**
  * ClockReplacer implements the clock replacement policy, which approximates the Least Recently Used policy.
+ *
+ * Every frame has a slot in two flag arrays: whether it is in the replacer and its reference bit. Pin, Unpin and
+ * RecordAccess only flip flags with atomic operations, so they neither take a latch nor touch a heap node. Victim
+ * sweeps the clock hand over the frames, giving every referenced frame a second chance by clearing its bit, and evicts
+ * the first frame it finds with the bit already clear. Only Victim serializes, on the hand.
  */
 class ClockReplacer : public Replacer {
  public:
@@ -43,10 +48,26 @@ class ClockReplacer : public Replacer {
 
   void Unpin(frame_id_t frame_id) override;
 
+  void RecordAccess(frame_id_t frame_id) override;
+
   auto Size() -> size_t override;
 
  private:
-  // TODO(student): implement me!
+  /** The number of frames, which is also the length of the flag arrays. */
+  const size_t num_pages_;
+  /** Whether each frame can currently be victimized. */
+  std::unique_ptr<std::atomic<bool>[]> in_replacer_;
+  /** The reference bit of each frame, set when it is unpinned and cleared as the hand sweeps past. */
+  std::unique_ptr<std::atomic<bool>[]> ref_;
+  /**
+   * The number of frames in the replacer. It is signed because a Victim racing with an Unpin of the same frame can
+   * decrement it before the Unpin increments it.
+   */
+  std::atomic<int64_t> size_{0};
+  /** The frame the clock hand points at. */
+  size_t hand_{0};
+  /** Protects hand_. */
+  std::mutex latch_;
 };
 
 }  // namespace bustub
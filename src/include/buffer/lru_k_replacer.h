@@ -0,0 +1,92 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer.h
+//
+// Identification: src/include/buffer/lru_k_replacer.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <mutex>  // NOLINT
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include "buffer/replacer.h"
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * LRUKReplacer implements the LRU-K replacement policy.
+ *
+ * It evicts the frame whose K-th most recent reference lies furthest in the past. Frames referenced fewer than K times
+ * have an infinite backward K-distance and go first, oldest reference first. A page touched once by a sequential scan
+ * is therefore evicted before any page of the working set that has been referenced K times.
+ *
+ * Time is a logical clock advanced by every RecordAccess. A reference that comes less than the correlated reference
+ * period after the previous reference to the same frame is folded into it instead of counting as a new one. Otherwise
+ * a scan reading several tuples from one page would make that page look as hot as the working set.
+ */
+class LRUKReplacer : public Replacer {
+ public:
+  /**
+   * Create a new LRUKReplacer.
+   * @param num_pages the maximum number of pages the LRUKReplacer will be required to store
+   * @param k the number of references remembered per frame
+   * @param correlated_reference_period references to a frame closer together than this many accesses count as one
+   */
+  LRUKReplacer(size_t num_pages, size_t k, uint64_t correlated_reference_period);
+
+  /**
+   * Destroys the LRUKReplacer.
+   */
+  ~LRUKReplacer() override;
+
+  auto Victim(frame_id_t *frame_id) -> bool override;
+
+  void Pin(frame_id_t frame_id) override;
+
+  void Unpin(frame_id_t frame_id) override;
+
+  void RecordAccess(frame_id_t frame_id) override;
+
+  void RecordEviction(frame_id_t frame_id, page_id_t page_id) override;
+
+  void Remove(frame_id_t frame_id) override;
+
+  auto Size() -> size_t override;
+
+ private:
+  /** Eviction order of an evictable frame: fewer than K references first, then by the reference that ranks it. */
+  using EvictionKey = std::tuple<bool, uint64_t, frame_id_t>;
+
+  auto GetEvictionKey(frame_id_t frame_id) const -> EvictionKey;
+
+  /** @return the i-th oldest remembered reference of a frame, i < history_size_[frame_id] */
+  auto GetReference(frame_id_t frame_id, size_t i) const -> uint64_t;
+
+  const size_t k_;
+  const uint64_t correlated_reference_period_;
+  /** The logical time of the latest access. */
+  uint64_t current_timestamp_{0};
+
+  /** The last K references of every frame, K slots per frame used as a ring starting at history_start_. */
+  std::vector<uint64_t> history_;
+  std::vector<size_t> history_start_;
+  std::vector<size_t> history_size_;
+
+  /** Whether each frame is evictable, i.e. has an entry in evictable_. */
+  std::vector<bool> is_evictable_;
+  /** The evictable frames, the next victim first. */
+  std::set<EvictionKey> evictable_;
+
+  std::mutex latch_;
+};
+
+}  // namespace bustub
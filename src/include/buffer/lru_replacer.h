@@ -44,6 +44,8 @@ class LRUReplacer : public Replacer {
 
   void Unpin(frame_id_t frame_id) override;
 
+  void RecordAccess(frame_id_t frame_id) override;
+
   auto Size() -> size_t override;
 
  private:
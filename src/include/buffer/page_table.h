@@ -0,0 +1,90 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_table.h
+//
+// Identification: src/include/buffer/page_table.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+/**
+ * PageTable maps the page ids resident in a buffer pool instance to their frames. It is a fixed-size, linear probing
+ * hash table with room for at least twice as many entries as there are frames, so it never has to grow.
+ *
+ * Each slot packs a (page id, frame id) pair into one 64-bit word, so Find can run without any lock and always observes
+ * a mapping that existed at some point. Insert and Remove must be serialized by the caller. Removal shifts the
+ * following entries back instead of leaving tombstones, which means a concurrent Find may transiently miss a resident
+ * page or return a frame that no longer holds it: callers must validate the frame and fall back to a locked lookup.
+ */
+class PageTable {
+ public:
+  /**
+   * Create a new PageTable.
+   * @param num_frames the maximum number of pages that will be mapped at the same time
+   */
+  explicit PageTable(size_t num_frames);
+
+  ~PageTable() = default;
+
+  DISALLOW_COPY_AND_MOVE(PageTable);
+
+  /**
+   * Look up the frame holding a page. Safe to call concurrently with Insert and Remove.
+   * @param page_id the page to look up
+   * @return the frame holding the page, or -1 if it was not found
+   */
+  auto Find(page_id_t page_id) const -> frame_id_t;
+
+  /**
+   * Map a page to a frame. The page must not already be mapped. Must not run concurrently with Insert or Remove.
+   * @param page_id the page to map
+   * @param frame_id the frame holding the page
+   */
+  void Insert(page_id_t page_id, frame_id_t frame_id);
+
+  /**
+   * Remove the mapping of a page. Must not run concurrently with Insert or Remove.
+   * @param page_id the page to unmap
+   * @return true if the page was mapped, false otherwise
+   */
+  auto Remove(page_id_t page_id) -> bool;
+
+ private:
+  /** An all-ones word, i.e. (INVALID_PAGE_ID, -1), marks an empty slot. */
+  static constexpr uint64_t EMPTY_SLOT = ~static_cast<uint64_t>(0);
+
+  static inline auto Pack(page_id_t page_id, frame_id_t frame_id) -> uint64_t {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(page_id)) << 32) | static_cast<uint32_t>(frame_id);
+  }
+  static inline auto PageOf(uint64_t slot) -> page_id_t { return static_cast<page_id_t>(slot >> 32); }
+  static inline auto FrameOf(uint64_t slot) -> frame_id_t { return static_cast<frame_id_t>(slot & 0xFFFFFFFF); }
+
+  /** @return the slot a page hashes to */
+  inline auto Home(page_id_t page_id) const -> size_t {
+    // Fibonacci hashing spreads the dense, strided page ids of a buffer pool instance over the whole table.
+    return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(page_id)) * 0x9E3779B97F4A7C15ULL) >>
+                               shift_);
+  }
+
+  /** Number of slots, a power of two. */
+  size_t num_slots_;
+  /** 64 - log2(num_slots_). */
+  int shift_;
+  std::unique_ptr<std::atomic<uint64_t>[]> slots_;
+};
+
+}  // namespace bustub
@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <unordered_map>
 #include <vector>
 #include "buffer/buffer_pool_manager.h"
 #include "buffer/buffer_pool_manager_instance.h"
@@ -21,6 +23,13 @@
 
 namespace bustub {
 
+/**
+ * How the page id space is split between the instances of a ParallelBufferPoolManager.
+ * PAGE deals out single pages round-robin, spreading every table over all the instances. EXTENT deals out runs of
+ * PARTITION_EXTENT_SIZE consecutive pages, so that pages allocated together also share an instance.
+ */
+enum class PartitionMode { PAGE, EXTENT };
+
 class ParallelBufferPoolManager : public BufferPoolManager {
  public:
   /**
@@ -29,9 +38,15 @@ class ParallelBufferPoolManager : public BufferPoolManager {
    * @param pool_size the pool size of each BufferPoolManagerInstance
    * @param disk_manager the disk manager
    * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param replacer_type the replacement policy of every BufferPoolManagerInstance
+   * @param partition_mode how page ids are split between the instances
+   * @param numa_nodes number of NUMA nodes to spread the instances' frames over, 0 to not bind them to nodes
+   * @param max_pool_size the size each BufferPoolManagerInstance may grow to, 0 to keep it at pool_size
    */
   ParallelBufferPoolManager(size_t num_instances, size_t pool_size, DiskManager *disk_manager,
-                            LogManager *log_manager = nullptr);
+                            LogManager *log_manager = nullptr, ReplacerType replacer_type = ReplacerType::LRU,
+                            PartitionMode partition_mode = PartitionMode::PAGE, size_t numa_nodes = 0,
+                            size_t max_pool_size = 0);
 
   /**
    * Destroys an existing ParallelBufferPoolManager.
@@ -43,8 +58,21 @@ class ParallelBufferPoolManager : public BufferPoolManager {
 
  protected:
   std::vector<BufferPoolManagerInstance *> managers_;
-  size_t starting_index = 0;
+  /** Instance the next NewPgImp starts its search at; bumped by every call so that concurrent inserts spread out. */
+  std::atomic<size_t> starting_index_{0};
   size_t num_instances_;
+  /** How page ids are spread over the instances. */
+  PartitionMode partition_mode_;
+  /** Number of consecutive page ids that belong to the same instance. */
+  size_t extent_size_;
+  /** The disk manager shared by the instances, which reads the misses of a batched fetch in one go. */
+  DiskManager *disk_manager_;
+
+  /**
+   * @param page_id id of page
+   * @return index of the BufferPoolManagerInstance responsible for handling given page id
+   */
+  auto GetInstanceIndex(page_id_t page_id) const -> size_t { return page_id / extent_size_ % num_instances_; }
 
   /**
    * @param page_id id of page
@@ -59,6 +87,34 @@ class ParallelBufferPoolManager : public BufferPoolManager {
    */
   auto FetchPgImp(page_id_t page_id) -> Page * override;
 
+  /**
+   * Fetch the requested page from the buffer pool using an access strategy.
+   * @param page_id id of page to be fetched
+   * @param strategy the access strategy, or nullptr
+   * @return the requested page
+   */
+  auto FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) -> Page * override;
+
+  /**
+   * Start reading a page ahead of a bulk reader, in the BufferPoolManagerInstance that owns it.
+   * @param page_id id of the page the reader fetches soon
+   * @param strategy the reader's access strategy
+   * @return whether the page is resident and read in
+   */
+  auto PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) -> bool override;
+
+  /**
+   * Fetch a batch of pages, splitting it by owning instance and reading the misses of all the instances together.
+   * The instances pin and map their pages one after another on the caller's thread rather than in parallel; only the
+   * reads are in flight together. Pinning and mapping take microseconds per page, less than handing the work to other
+   * threads would cost, while the reads, which take most of the time, already overlap. An instance never blocks while earlier instances hold pins for the batch: if it
+   * would have to wait for a page, the pages pinned so far are read in and unpinned, and the batch is fetched again
+   * once the page is no longer busy.
+   * @param page_ids ids of the pages to be fetched
+   * @return the requested pages, with nullptr for those that could not be fetched
+   */
+  auto FetchPgsImp(const std::vector<page_id_t> &page_ids) -> std::vector<Page *> override;
+
   /**
    * Unpin the target page from the buffer pool.
    * @param page_id id of page to be unpinned
@@ -75,12 +131,22 @@ class ParallelBufferPoolManager : public BufferPoolManager {
   auto FlushPgImp(page_id_t page_id) -> bool override;
 
   /**
-   * Creates a new page in the buffer pool.
+   * Creates a new page in the buffer pool. Each call starts at the next instance in turn and prefers the first one with
+   * free frames, so that neither concurrent inserts nor evictions pile up on a single instance.
    * @param[out] page_id id of created page
    * @return nullptr if no new pages could be created, otherwise pointer to new page
    */
   auto NewPgImp(page_id_t *page_id) -> Page * override;
 
+  /**
+   * Creates a new page in the instance of near_page_id in extent mode, or wherever NewPgImp would put it if that
+   * instance is full. In page mode the hint is ignored.
+   * @param[out] page_id id of created page
+   * @param near_page_id id of the page the new page belongs with
+   * @return nullptr if no new pages could be created, otherwise pointer to new page
+   */
+  auto NewPgImp(page_id_t *page_id, page_id_t near_page_id) -> Page * override;
+
   /**
    * Deletes a page from the buffer pool.
    * @param page_id id of page to be deleted
@@ -92,5 +158,18 @@ class ParallelBufferPoolManager : public BufferPoolManager {
    * Flushes all the pages in the buffer pool to disk.
    */
   void FlushAllPgsImp() override;
+
+  /**
+   * Resize every BufferPoolManagerInstance.
+   * @param pool_size the new size of each BufferPoolManagerInstance
+   * @return true if all of them now have the new size, false otherwise
+   */
+  auto ResizeImp(size_t pool_size) -> bool override;
+
+  /**
+   * Collect the dirty page tables of every BufferPoolManagerInstance.
+   * @return the recLSN of each dirty page
+   */
+  auto GetDirtyPageTableImp() -> std::unordered_map<page_id_t, lsn_t> override;
 };
 }  // namespace bustub
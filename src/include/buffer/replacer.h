@@ -16,6 +16,9 @@
 
 namespace bustub {
 
+/** The replacement policies a buffer pool can be created with. */
+enum class ReplacerType { LRU, CLOCK, LRU_K, ARC };
+
 /**
  * Replacer is an abstract class that tracks page usage.
  */
@@ -43,6 +46,43 @@ class Replacer {
    */
   virtual void Unpin(frame_id_t frame_id) = 0;
 
+  /**
+   * Records a reference to the page held by a frame. Called whenever a page is fetched or created, for policies that
+   * rank frames by their access history rather than by the order in which they were unpinned.
+   * @param frame_id the id of the frame that was accessed
+   */
+  virtual void RecordAccess(frame_id_t frame_id) {}
+
+  /**
+   * Records that a page missing from the buffer pool was read or created into a frame. Policies that remember pages
+   * after their eviction use the page id to recognize them when they come back; the others treat it as an access.
+   * @param frame_id the id of the frame the page was loaded into
+   * @param page_id the id of the page
+   */
+  virtual void RecordMiss(frame_id_t frame_id, page_id_t page_id) { RecordAccess(frame_id); }
+
+  /**
+   * Records that a victim chosen by Victim was actually evicted. The buffer pool may give up on a victim that got
+   * pinned in the meantime, in which case the frame keeps its page and is unpinned into the replacer again later.
+   * @param frame_id the id of the evicted frame
+   * @param page_id the id of the page the frame held
+   */
+  virtual void RecordEviction(frame_id_t frame_id, page_id_t page_id) {}
+
+  /**
+   * Removes a frame whose page was deleted. Unlike a victim, the frame is not handed out by the replacer, so policies
+   * keeping per-frame history must drop it here.
+   * @param frame_id the id of the frame to remove
+   */
+  virtual void Remove(frame_id_t frame_id) { Pin(frame_id); }
+
+  /**
+   * Tells the replacer how many frames the buffer pool uses after it was resized. Frame ids stay below the number of
+   * frames the replacer was created for; policies whose targets depend on the pool size override this.
+   * @param num_frames the number of frames in use
+   */
+  virtual void SetCapacity(size_t num_frames) {}
+
   /** @return the number of elements in the replacer that can be victimized */
   virtual auto Size() -> size_t = 0;
 };
@@ -220,7 +220,9 @@ class Catalog {
     // Populate the index with all tuples in table heap
     auto *table_meta = GetTable(table_name);
     auto *heap = table_meta->table_.get();
-    for (auto tuple = heap->Begin(txn); tuple != heap->End(); ++tuple) {
+    // Read the heap through a ring of frames, so that building the index does not flush the working set out of the pool
+    BufferAccessStrategy strategy;
+    for (auto tuple = heap->Begin(txn, &strategy); tuple != heap->End(); ++tuple) {
       index->InsertEntry(tuple->KeyFromTuple(schema, key_schema, key_attrs), tuple->GetRid(), txn);
     }
 
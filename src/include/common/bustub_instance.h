@@ -32,14 +32,17 @@ class BustubInstance {
     // log related
     log_manager_ = new LogManager(disk_manager_);
 
-    buffer_pool_manager_ = new BufferPoolManagerInstance(BUFFER_POOL_SIZE, disk_manager_, log_manager_);
+    // The buffer pool starts small and can be resized up to BUFFER_POOL_MAX_SIZE while the instance runs.
+    buffer_pool_manager_ = new BufferPoolManagerInstance(BUFFER_POOL_SIZE, disk_manager_, log_manager_,
+                                                         ReplacerType::LRU, BUFFER_POOL_MAX_SIZE);
 
     // txn related
     lock_manager_ = new LockManager();
     transaction_manager_ = new TransactionManager(lock_manager_, log_manager_);
 
     // checkpoints
-    checkpoint_manager_ = new CheckpointManager(transaction_manager_, log_manager_, buffer_pool_manager_);
+    checkpoint_manager_ =
+        new CheckpointManager(transaction_manager_, log_manager_, buffer_pool_manager_, disk_manager_);
   }
 
   ~BustubInstance() {
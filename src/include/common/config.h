@@ -27,14 +27,31 @@ extern std::atomic<bool> enable_logging;
 /** If ENABLE_LOGGING is true, the log should be flushed to disk every LOG_TIMEOUT. */
 extern std::chrono::duration<int64_t> log_timeout;
 
+/** Each buffer pool instance's page cleaner writes back dirty unpinned frames every PAGE_CLEANER_INTERVAL. */
+extern std::chrono::milliseconds page_cleaner_interval;
+
 static constexpr int INVALID_PAGE_ID = -1;                                    // invalid page id
 static constexpr int INVALID_TXN_ID = -1;                                     // invalid transaction id
 static constexpr int INVALID_LSN = -1;                                        // invalid log sequence number
 static constexpr int HEADER_PAGE_ID = 0;                                      // the header page id
 static constexpr int PAGE_SIZE = 4096;                                        // size of a data page in byte
+static constexpr int HUGE_PAGE_SIZE = 2 * 1024 * 1024;                        // size of a huge page in byte
+static constexpr int CACHE_LINE_SIZE = 64;                                    // size of a cache line in byte
+static constexpr int DIRECT_IO_ALIGNMENT = 4096;                              // buffer alignment O_DIRECT requires
 static constexpr int BUFFER_POOL_SIZE = 10;                                   // size of buffer pool
+static constexpr int BUFFER_POOL_MAX_SIZE = 1024;                             // size a buffer pool can be resized to
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE);  // size of a log buffer in byte
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
+static constexpr int PAGE_CLEANER_BATCH_SIZE = 32;                            // max pages written per cleaner pass
+static constexpr int LRUK_REPLACER_K = 2;                                     // references remembered per frame
+static constexpr int LRUK_CORRELATED_REFERENCE_PERIOD = 16;                   // accesses folded into one (LRU-K, ARC)
+static constexpr int BULK_READ_RING_SIZE = 4;                                 // frames recycled by a bulk reader
+static constexpr int READ_AHEAD_WINDOW = 2;                                   // pages read ahead of a bulk reader
+static constexpr int PARTITION_EXTENT_SIZE = 64;                              // pages per extent in extent partitioning
+static constexpr int ASYNC_IO_QUEUE_DEPTH = 64;                               // page I/Os kept in flight by io_uring
+static constexpr int ASYNC_IO_THREADS = 4;                                    // threads of the thread-pool I/O backend
+static constexpr int RECOVERY_READ_SIZE = 1 << 20;                            // log bytes recovery reads at a time
+static constexpr int RECOVERY_THREADS = 4;                                    // threads replaying the log in recovery
 
 using frame_id_t = int32_t;    // frame id type
 using page_id_t = int32_t;     // page id type
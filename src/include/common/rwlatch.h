@@ -68,6 +68,19 @@ class ReaderWriterLatch {
     reader_count_++;
   }
 
+  /**
+   * Acquire a read latch if that does not have to wait.
+   * @return true if the latch was acquired
+   */
+  auto TryRLock() -> bool {
+    std::lock_guard<mutex_t> guard(mutex_);
+    if (writer_entered_ || reader_count_ == MAX_READERS) {
+      return false;
+    }
+    reader_count_++;
+    return true;
+  }
+
   /**
    * Release a read latch.
    */
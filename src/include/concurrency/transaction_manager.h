@@ -13,6 +13,7 @@
 #pragma once
 
 #include <atomic>
+#include <mutex>  // NOLINT
 #include <shared_mutex>
 #include <unordered_map>
 #include <unordered_set>
@@ -78,6 +79,14 @@ class TransactionManager {
     return res;
   }
 
+  /**
+   * The active-transaction table of a checkpoint. Transactions keep running while it is read, so each entry is only as
+   * current as the moment it was read; recovery's analysis catches up from the log.
+   * @return the id and the LSN of the last log record of every transaction that has begun and not yet committed or
+   * aborted
+   */
+  auto GetActiveTransactions() -> std::unordered_map<txn_id_t, lsn_t>;
+
   /** Prevents all transactions from performing operations, used for checkpointing. */
   void BlockAllTransactions();
 
@@ -104,7 +113,11 @@ class TransactionManager {
 
   std::atomic<txn_id_t> next_txn_id_{0};
   LockManager *lock_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
+
+  /** The transactions begun by this manager that have not committed or aborted yet. */
+  std::unordered_map<txn_id_t, Transaction *> active_txns_;
+  std::mutex active_txns_latch_;
 
   /** The global transaction latch is used for checkpointing. */
   ReaderWriterLatch global_txn_latch_;
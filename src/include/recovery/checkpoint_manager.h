@@ -12,32 +12,52 @@
 
 #pragma once
 
+#include <thread>  // NOLINT
+
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "recovery/log_manager.h"
+#include "storage/disk/disk_manager.h"
 
 namespace bustub {
 
 /**
- * CheckpointManager creates consistent checkpoints by blocking all other transactions temporarily.
+ * CheckpointManager takes ARIES-style fuzzy checkpoints, which never block the transactions running meanwhile. A
+ * checkpoint logs the active-transaction table and the dirty-page table with the recLSN of each page, then writes the
+ * dirty pages back in the background, so that recovery can start redo from the smallest recLSN instead of the beginning
+ * of the log.
  */
 class CheckpointManager {
  public:
+  /**
+   * @param disk_manager if given, the pages written back before a checkpoint begins are made durable with
+   * DiskManager::Sync, and so are the page writes of the checkpoint once they are all done
+   */
   CheckpointManager(TransactionManager *transaction_manager, LogManager *log_manager,
-                    BufferPoolManager *buffer_pool_manager)
+                    BufferPoolManager *buffer_pool_manager, DiskManager *disk_manager = nullptr)
       : transaction_manager_(transaction_manager),
         log_manager_(log_manager),
-        buffer_pool_manager_(buffer_pool_manager) {}
+        buffer_pool_manager_(buffer_pool_manager),
+        disk_manager_(disk_manager) {}
 
-  ~CheckpointManager() = default;
+  ~CheckpointManager();
 
+  /**
+   * Log the checkpoint records and wait until they are durable, then start writing back the pages that were dirty in
+   * the background. Transactions keep running throughout.
+   */
   void BeginCheckpoint();
+
+  /** Wait until the pages of the last checkpoint have been written back. */
   void EndCheckpoint();
 
  private:
-  TransactionManager *transaction_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  TransactionManager *transaction_manager_;
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  DiskManager *disk_manager_;
+  /** writes back the dirty pages of the checkpoint in progress */
+  std::thread flush_thread_;
 };
 
 }  // namespace bustub
@@ -13,9 +13,14 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <condition_variable>  // NOLINT
 #include <future>              // NOLINT
 #include <mutex>               // NOLINT
+#include <thread>              // NOLINT
+#include <utility>
+#include <vector>
 
 #include "recovery/log_record.h"
 #include "storage/disk/disk_manager.h"
@@ -25,50 +30,135 @@ namespace bustub {
 /**
  * LogManager maintains a separate thread that is awakened whenever the log buffer is full or whenever a timeout
  * happens. When the thread is awakened, the log buffer's content is written into the disk log file.
+ *
+ * Appends take no latch. A thread reserves the LSN and the space of its record with one atomic update of the append
+ * state, serializes the record into its space while other threads do the same, and then counts the bytes it filled.
+ * Of the two log buffers, one is filled while the other is written out; a flush switches the buffer being filled and
+ * then only waits for the records already reserved in the old one to be filled in. Each buffer is written out as one
+ * log block, framed as described in log_record.h.
+ *
+ * The flush thread flushes every log_timeout, and on demand for whoever waits for an LSN to become durable. Commits
+ * arriving while a flush is in progress are all covered by the next one, so they share a single log write and sync.
  */
 class LogManager {
  public:
   explicit LogManager(DiskManager *disk_manager)
-      : next_lsn_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
-    log_buffer_ = new char[LOG_BUFFER_SIZE];
-    flush_buffer_ = new char[LOG_BUFFER_SIZE];
+      : append_state_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
+    for (auto &buffer : buffers_) {
+      buffer = new char[LOG_BUFFER_SIZE];
+    }
+    for (auto &filled : filled_) {
+      filled = 0;
+    }
+    // LSNs carry on where the log left off; everything already in it is durable.
+    lsn_t next_lsn = ReadLogTail();
+    append_state_ = static_cast<uint64_t>(next_lsn) << LSN_SHIFT;
+    base_lsns_[0] = next_lsn;
+    base_lsns_[1] = next_lsn;
+    persistent_lsn_ = next_lsn - 1;
   }
 
   ~LogManager() {
-    delete[] log_buffer_;
-    delete[] flush_buffer_;
-    log_buffer_ = nullptr;
-    flush_buffer_ = nullptr;
+    StopFlushThread();
+    for (auto &buffer : buffers_) {
+      delete[] buffer;
+      buffer = nullptr;
+    }
   }
 
+  /** Enable logging and start the flush thread. */
   void RunFlushThread();
+  /** Stop the flush thread after a last flush, and disable logging. */
   void StopFlushThread();
 
   auto AppendLogRecord(LogRecord *log_record) -> lsn_t;
 
-  inline auto GetNextLSN() -> lsn_t { return next_lsn_; }
+  /**
+   * Write out the records appended so far, returning once they are durable.
+   */
+  void Flush();
+
+  /**
+   * Ask for the log to be made durable up to a record, e.g. the commit record of a transaction. The flush thread does
+   * it with its next flush, which it starts right away; without a flush thread the caller flushes.
+   * @param lsn the LSN of the record
+   * @return a future that becomes ready once the persistent LSN reaches lsn
+   */
+  auto GetDurableFuture(lsn_t lsn) -> std::future<void>;
+
+  inline auto GetNextLSN() -> lsn_t { return GetLsn(append_state_); }
   inline auto GetPersistentLSN() -> lsn_t { return persistent_lsn_; }
   inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
-  inline auto GetLogBuffer() -> char * { return log_buffer_; }
+  inline auto GetLogBuffer() -> char * { return buffers_[GetBufferIndex(append_state_)]; }
 
  private:
-  // TODO(students): you may add your own member variables
-
-  /** The atomic counter which records the next log sequence number. */
-  std::atomic<lsn_t> next_lsn_;
+  /** Layout of the append state: the next LSN above LSN_SHIFT, then the index of the buffer being filled. */
+  static constexpr int LSN_SHIFT = 32;
+  static constexpr uint64_t BUFFER_INDEX_BIT = uint64_t{1} << 31;
+  static constexpr uint64_t OFFSET_MASK = BUFFER_INDEX_BIT - 1;
+  static_assert(LOG_BUFFER_SIZE <= OFFSET_MASK, "log buffer offsets must fit in the append state");
+  /** The bytes of a log buffer left for records, between the header and the trailer of its block. */
+  static constexpr size_t RECORDS_CAPACITY = LogRecord::MAX_SIZE;
+
+  static auto GetLsn(uint64_t state) -> lsn_t { return static_cast<lsn_t>(state >> LSN_SHIFT); }
+  static auto GetBufferIndex(uint64_t state) -> size_t { return (state & BUFFER_INDEX_BIT) != 0 ? 1 : 0; }
+  static auto GetOffset(uint64_t state) -> size_t { return state & OFFSET_MASK; }
+
+  /**
+   * Switch the buffer being filled and write the old one out once its reserved records are filled in. Must be called
+   * with flush_latch_ held.
+   */
+  void FlushBuffer();
+
+  /** Fulfil the durable futures the persistent LSN has reached. */
+  void NotifyDurable();
+
+  /** @return the LSN after the last record in the log file, found from the blocks at its end */
+  auto ReadLogTail() -> lsn_t;
+
+  /**
+   * Read the header of the block at an offset of the log file, checking that the block is complete.
+   * @param offset the offset of the block
+   * @param log_size the size of the log file
+   * @param[out] next_lsn the LSN after the last record in the block
+   * @return the size of the block, or 0 if no complete block starts at offset
+   */
+  auto ReadBlockHeader(int offset, int log_size, lsn_t *next_lsn) -> int;
+
+  /** Serialize a log record whose LSN is set into the log buffer space reserved for it. */
+  static void SerializeLogRecord(const LogRecord &log_record, lsn_t base_lsn, char *data);
+
+  /**
+   * The append state, packed into one word so that the LSN of a record and its space in the log buffer are reserved
+   * together: the next LSN, the index of the buffer being filled and the offset of its first unreserved byte.
+   */
+  std::atomic<uint64_t> append_state_;
   /** The log records before and including the persistent lsn have been written to disk. */
   std::atomic<lsn_t> persistent_lsn_;
 
-  char *log_buffer_;
-  char *flush_buffer_;
+  /** The two log buffers; the one the append state does not point at is empty or being written out. */
+  std::array<char *, 2> buffers_;
+  /** Bytes of records serialized into each buffer; a buffer is complete once this reaches its reserved offset. */
+  std::array<std::atomic<size_t>, 2> filled_;
+  /** The base LSN of the block in each buffer, set before the append state switches to the buffer. */
+  std::array<std::atomic<lsn_t>, 2> base_lsns_;
 
-  std::mutex latch_;
+  /** Serializes flushes, which swap the buffers. */
+  std::mutex flush_latch_;
 
-  std::thread *flush_thread_ __attribute__((__unused__));
+  /** Protects the flush thread state and durable_waiters_. */
+  std::mutex latch_;
 
+  std::thread *flush_thread_{nullptr};
+  bool stop_flush_thread_{false};
+  /** Set when somebody waits for an LSN to become durable, so that the flush thread does not wait for the timeout. */
+  bool flush_requested_{false};
+  /** Wakes the flush thread. */
   std::condition_variable cv_;
+  /** The promises behind durable futures, with the LSNs they wait for. */
+  std::vector<std::pair<lsn_t, std::promise<void>>> durable_waiters_;
 
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
 };
 
 }  // namespace bustub
@@ -12,8 +12,13 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "storage/table/tuple.h"
@@ -32,42 +37,74 @@ enum class LogRecordType {
   ABORT,
   /** Creating a new page in the table heap. */
   NEWPAGE,
+  /** A fuzzy checkpoint, taken while transactions keep running. */
+  CHECKPOINT,
 };
 
 /**
  * For every write operation on the table page, you should write ahead a corresponding log record.
  *
- * For EACH log record, HEADER is like (5 fields in common, 20 bytes in total).
- *---------------------------------------------
- * | size | LSN | transID | prevLSN | LogType |
- *---------------------------------------------
+ * The log is written in blocks, one per flush of a log buffer. A block holds records with consecutive LSNs, from its
+ * base LSN on, framed by fixed-width 4-byte fields
+ *------------------------------------------------------------------------
+ * | block size | base LSN | record count | records ... | block size |
+ *------------------------------------------------------------------------
+ * The header makes every block readable on its own, and the trailing copy of the block size leads from the end of the
+ * log to the start of its last block.
+ *
+ * Records are encoded compactly, with integers as varints: 7 bits per byte, least significant first, the top bit set
+ * on every byte but the last. Ids that may be invalid (-1) are stored plus one. For EACH log record, HEADER is
+ *--------------------------------------------------------------------------------------
+ * | length | LogType | LSN delta | transID | prevLSN delta | [undoNextLSN delta] |
+ *--------------------------------------------------------------------------------------
+ * where length counts the bytes after itself, LogType is one byte, LSN delta is the record's LSN minus the base LSN of
+ * its block, and prevLSN delta is the record's LSN minus prevLSN, or 0 if the transaction has no record before. Most of
+ * the header takes a byte per field.
+ * A compensation log record (CLR), logged by recovery for each change of a loser it undoes, is a record of the change
+ * that undid it, with the top bit of LogType set and an undoNextLSN delta: the record's LSN minus the LSN of the next
+ * record of the transaction left to undo, or 0 if there is none.
  * For insert type log record
- *---------------------------------------------------------------
- * | HEADER | tuple_rid | tuple_size | tuple_data(char[] array) |
- *---------------------------------------------------------------
+ *-----------------------------------------------------------
+ * | HEADER | rid page id | rid slot | tuple_size | tuple_data |
+ *-----------------------------------------------------------
  * For delete type (including markdelete, rollbackdelete, applydelete)
- *----------------------------------------------------------------
- * | HEADER | tuple_rid | tuple_size | tuple_data(char[] array) |
- *---------------------------------------------------------------
- * For update type log record
- *-----------------------------------------------------------------------------------
- * | HEADER | tuple_rid | tuple_size | old_tuple_data | tuple_size | new_tuple_data |
- *-----------------------------------------------------------------------------------
+ *-----------------------------------------------------------
+ * | HEADER | rid page id | rid slot | tuple_size | tuple_data |
+ *-----------------------------------------------------------
+ * For update type log record, only the byte range where the old and the new tuple differ is logged, with the lengths
+ * of the prefix and the suffix they share; redo and undo take those from the tuple on the page.
+ *----------------------------------------------------------------------------------------------------------------
+ * | HEADER | rid page id | rid slot | prefix | suffix | old_range_size | old_range | new_range_size | new_range |
+ *----------------------------------------------------------------------------------------------------------------
  * For new page type log record
- *--------------------------
- * | HEADER | prev_page_id |
- *--------------------------
+ *-------------------------------------
+ * | HEADER | prev_page_id | page_id |
+ *-------------------------------------
+ * For checkpoint type log record, the next LSN when the checkpoint began, the number of records of the checkpoint
+ * after this one, the active transaction table with the last LSN of each transaction, and the dirty page table with
+ * the recLSN of each page. Tables too large for one log block are split over several records with the same begin LSN,
+ * and the checkpoint only counts once its last record, with no records after, is in the log.
+ *-------------------------------------------------------------------------------------------------------------------------
+ * | HEADER | begin LSN | parts left | txn_count | (transID, last LSN) ... | page_count | (page_id, recLSN) ... |
+ *-------------------------------------------------------------------------------------------------------------------------
  */
 class LogRecord {
   friend class LogManager;
   friend class LogRecovery;
 
  public:
+  /** Bytes before the records of a log block: its size, base LSN and record count. */
+  static constexpr int BLOCK_HEADER_SIZE = 3 * sizeof(int32_t);
+  /** Bytes after the records of a log block: its size again. */
+  static constexpr int BLOCK_TRAILER_SIZE = sizeof(int32_t);
+  /** The longest encoded record, which fills a log block on its own. */
+  static constexpr size_t MAX_SIZE = LOG_BUFFER_SIZE - BLOCK_HEADER_SIZE - BLOCK_TRAILER_SIZE;
+
   LogRecord() = default;
 
   // constructor for Transaction type(BEGIN/COMMIT/ABORT)
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type)
-      : size_(HEADER_SIZE), txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type) {}
+      : txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type) {}
 
   // constructor for INSERT/DELETE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, const RID &rid, const Tuple &tuple)
@@ -81,37 +118,104 @@ class LogRecord {
       delete_rid_ = rid;
       delete_tuple_ = tuple;
     }
-    // calculate log record size
-    size_ = HEADER_SIZE + sizeof(RID) + sizeof(int32_t) + tuple.GetLength();
+    // calculate the size of the fields after the header
+    payload_size_ = RidSize(rid) + VarintSize(tuple.GetLength()) + tuple.GetLength();
   }
 
   // constructor for UPDATE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, const RID &update_rid,
             const Tuple &old_tuple, const Tuple &new_tuple)
-      : txn_id_(txn_id),
-        prev_lsn_(prev_lsn),
-        log_record_type_(log_record_type),
-        update_rid_(update_rid),
-        old_tuple_(old_tuple),
-        new_tuple_(new_tuple) {
-    // calculate log record size
-    size_ = HEADER_SIZE + sizeof(RID) + old_tuple.GetLength() + new_tuple.GetLength() + 2 * sizeof(int32_t);
+      : txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type), update_rid_(update_rid) {
+    // find the byte range where the tuples differ
+    const char *old_data = old_tuple.GetData();
+    const char *new_data = new_tuple.GetData();
+    uint32_t old_length = old_tuple.GetLength();
+    uint32_t new_length = new_tuple.GetLength();
+    uint32_t shared = std::min(old_length, new_length);
+    while (update_prefix_ < shared && old_data[update_prefix_] == new_data[update_prefix_]) {
+      update_prefix_++;
+    }
+    while (update_prefix_ + update_suffix_ < shared &&
+           old_data[old_length - update_suffix_ - 1] == new_data[new_length - update_suffix_ - 1]) {
+      update_suffix_++;
+    }
+    old_range_.assign(old_data + update_prefix_, old_length - update_prefix_ - update_suffix_);
+    new_range_.assign(new_data + update_prefix_, new_length - update_prefix_ - update_suffix_);
+    // calculate the size of the fields after the header
+    payload_size_ = RidSize(update_rid) + VarintSize(update_prefix_) + VarintSize(update_suffix_) +
+                    VarintSize(old_range_.size()) + old_range_.size() + VarintSize(new_range_.size()) +
+                    new_range_.size();
   }
 
   // constructor for NEWPAGE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t prev_page_id, page_id_t page_id)
-      : size_(HEADER_SIZE),
-        txn_id_(txn_id),
+      : txn_id_(txn_id),
         prev_lsn_(prev_lsn),
         log_record_type_(log_record_type),
         prev_page_id_(prev_page_id),
         page_id_(page_id) {
-    // calculate log record size, header size + sizeof(prev_page_id) + sizeof(page_id)
-    size_ = HEADER_SIZE + sizeof(page_id_t) * 2;
+    // calculate the size of the fields after the header
+    payload_size_ = VarintSize(prev_page_id + 1) + VarintSize(page_id + 1);
+  }
+
+  // constructor for CHECKPOINT type
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, lsn_t begin_lsn,
+            std::unordered_map<txn_id_t, lsn_t> active_txns, std::unordered_map<page_id_t, lsn_t> dirty_pages,
+            uint32_t parts_left = 0)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type),
+        begin_lsn_(begin_lsn),
+        parts_left_(parts_left),
+        active_txns_(std::move(active_txns)),
+        dirty_pages_(std::move(dirty_pages)) {
+    // calculate the size of the fields after the header
+    payload_size_ = VarintSize(begin_lsn_ + 1) + VarintSize(parts_left_) + VarintSize(active_txns_.size()) +
+                    VarintSize(dirty_pages_.size());
+    for (const auto &[txn_id, last_lsn] : active_txns_) {
+      payload_size_ += VarintSize(txn_id + 1) + VarintSize(last_lsn + 1);
+    }
+    for (const auto &[page_id, rec_lsn] : dirty_pages_) {
+      payload_size_ += VarintSize(page_id + 1) + VarintSize(rec_lsn + 1);
+    }
   }
 
   ~LogRecord() = default;
 
+  /**
+   * Make the CHECKPOINT records of a checkpoint: one, unless its tables do not fit in a log block, in which case they
+   * are split over as many records as they need.
+   */
+  static auto MakeCheckpoint(lsn_t begin_lsn, const std::unordered_map<txn_id_t, lsn_t> &active_txns,
+                             const std::unordered_map<page_id_t, lsn_t> &dirty_pages) -> std::vector<LogRecord> {
+    // The room left for table entries by the longest header and the fields of a checkpoint before its tables.
+    constexpr size_t entries_capacity = MAX_SIZE - 10 * MAX_VARINT_SIZE;
+    std::vector<std::pair<std::unordered_map<txn_id_t, lsn_t>, std::unordered_map<page_id_t, lsn_t>>> parts(1);
+    size_t entries_size = 0;
+    auto reserve = [&](size_t entry_size) {
+      if (entries_size + entry_size > entries_capacity) {
+        parts.emplace_back();
+        entries_size = 0;
+      }
+      entries_size += entry_size;
+    };
+    for (const auto &[txn_id, last_lsn] : active_txns) {
+      reserve(VarintSize(txn_id + 1) + VarintSize(last_lsn + 1));
+      parts.back().first.emplace(txn_id, last_lsn);
+    }
+    for (const auto &[page_id, rec_lsn] : dirty_pages) {
+      reserve(VarintSize(page_id + 1) + VarintSize(rec_lsn + 1));
+      parts.back().second.emplace(page_id, rec_lsn);
+    }
+    std::vector<LogRecord> records;
+    for (size_t i = 0; i < parts.size(); ++i) {
+      records.emplace_back(INVALID_TXN_ID, INVALID_LSN, LogRecordType::CHECKPOINT, begin_lsn,
+                           std::move(parts[i].first), std::move(parts[i].second),
+                           static_cast<uint32_t>(parts.size() - 1 - i));
+    }
+    return records;
+  }
+
   inline auto GetDeleteTuple() -> Tuple & { return delete_tuple_; }
 
   inline auto GetDeleteRID() -> RID & { return delete_rid_; }
@@ -120,14 +224,43 @@ class LogRecord {
 
   inline auto GetInsertRID() -> RID & { return insert_rid_; }
 
-  inline auto GetOriginalTuple() -> Tuple & { return old_tuple_; }
+  /**
+   * Redo an update on the tuple it was made to.
+   * @param old_tuple the tuple before the update
+   * @return the tuple after the update
+   */
+  inline auto RedoUpdate(const Tuple &old_tuple) const -> Tuple {
+    return SpliceRange(old_tuple, old_range_, new_range_);
+  }
 
-  inline auto GetUpdateTuple() -> Tuple & { return new_tuple_; }
+  /**
+   * Undo an update on the tuple it produced.
+   * @param new_tuple the tuple after the update
+   * @return the tuple before the update
+   */
+  inline auto UndoUpdate(const Tuple &new_tuple) const -> Tuple {
+    return SpliceRange(new_tuple, new_range_, old_range_);
+  }
 
   inline auto GetUpdateRID() -> RID & { return update_rid_; }
 
   inline auto GetNewPageRecord() -> page_id_t { return prev_page_id_; }
 
+  inline auto GetNewPageId() -> page_id_t { return page_id_; }
+
+  /** @return the next LSN when a checkpoint began: a change before it is on disk unless its page is in GetDirtyPages */
+  inline auto GetBeginLsn() -> lsn_t { return begin_lsn_; }
+
+  /** @return the number of records of a checkpoint logged after this one; its tables are split over all of them */
+  inline auto GetPartsLeft() -> uint32_t { return parts_left_; }
+
+  /** @return the transactions running at a checkpoint, with their last LSN */
+  inline auto GetActiveTransactions() -> std::unordered_map<txn_id_t, lsn_t> & { return active_txns_; }
+
+  /** @return the pages dirty at a checkpoint, with their recLSN */
+  inline auto GetDirtyPages() -> std::unordered_map<page_id_t, lsn_t> & { return dirty_pages_; }
+
+  /** @return the length of the encoded record, once it has been appended or deserialized */
   inline auto GetSize() -> int32_t { return size_; }
 
   inline auto GetLSN() -> lsn_t { return lsn_; }
@@ -136,6 +269,21 @@ class LogRecord {
 
   inline auto GetPrevLSN() -> lsn_t { return prev_lsn_; }
 
+  /**
+   * Make this record a compensation log record (CLR).
+   * @param undo_next_lsn the LSN of the next record of the transaction left to undo, i.e. the prevLSN of the record
+   * the change of this one undid
+   */
+  inline void SetUndoNextLSN(lsn_t undo_next_lsn) {
+    compensation_ = true;
+    undo_next_lsn_ = undo_next_lsn;
+  }
+
+  /** @return true if this is a compensation log record, which is never undone itself */
+  inline auto IsCompensation() -> bool { return compensation_; }
+
+  inline auto GetUndoNextLSN() -> lsn_t { return undo_next_lsn_; }
+
   inline auto GetLogRecordType() -> LogRecordType & { return log_record_type_; }
 
   // For debug purpose
@@ -152,13 +300,98 @@ class LogRecord {
   }
 
  private:
-  // the length of log record(for serialization, in bytes)
+  /** The longest varint, of a 64-bit value. */
+  static constexpr size_t MAX_VARINT_SIZE = 10;
+  /** The bit of the LogType byte marking a compensation log record. */
+  static constexpr uint8_t COMPENSATION_BIT = 0x80;
+
+  static auto VarintSize(uint64_t value) -> size_t {
+    size_t size = 1;
+    while (value >= 0x80) {
+      value >>= 7;
+      size++;
+    }
+    return size;
+  }
+
+  /** @return the number of bytes written */
+  static auto PutVarint(char *data, uint64_t value) -> size_t {
+    size_t pos = 0;
+    while (value >= 0x80) {
+      data[pos++] = static_cast<char>(value | 0x80);
+      value >>= 7;
+    }
+    data[pos++] = static_cast<char>(value);
+    return pos;
+  }
+
+  /** @return the number of bytes read, or 0 if the varint does not end before end */
+  static auto GetVarint(const char *data, const char *end, uint64_t *value) -> size_t {
+    *value = 0;
+    for (size_t pos = 0; pos < MAX_VARINT_SIZE && data + pos < end; pos++) {
+      auto byte = static_cast<uint8_t>(data[pos]);
+      *value |= static_cast<uint64_t>(byte & 0x7f) << (7 * pos);
+      if ((byte & 0x80) == 0) {
+        return pos + 1;
+      }
+    }
+    return 0;
+  }
+
+  static auto RidSize(const RID &rid) -> size_t {
+    return VarintSize(rid.GetPageId() + 1) + VarintSize(rid.GetSlotNum());
+  }
+
+  /** @return the delta prevLSN is stored as, in a record with the given LSN */
+  auto PrevLsnDelta(lsn_t lsn) const -> uint64_t { return prev_lsn_ == INVALID_LSN ? 0 : lsn - prev_lsn_; }
+
+  /** @return the delta undoNextLSN is stored as, in a compensation log record with the given LSN */
+  auto UndoNextLsnDelta(lsn_t lsn) const -> uint64_t {
+    return undo_next_lsn_ == INVALID_LSN ? 0 : lsn - undo_next_lsn_;
+  }
+
+  /**
+   * @param lsn the LSN of the record, which the size of the prevLSN delta depends on
+   * @param base_lsn the base LSN of the block the record is in, which the size of the LSN delta depends on
+   * @return the length of the encoded record after its length prefix
+   */
+  auto BodySize(lsn_t lsn, lsn_t base_lsn) const -> size_t {
+    return 1 + VarintSize(lsn - base_lsn) + VarintSize(txn_id_ + 1) + VarintSize(PrevLsnDelta(lsn)) +
+           (compensation_ ? VarintSize(UndoNextLsnDelta(lsn)) : 0) + payload_size_;
+  }
+
+  /** @return the length of the encoded record with the given LSN, in a block with the given base LSN */
+  auto EncodedSize(lsn_t lsn, lsn_t base_lsn) const -> size_t {
+    return VarintSize(BodySize(lsn, base_lsn)) + BodySize(lsn, base_lsn);
+  }
+
+  /** Replace the byte range `from` of a tuple, between the shared prefix and suffix, with `to`. */
+  auto SpliceRange(const Tuple &tuple, const std::string &from, const std::string &to) const -> Tuple {
+    assert(tuple.GetLength() == update_prefix_ + from.size() + update_suffix_);
+    auto length = static_cast<uint32_t>(update_prefix_ + to.size() + update_suffix_);
+    std::string data(sizeof(uint32_t) + length, '\0');
+    memcpy(data.data(), &length, sizeof(uint32_t));
+    char *pos = data.data() + sizeof(uint32_t);
+    memcpy(pos, tuple.GetData(), update_prefix_);
+    memcpy(pos + update_prefix_, to.data(), to.size());
+    memcpy(pos + update_prefix_ + to.size(), tuple.GetData() + update_prefix_ + from.size(), update_suffix_);
+    Tuple result;
+    result.DeserializeFrom(data.data());
+    return result;
+  }
+
+  // the length of the encoded log record, set when it is appended or deserialized
   int32_t size_{0};
+  // the length of the fields after the header
+  size_t payload_size_{0};
   // must have fields
   lsn_t lsn_{INVALID_LSN};
   txn_id_t txn_id_{INVALID_TXN_ID};
   lsn_t prev_lsn_{INVALID_LSN};
   LogRecordType log_record_type_{LogRecordType::INVALID};
+  // for compensation log records
+  bool compensation_{false};
+  lsn_t undo_next_lsn_{INVALID_LSN};
 
   // case1: for delete operation, delete_tuple_ for UNDO operation
   RID delete_rid_;
@@ -168,15 +401,22 @@ class LogRecord {
   RID insert_rid_;
   Tuple insert_tuple_;
 
-  // case3: for update operation
+  // case3: for update operation, the bytes of the old and the new tuple between their shared prefix and suffix
   RID update_rid_;
-  Tuple old_tuple_;
-  Tuple new_tuple_;
+  uint32_t update_prefix_{0};
+  uint32_t update_suffix_{0};
+  std::string old_range_;
+  std::string new_range_;
 
   // case4: for new page operation
   page_id_t prev_page_id_{INVALID_PAGE_ID};
   page_id_t page_id_{INVALID_PAGE_ID};
-  static const int HEADER_SIZE = 20;
+
+  // case5: for checkpoint
+  lsn_t begin_lsn_{INVALID_LSN};
+  uint32_t parts_left_{0};
+  std::unordered_map<txn_id_t, lsn_t> active_txns_;
+  std::unordered_map<page_id_t, lsn_t> dirty_pages_;
 };  // namespace bustub
 
 }  // namespace bustub
@@ -13,45 +13,186 @@
 #pragma once
 
 #include <algorithm>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/lock_manager.h"
+#include "recovery/log_manager.h"
 #include "recovery/log_record.h"
 
 namespace bustub {
 
 /**
  * Read log file from disk, redo and undo.
+ *
+ * Analysis walks the log back from its end to the last checkpoint and reads it from there on, taking the transactions
+ * that ran before from the checkpoint's active transaction table. Redo reads the log sequentially, RECOVERY_READ_SIZE
+ * bytes at a time with the next read already in flight, and hands
+ * each record to the redo worker of the page it changes. Workers replay their pages in parallel, while each page still
+ * sees its records in log order. Undo then rolls the loser transactions back concurrently: they held exclusive locks
+ * on the tuples they changed, so they only ever share pages, which are latched for every change. Undo logs what it
+ * does, so a crash during undo is recovered from like any other.
  */
 class LogRecovery {
  public:
-  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager)
-      : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), offset_(0) {
-    log_buffer_ = new char[LOG_BUFFER_SIZE];
-  }
+  /**
+   * @param disk_manager the disk manager holding the log
+   * @param buffer_pool_manager the buffer pool pages are recovered through
+   * @param log_manager the log manager undo logs its CLRs and ABORT records through
+   * @param num_threads number of threads replaying the log, and rolling back transactions; capped at the pool size
+   */
+  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, LogManager *log_manager,
+              size_t num_threads = RECOVERY_THREADS)
+      : disk_manager_(disk_manager),
+        buffer_pool_manager_(buffer_pool_manager),
+        log_manager_(log_manager),
+        num_threads_(num_threads) {}
 
-  ~LogRecovery() {
-    delete[] log_buffer_;
-    log_buffer_ = nullptr;
-  }
+  ~LogRecovery() = default;
 
   void Redo();
   void Undo();
-  auto DeserializeLogRecord(const char *data, LogRecord *log_record) -> bool;
+  /**
+   * Deserialize the header of a log block.
+   * @param data the start of the block
+   * @param size the number of bytes available from data
+   * @param[out] base_lsn the LSN of the first record in the block
+   * @return the size of the block; 0 if the bytes available do not hold all of it, and -1 if no block starts at data,
+   * e.g. where the log ends
+   */
+  static auto DeserializeBlockHeader(const char *data, int size, lsn_t *base_lsn) -> int;
+
+  /**
+   * Deserialize a log record. Given the base LSN of its block, a record is decoded on its own, wherever it is.
+   * @param data the start of the record
+   * @param size the number of bytes available from data
+   * @param base_lsn the base LSN of the block holding the record
+   * @param[out] log_record the record
+   * @return false if the bytes available do not hold a complete record
+   */
+  static auto DeserializeLogRecord(const char *data, int size, lsn_t base_lsn, LogRecord *log_record) -> bool;
+
+  /** @return the transactions that neither committed nor aborted, with their last LSN; Undo rolls them back */
+  auto GetActiveTransactions() const -> const std::unordered_map<txn_id_t, lsn_t> & { return active_txn_; }
 
  private:
-  DiskManager *disk_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /** The most records queued for a redo worker; reading the log waits for a worker that falls this far behind. */
+  static constexpr size_t REDO_QUEUE_CAPACITY = 4096;
+
+  /** Records for one redo worker, with the page of each that the worker replays it on. */
+  struct RedoQueue {
+    std::deque<std::pair<page_id_t, LogRecord>> records_;
+    bool done_{false};
+    std::mutex latch_;
+    /** Signalled when records are queued, and when the worker takes them. */
+    std::condition_variable cv_;
+  };
+
+  /** Where a record is in the log file. */
+  struct LogPosition {
+    /** The file offset of the block holding the record. */
+    int block_offset_;
+    /** The base LSN of that block. */
+    lsn_t base_lsn_;
+    /** The file offset of the record. */
+    int offset_;
+  };
+
+  /**
+   * Read the log from a block on, in order.
+   * @param offset the file offset of the block
+   * @param visit called with each record and its position
+   */
+  void ScanLog(int offset, const std::function<void(LogRecord *, const LogPosition &)> &visit);
+
+  /**
+   * Read the records of a log block, in order.
+   * @param data the block
+   * @param block_size the size of the block
+   * @param position the file offset and base LSN of the block
+   * @param visit called with each record and its position
+   */
+  static void ScanBlock(const char *data, int block_size, LogPosition position,
+                        const std::function<void(LogRecord *, const LogPosition &)> &visit);
+
+  /**
+   * Read the block that ends at a file offset, which its trailer leads back to the start of.
+   * @param end_offset the file offset right after the block
+   * @param[out] block the bytes of the block
+   * @param[out] base_lsn the base LSN of the block
+   * @return the file offset of the block, or -1 if no complete block ends at end_offset
+   */
+  auto ReadBlockBefore(int end_offset, std::vector<char> *block, lsn_t *base_lsn) -> int;
+
+  /**
+   * Find where analysis starts: the block holding the begin LSN of the last checkpoint logged whole, from which on
+   * the log holds the whole checkpoint and every change made since it began.
+   * @param[out] base_lsn the base LSN of that block
+   * @return the file offset of that block; 0 if the log holds no checkpoint
+   */
+  auto FindLastCheckpoint(lsn_t *base_lsn) -> int;
+
+  /**
+   * Map the records of the blocks before mapped_offset_, back to the block holding an LSN. Must be called with
+   * mapping_latch_ held.
+   */
+  void MapLogBack(lsn_t lsn);
+
+  /** Queue a record for the redo worker of a page. */
+  void Dispatch(page_id_t page_id, const LogRecord &log_record, std::vector<RedoQueue> *queues);
+
+  /** Body of a redo worker, which replays the records of its queue. */
+  void RunRedoWorker(RedoQueue *queue);
+
+  /** @return the number of redo workers and undo threads: num_threads_, but no more than the buffer pool has frames */
+  auto NumWorkers() const -> size_t;
+
+  /** Fetch the page a worker replays or undoes a record on, waiting for a frame if the other workers hold them all. */
+  auto FetchWorkerPage(page_id_t page_id) -> Page *;
+
+  /** Replay a record on a page, unless the page LSN shows the page has it already. */
+  void RedoRecord(page_id_t page_id, LogRecord *log_record);
+
+  /**
+   * Roll back the changes of a transaction, from its last record back to its first, skipping the ones that CLRs show
+   * to be undone already, and log its ABORT record.
+   */
+  void UndoTransaction(txn_id_t txn_id, lsn_t last_lsn);
+
+  /**
+   * Undo the change of a record on its page, and log a CLR for it.
+   * @param log_record the record
+   * @param[in,out] prev_lsn the last LSN of the transaction, which the CLR follows and then takes
+   */
+  void UndoRecord(LogRecord *log_record, lsn_t *prev_lsn);
+
+  /** Read the record with the given LSN from the log. */
+  auto ReadLogRecord(lsn_t lsn, LogRecord *log_record) -> bool;
+
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  LogManager *log_manager_;
+  size_t num_threads_;
 
   /** Maintain active transactions and its corresponding latest lsn. */
   std::unordered_map<txn_id_t, lsn_t> active_txn_;
-  /** Mapping the log sequence number to log file offset for undos. */
-  std::unordered_map<lsn_t, int> lsn_mapping_;
-
-  int offset_ __attribute__((__unused__));  // NOLINT
-  char *log_buffer_;
+  /**
+   * Mapping the log sequence number to its position in the log file, for redo to start at and for undos: analysis maps
+   * the records after the last checkpoint, and the blocks before are mapped when redo or undo needs them.
+   */
+  std::unordered_map<lsn_t, LogPosition> lsn_mapping_;
+  /** The file offset of the first block mapped. */
+  int mapped_offset_{0};
+  /** The base LSN of that block. */
+  lsn_t mapped_base_lsn_{0};
+  /** Protects lsn_mapping_, which undo threads map more of. */
+  std::mutex mapping_latch_;
 };
 
 }  // namespace bustub
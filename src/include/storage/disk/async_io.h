@@ -0,0 +1,150 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// async_io.h
+//
+// Identification: src/include/storage/disk/async_io.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/config.h"
+
+namespace bustub {
+
+class DiskManager;
+
+/** The ways DiskManager can carry out asynchronous page I/O. */
+enum class AsyncIoBackend { THREAD_POOL, IO_URING };
+
+/** An asynchronous read or write of a page. */
+struct PageIoRequest {
+  /** True to write the page from data_, false to read it into data_. */
+  bool is_write_;
+  page_id_t page_id_;
+  char *data_;
+  /** Runs on an I/O thread once the page has been transferred. */
+  std::function<void()> callback_;
+};
+
+/**
+ * AsyncIo carries out page reads and writes in the background and reports their completion through callbacks.
+ * Submit never blocks on I/O, so callbacks may submit follow-up I/O themselves; they must not wait for it though.
+ * Destroying an AsyncIo completes all the I/O submitted to it first.
+ */
+class AsyncIo {
+ public:
+  virtual ~AsyncIo() = default;
+
+  /**
+   * Start a batch of page I/Os. The requests may complete in any order.
+   * @param requests the requests, moved out of the vector
+   */
+  virtual void Submit(std::vector<PageIoRequest> *requests) = 0;
+};
+
+/**
+ * ThreadPoolAsyncIo runs page I/O on a pool of threads that do blocking positional reads and writes through the
+ * DiskManager. It works everywhere, at the cost of one thread per I/O in flight.
+ */
+class ThreadPoolAsyncIo : public AsyncIo {
+ public:
+  /**
+   * @param disk_manager the disk manager doing the reads and writes
+   * @param num_threads number of I/O threads
+   */
+  ThreadPoolAsyncIo(DiskManager *disk_manager, size_t num_threads);
+
+  ~ThreadPoolAsyncIo() override;
+
+  void Submit(std::vector<PageIoRequest> *requests) override;
+
+ private:
+  /** Body of an I/O thread. */
+  void RunWorker();
+
+  DiskManager *disk_manager_;
+  std::vector<std::thread> workers_;
+  std::deque<PageIoRequest> queue_;
+  bool stop_{false};
+  std::mutex latch_;
+  std::condition_variable cv_;
+};
+
+/**
+ * UringAsyncIo submits page I/O to an io_uring, so that a single thread reaping completions keeps up to queue_depth
+ * I/Os in flight. Requests beyond that wait in a backlog that the reaper submits as completions free up slots.
+ */
+class UringAsyncIo : public AsyncIo {
+ public:
+  /**
+   * @param disk_manager the disk manager, which takes over transfers the kernel leaves short
+   * @param db_fd descriptor of the database file
+   * @param queue_depth the number of I/Os to keep in flight
+   * @return the new UringAsyncIo, or nullptr if the kernel does not offer io_uring
+   */
+  static auto Create(DiskManager *disk_manager, int db_fd, unsigned queue_depth) -> std::unique_ptr<UringAsyncIo>;
+
+  ~UringAsyncIo() override;
+
+  void Submit(std::vector<PageIoRequest> *requests) override;
+
+ private:
+  UringAsyncIo(DiskManager *disk_manager, int db_fd, int ring_fd);
+
+  /** Map the rings of ring_fd_. @return false if that failed */
+  auto MapRings(unsigned sq_entries, unsigned cq_entries, const void *params) -> bool;
+
+  /** Move backlog requests into free submission queue entries and tell the kernel, with latch_ held. */
+  void SubmitBacklog();
+
+  /** Body of the reaper thread, which waits for completions and runs their callbacks. */
+  void RunReaper();
+
+  DiskManager *disk_manager_;
+  int db_fd_;
+  int ring_fd_;
+
+  /** The mapped submission and completion rings; see io_uring_setup(2). */
+  void *sq_ring_{nullptr};
+  size_t sq_ring_size_{0};
+  void *cq_ring_{nullptr};
+  size_t cq_ring_size_{0};
+  void *sqes_{nullptr};
+  size_t sqes_size_{0};
+  unsigned *sq_head_;
+  unsigned *sq_tail_;
+  unsigned sq_mask_;
+  unsigned *sq_array_;
+  unsigned *cq_head_;
+  unsigned *cq_tail_;
+  unsigned cq_mask_;
+  void *cqes_;
+
+  /** Number of slots in the submission queue; also the most I/Os in flight. */
+  unsigned queue_depth_{0};
+  /** I/Os handed to the kernel and not reaped yet. */
+  unsigned in_flight_{0};
+  /** Requests waiting for a free slot. */
+  std::deque<PageIoRequest> backlog_;
+  bool stop_{false};
+  /** Protects the submission queue, in_flight_, backlog_ and stop_. */
+  std::mutex latch_;
+  /** Signalled when no I/O is in flight or waiting. */
+  std::condition_variable idle_cv_;
+  std::thread reaper_;
+};
+
+}  // namespace bustub
@@ -13,15 +13,29 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>  // NOLINT
 #include <fstream>
 #include <future>  // NOLINT
-#include <mutex>   // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <set>
+#include <shared_mutex>
 #include <string>
+#include <vector>
 
 #include "common/config.h"
+#include "storage/disk/async_io.h"
 
 namespace bustub {
 
+/** When the page writes of a DiskManager become durable. */
+enum class PageSyncPolicy {
+  /** Every page write is made durable before it completes. */
+  ON_WRITE,
+  /** Page writes only reach the operating system; Sync, called at checkpoints, makes them durable. */
+  ON_CHECKPOINT
+};
+
 /**
  * DiskManager takes care of the allocation and deallocation of pages within a database. It performs the reading and
  * writing of pages to and from disk, providing a logical file layer within the context of a database management system.
@@ -31,13 +45,19 @@ class DiskManager {
   /**
    * Creates a new disk manager that writes to the specified database file.
    * @param db_file the file name of the database file to write to
+   * @param backend how asynchronous page I/O is carried out; io_uring falls back to a thread pool where the kernel
+   * does not offer it
+   * @param direct_io whether to bypass the kernel page cache for the database file with O_DIRECT, so that pages are
+   * only cached in the buffer pool; falls back to buffered I/O where the file system does not support it
    */
-  explicit DiskManager(const std::string &db_file);
+  explicit DiskManager(const std::string &db_file, AsyncIoBackend backend = AsyncIoBackend::IO_URING,
+                       bool direct_io = false);
 
-  ~DiskManager() = default;
+  /** Shuts the disk manager down, if ShutDown was not called already. */
+  ~DiskManager() { ShutDown(); }
 
   /**
-   * Shut down the disk manager and close all the file resources.
+   * Shut down the disk manager and close all the file resources. Calling it again does nothing.
    */
   void ShutDown();
 
@@ -49,14 +69,90 @@ class DiskManager {
   void WritePage(page_id_t page_id, const char *page_data);
 
   /**
-   * Read a page from the database file.
+   * Read a page from the database file. Reads are positional and take no latch, so they run in parallel.
    * @param page_id id of the page
    * @param[out] page_data output buffer
    */
   void ReadPage(page_id_t page_id, char *page_data);
 
   /**
-   * Flush the entire log buffer into disk.
+   * Start reading and writing a batch of pages in the background. Each request's callback runs on an I/O thread once
+   * its page has been transferred; the buffers must stay valid until then. After ShutDown the requests are carried out
+   * synchronously instead.
+   * @param requests the requests, moved out of the vector
+   */
+  void SubmitPageIo(std::vector<PageIoRequest> *requests);
+
+  /** @return true if the database file is accessed with O_DIRECT */
+  auto IsDirectIo() const -> bool { return direct_io_; }
+
+  /** @return the backend carrying out asynchronous page I/O */
+  auto GetAsyncIoBackend() const -> AsyncIoBackend { return backend_; }
+
+  /**
+   * Read a batch of pages from the database file, with all the reads in flight at once.
+   * @param page_ids ids of the pages
+   * @param[out] page_data output buffers, one per page id
+   */
+  void ReadPages(const std::vector<page_id_t> &page_ids, const std::vector<char *> &page_data);
+
+  /**
+   * Record in the free-space map that a page is no longer used, so that its id can be allocated again.
+   * @param page_id id of the page
+   */
+  void DeallocatePage(page_id_t page_id);
+
+  /**
+   * Split the free pages into partitions, so that each buffer pool instance allocates from its own: extent i of
+   * extent_size pages belongs to partition i % num_partitions. The instances sharing a disk manager all pass the same
+   * layout; until then there is a single partition.
+   * @param num_partitions number of partitions
+   * @param extent_size number of consecutive page ids in the same partition
+   */
+  void PartitionFreePages(size_t num_partitions, size_t extent_size);
+
+  /**
+   * Take the lowest free page of a partition out of the free-space map, durably, so that a crash cannot leave the page
+   * free on disk once it is in use.
+   * @param partition the partition, e.g. the index of the buffer pool instance that owns its pages
+   * @return the id of the page, or INVALID_PAGE_ID if the partition has no free page
+   */
+  auto AllocateFreePage(size_t partition) -> page_id_t;
+
+  /** @return the number of pages in the free-space map */
+  auto GetNumFreePages() -> size_t;
+
+  /**
+   * @return one past the highest page id that the database file or the free-space map knows of; page ids from there
+   * on have never been written or freed
+   */
+  auto GetPageIdBound() -> page_id_t;
+
+  /**
+   * Give the space of free pages back to the file system: the database file is truncated after its last used page, and
+   * free pages before it become holes. Page ids are left alone, so this is safe while the database is running.
+   * @return the number of pages whose space was given back
+   */
+  auto Compact() -> size_t;
+
+  /**
+   * Make all the page writes completed so far, and the free-space map, durable.
+   */
+  void Sync();
+
+  /**
+   * Choose when page writes become durable. The default, ON_CHECKPOINT, relies on the log for durability between
+   * checkpoints, so page writes cost no syncs.
+   * @param policy the new policy
+   */
+  void SetPageSyncPolicy(PageSyncPolicy policy) { page_sync_policy_ = policy; }
+
+  /** @return when page writes become durable */
+  auto GetPageSyncPolicy() const -> PageSyncPolicy { return page_sync_policy_; }
+
+  /**
+   * Flush the entire log buffer into disk, returning once it is durable. Concurrent calls share their syncs: a call
+   * whose data an fdatasync already in progress does not cover waits for it and then syncs for everybody who waited.
    * @param log_data raw log data
    * @param size size of log entry
    */
@@ -71,6 +167,9 @@ class DiskManager {
    */
   auto ReadLog(char *log_data, int size, int offset) -> bool;
 
+  /** @return the size of the log file */
+  auto GetLogSize() -> int;
+
   /** @return the number of disk flushes */
   auto GetNumFlushes() const -> int;
 
@@ -80,6 +179,12 @@ class DiskManager {
   /** @return the number of disk writes */
   auto GetNumWrites() const -> int;
 
+  /** @return the number of fdatasyncs of the database file */
+  auto GetNumSyncs() const -> int { return num_syncs_; }
+
+  /** @return the number of fdatasyncs of the log file */
+  auto GetNumLogSyncs() const -> int { return num_log_syncs_; }
+
   /**
    * Sets the future which is used to check for non-blocking flushes.
    * @param f the non-blocking flush check
@@ -90,19 +195,77 @@ class DiskManager {
   inline auto HasFlushLogFuture() -> bool { return flush_log_f_ != nullptr; }
 
  private:
+  friend class ThreadPoolAsyncIo;
+  friend class UringAsyncIo;
+
   auto GetFileSize(const std::string &file_name) -> int;
-  // stream to write log file
-  std::fstream log_io_;
+  /** @return whether a page buffer can be handed to the kernel as it is */
+  auto IsAligned(const char *page_data) const -> bool;
+  /** Write a page to the database file without counting it or taking db_io_latch_. */
+  void WritePageData(page_id_t page_id, const char *page_data);
+  /** fdatasync the database file. */
+  void SyncDbFile();
+  /** Wait until the first log_end bytes of the log file are durable, syncing them if nobody else is. */
+  void SyncLog(size_t log_end);
+  /** Set the bit of a page in the free-space map, with fsm_latch_ held; the file is written by Sync and allocations. */
+  void SetFreeBit(page_id_t page_id, bool is_free);
+  /** @return whether the free-space map holds a page, with fsm_latch_ held */
+  auto IsFreePage(page_id_t page_id) const -> bool;
+  /** @return the free page partition of a page, with fsm_latch_ held */
+  auto FreePagePartition(page_id_t page_id) const -> size_t { return page_id / fsm_extent_size_ % free_pages_.size(); }
+  /** Write the bytes of the free-space map that changed since the last time out to its file, with fsm_latch_ held. */
+  void WriteFreeSpaceMap();
+  /** Wait, without db_io_latch_, until the asynchronous writes submitted before the call have completed. */
+  void WaitForWrites();
+  // descriptor of the log file, which is only appended to
+  int log_fd_{-1};
   std::string log_name_;
-  // stream to write db file
-  std::fstream db_io_;
+  // Bytes of the log file written, and made durable. A sync in progress covers the bytes written when it started.
+  size_t log_written_{0};
+  size_t log_synced_{0};
+  bool log_syncing_{false};
+  // protects the log writes and sync state
+  std::mutex log_latch_;
+  std::condition_variable log_sync_cv_;
+  std::atomic<int> num_log_syncs_{0};
+  // descriptor of the db file, read and written with positional I/O
+  int db_fd_{-1};
+  // With O_DIRECT, page buffers must be aligned to DIRECT_IO_ALIGNMENT; unaligned ones go through a bounce buffer.
+  bool direct_io_{false};
   std::string file_name_;
   int num_flushes_{0};
-  int num_writes_{0};
+  std::atomic<int> num_writes_{0};
+  std::atomic<int> num_syncs_{0};
+  std::atomic<PageSyncPolicy> page_sync_policy_{PageSyncPolicy::ON_CHECKPOINT};
+  // asynchronous page I/O; reset by ShutDown before the db file is closed
+  AsyncIoBackend backend_;
+  std::unique_ptr<AsyncIo> async_io_;
+  // protects async_io_, which submissions share and ShutDown takes exclusively
+  std::shared_mutex async_io_latch_;
+  // Sequence numbers of the asynchronous writes submitted and not completed yet, which Sync and Compact wait for
+  std::set<uint64_t> pending_writes_;
+  uint64_t next_write_seq_{0};
+  // protects pending_writes_ and next_write_seq_; pending_writes_cv_ is notified as writes complete
+  std::mutex pending_writes_latch_;
+  std::condition_variable pending_writes_cv_;
   bool flush_log_{false};
   std::future<void> *flush_log_f_{nullptr};
-  // With multiple buffer pool instances, need to protect file access
-  std::mutex db_io_latch_;
+  // Page reads and writes do not need to exclude each other. Writes, synchronous or submitted, share this latch;
+  // Compact takes it exclusively, so that it never truncates a page being written.
+  std::shared_mutex db_io_latch_;
+  // free-space map: a bitmap file with a bit per page of the db file, set while the page is free
+  int fsm_fd_{-1};
+  std::string fsm_name_;
+  std::vector<uint8_t> fsm_bitmap_;
+  // the bytes of the bitmap changed since it was last written out, from fsm_dirty_begin_ up to fsm_dirty_end_
+  size_t fsm_dirty_begin_{0};
+  size_t fsm_dirty_end_{0};
+  // the free pages, by partition, so that an allocation takes the first of its partition right away
+  std::vector<std::set<page_id_t>> free_pages_{1};
+  size_t fsm_extent_size_{1};
+  size_t num_free_pages_{0};
+  // protects the free-space map; taken before db_io_latch_ when both are needed
+  std::mutex fsm_latch_;
 };
 
 }  // namespace bustub
@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <iostream>
 
@@ -24,14 +26,20 @@ namespace bustub {
  * Page is the basic unit of storage within the database system. Page provides a wrapper for actual data pages being
  * held in main memory. Page also contains book-keeping information that is used by the buffer pool manager, e.g.
  * pin count, dirty flag, page id, etc.
+ *
+ * The data itself lives in the buffer pool's frame arena; a Page only points at its frame, so that the book-keeping of
+ * all the frames is packed together, away from the data. Every Page starts on a cache line of its own, which holds the
+ * fields the buffer pool touches on each pin and unpin (page id, pin count, dirty flag, page LSN and recLSN). The page
+ * latch starts on the next line, so that latching a page does not invalidate the line pins of the same page are
+ * working on.
  */
-class Page {
+class alignas(CACHE_LINE_SIZE) Page {
   // There is book-keeping information inside the page that should only be relevant to the buffer pool manager.
   friend class BufferPoolManagerInstance;
 
  public:
-  /** Constructor. Zeros out the page data. */
-  Page() { ResetMemory(); }
+  /** Constructor. The page has no data until the buffer pool gives it a frame. */
+  Page() = default;
 
   /** Default destructor. */
   ~Page() = default;
@@ -42,8 +50,8 @@ class Page {
   /** @return the page id of this page */
   inline auto GetPageId() -> page_id_t { return page_id_; }
 
-  /** @return the pin count of this page */
-  inline auto GetPinCount() -> int { return pin_count_; }
+  /** @return the pin count of this page (frames that the buffer pool has claimed for itself report no pins) */
+  inline auto GetPinCount() -> int { return std::max(pin_count_.load(), 0); }
 
   /** @return true if the page in memory has been modified from the page on disk, false otherwise */
   inline auto IsDirty() -> bool { return is_dirty_; }
@@ -57,14 +65,26 @@ class Page {
   /** Acquire the page read latch. */
   inline void RLatch() { rwlatch_.RLock(); }
 
+  /** Acquire the page read latch unless a writer has it or waits for it. @return true if the latch was acquired */
+  inline auto TryRLatch() -> bool { return rwlatch_.TryRLock(); }
+
   /** Release the page read latch. */
   inline void RUnlatch() { rwlatch_.RUnlock(); }
 
   /** @return the page LSN. */
   inline auto GetLSN() -> lsn_t { return *reinterpret_cast<lsn_t *>(GetData() + OFFSET_LSN); }
 
-  /** Sets the page LSN. */
-  inline void SetLSN(lsn_t lsn) { memcpy(GetData() + OFFSET_LSN, &lsn, sizeof(lsn_t)); }
+  /**
+   * Sets the page LSN. It is also kept in the book-keeping of the frame, where the buffer pool looks it up to force the
+   * log before writing the page back; other kinds of pages keep something else at OFFSET_LSN. The first LSN set since
+   * the frame was last clean is its recLSN.
+   */
+  inline void SetLSN(lsn_t lsn) {
+    memcpy(GetData() + OFFSET_LSN, &lsn, sizeof(lsn_t));
+    lsn_ = lsn;
+    lsn_t rec_lsn = INVALID_LSN;
+    rec_lsn_.compare_exchange_strong(rec_lsn, lsn);
+  }
 
  protected:
   static_assert(sizeof(page_id_t) == 4);
@@ -78,16 +98,31 @@ class Page {
   /** Zeroes out the data that is held within the page. */
   inline void ResetMemory() { memset(data_, OFFSET_PAGE_START, PAGE_SIZE); }
 
-  /** The actual data that is stored within a page. */
-  char data_[PAGE_SIZE]{};
-  /** The ID of this page. */
-  page_id_t page_id_ = INVALID_PAGE_ID;
-  /** The pin count of this page. */
-  int pin_count_ = 0;
-  /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
-  bool is_dirty_ = false;
-  /** Page latch. */
-  ReaderWriterLatch rwlatch_;
+  /** The actual data that is stored within a page, a PAGE_SIZE frame of the buffer pool's arena. */
+  char *data_ = nullptr;
+  /** The ID of this page. Atomic because buffer pool hits validate it without holding the buffer pool latch. */
+  std::atomic<page_id_t> page_id_ = INVALID_PAGE_ID;
+  /** The pin count of this page. Negative while the buffer pool has claimed the frame to evict, reuse or free it. */
+  std::atomic<int> pin_count_ = 0;
+  /**
+   * True if the page is dirty, i.e. it is different from its corresponding page on disk. Atomic because unpinning sets
+   * it without holding the buffer pool latch.
+   */
+  std::atomic<bool> is_dirty_ = false;
+  /**
+   * The LSN of the last logged change to a page held by the frame, INVALID_LSN if none was logged. It is not reset when
+   * the frame is given another page: the write-back of the old page, done after that, still needs it, and it only ever
+   * names a change that the log has to be durable up to anyway.
+   */
+  std::atomic<lsn_t> lsn_ = INVALID_LSN;
+  /**
+   * The LSN of the first logged change to the page since the frame last matched the page on disk, INVALID_LSN if there
+   * was none: no change that may be missing from disk is older. The buffer pool resets it when it maps the frame and
+   * when it writes the page back.
+   */
+  std::atomic<lsn_t> rec_lsn_ = INVALID_LSN;
+  /** Page latch, on cache lines of its own. */
+  alignas(CACHE_LINE_SIZE) ReaderWriterLatch rwlatch_;
 };
 
 }  // namespace bustub
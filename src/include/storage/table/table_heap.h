@@ -95,12 +95,18 @@ class TableHeap {
    * @param rid rid of the tuple to read
    * @param tuple output variable for the tuple
    * @param txn transaction performing the read
+   * @param strategy the access strategy to fetch the page with, nullptr for a plain fetch
    * @return true if the read was successful (i.e. the tuple exists)
    */
-  auto GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) -> bool;
+  auto GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, BufferAccessStrategy *strategy = nullptr) -> bool;
 
-  /** @return the begin iterator of this table */
-  auto Begin(Transaction *txn) -> TableIterator;
+  /**
+   * @param txn transaction performing the scan
+   * @param strategy the access strategy of a bulk scan, which then recycles a few frames instead of flooding the
+   * buffer pool; nullptr for a plain scan
+   * @return the begin iterator of this table
+   */
+  auto Begin(Transaction *txn, BufferAccessStrategy *strategy = nullptr) -> TableIterator;
 
   /** @return the end iterator of this table */
   auto End() -> TableIterator;
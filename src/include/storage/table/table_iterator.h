@@ -13,7 +13,9 @@
 #pragma once
 
 #include <cassert>
+#include <deque>
 
+#include "buffer/buffer_access_strategy.h"
 #include "common/rid.h"
 #include "concurrency/transaction.h"
 #include "storage/table/tuple.h"
@@ -21,6 +23,7 @@
 namespace bustub {
 
 class TableHeap;
+class TablePage;
 
 /**
  * TableIterator enables the sequential scan of a TableHeap.
@@ -29,10 +32,14 @@ class TableIterator {
   friend class Cursor;
 
  public:
-  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn);
+  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn, BufferAccessStrategy *strategy = nullptr);
 
   TableIterator(const TableIterator &other)
-      : table_heap_(other.table_heap_), tuple_(new Tuple(*other.tuple_)), txn_(other.txn_) {}
+      : table_heap_(other.table_heap_),
+        tuple_(new Tuple(*other.tuple_)),
+        txn_(other.txn_),
+        strategy_(other.strategy_),
+        read_ahead_(other.read_ahead_) {}
 
   ~TableIterator() { delete tuple_; }
 
@@ -54,13 +61,26 @@ class TableIterator {
     table_heap_ = other.table_heap_;
     *tuple_ = *other.tuple_;
     txn_ = other.txn_;
+    strategy_ = other.strategy_;
+    read_ahead_ = other.read_ahead_;
     return *this;
   }
 
  private:
+  /**
+   * Keep the strategy's read-ahead window of the pages that follow a page in the table's chain of pages in flight. The
+   * page after the last one read ahead is only known once that one is in, so the window fills up as the reads land.
+   * @param page the page the scan is on, pinned and read latched
+   */
+  void ReadAhead(TablePage *page);
+
   TableHeap *table_heap_;
   Tuple *tuple_;
   Transaction *txn_;
+  /** The access strategy the pages of the scan are fetched with, nullptr to go through the buffer pool as usual. */
+  BufferAccessStrategy *strategy_;
+  /** The pages read ahead of the scan, in the order of the chain. */
+  std::deque<page_id_t> read_ahead_;
 };
 
 }  // namespace bustub
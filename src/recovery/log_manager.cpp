@@ -12,6 +12,12 @@
 
 #include "recovery/log_manager.h"
 
+#include <algorithm>
+#include <cstring>
+#include <thread>  // NOLINT
+
+#include "common/macros.h"
+
 namespace bustub {
 /*
  * set enable_logging = true
@@ -22,33 +28,285 @@ namespace bustub {
  *
  * This thread runs forever until system shutdown/StopFlushThread
  */
-void LogManager::RunFlushThread() {}
+void LogManager::RunFlushThread() {
+  std::lock_guard<std::mutex> lck(latch_);
+  if (flush_thread_ != nullptr) {
+    return;
+  }
+  enable_logging = true;
+  stop_flush_thread_ = false;
+  flush_thread_ = new std::thread([this] {
+    std::unique_lock<std::mutex> lck(latch_);
+    while (!stop_flush_thread_) {
+      cv_.wait_for(lck, log_timeout, [&] { return flush_requested_ || stop_flush_thread_; });
+      flush_requested_ = false;
+      // Durable futures are fulfilled under latch_, so it is released for the flush.
+      lck.unlock();
+      Flush();
+      lck.lock();
+    }
+  });
+}
 
 /*
  * Stop and join the flush thread, set enable_logging = false
  */
-void LogManager::StopFlushThread() {}
+void LogManager::StopFlushThread() {
+  std::thread *flush_thread;
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    if (flush_thread_ == nullptr) {
+      return;
+    }
+    stop_flush_thread_ = true;
+    flush_thread = flush_thread_;
+  }
+  cv_.notify_one();
+  flush_thread->join();
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    delete flush_thread_;
+    flush_thread_ = nullptr;
+  }
+  // Records appended since the thread's last flush are not lost.
+  Flush();
+  enable_logging = false;
+}
 
 /*
  * append a log record into log buffer
  * you MUST set the log record's lsn within this method
  * @return: lsn that is assigned to this log record
- *
- *
- * example below
- * // First, serialize the must have fields(20 bytes in total)
- * log_record.lsn_ = next_lsn_++;
- * memcpy(log_buffer_ + offset_, &log_record, 20);
- * int pos = offset_ + 20;
- *
- * if (log_record.log_record_type_ == LogRecordType::INSERT) {
- *    memcpy(log_buffer_ + pos, &log_record.insert_rid_, sizeof(RID));
- *    pos += sizeof(RID);
- *    // we have provided serialize function for tuple class
- *    log_record.insert_tuple_.SerializeTo(log_buffer_ + pos);
- *  }
- *
  */
-auto LogManager::AppendLogRecord(LogRecord *log_record) -> lsn_t { return INVALID_LSN; }
+auto LogManager::AppendLogRecord(LogRecord *log_record) -> lsn_t {
+  // Reserve the next LSN and the space of the record at once, so that records are laid out in LSN order. The size of
+  // the record depends on its LSN, through the LSN and prevLSN deltas, so it is worked out again whenever the
+  // reservation is retried. The base LSN of a buffer only changes when a flush switches to the buffer, which changes
+  // the state and so fails a reservation made with the old base. A record that does not fit in the buffer being filled
+  // reserves nothing until that buffer has been flushed.
+  uint64_t state = append_state_.load();
+  lsn_t base_lsn;
+  size_t size;
+  while (true) {
+    base_lsn = base_lsns_[GetBufferIndex(state)];
+    size = log_record->EncodedSize(GetLsn(state), base_lsn);
+    BUSTUB_ASSERT(size <= RECORDS_CAPACITY, "a log record must fit in the log buffer");
+    if (GetOffset(state) + size > RECORDS_CAPACITY) {
+      {
+        std::scoped_lock flush_lck(flush_latch_);
+        // Whoever held the latch before may have flushed the buffer already.
+        if (GetOffset(append_state_.load()) + size > RECORDS_CAPACITY) {
+          FlushBuffer();
+        }
+      }
+      NotifyDurable();
+      state = append_state_.load();
+      continue;
+    }
+    if (append_state_.compare_exchange_weak(state, state + (uint64_t{1} << LSN_SHIFT) + size)) {
+      break;
+    }
+  }
+
+  // The space is ours, so the record is serialized in parallel with the other appends.
+  log_record->lsn_ = GetLsn(state);
+  log_record->size_ = static_cast<int32_t>(size);
+  auto index = GetBufferIndex(state);
+  SerializeLogRecord(*log_record, base_lsn, buffers_[index] + LogRecord::BLOCK_HEADER_SIZE + GetOffset(state));
+  filled_[index].fetch_add(size, std::memory_order_release);
+  return log_record->lsn_;
+}
+
+void LogManager::Flush() {
+  {
+    std::scoped_lock flush_lck(flush_latch_);
+    FlushBuffer();
+  }
+  NotifyDurable();
+}
+
+auto LogManager::GetDurableFuture(lsn_t lsn) -> std::future<void> {
+  std::promise<void> promise;
+  auto future = promise.get_future();
+  std::unique_lock<std::mutex> lck(latch_);
+  // The persistent LSN is checked under latch_, so a flush finishing now either is seen here or sees the promise.
+  if (persistent_lsn_ >= lsn) {
+    promise.set_value();
+    return future;
+  }
+  durable_waiters_.emplace_back(lsn, std::move(promise));
+  if (flush_thread_ == nullptr) {
+    lck.unlock();
+    Flush();
+    return future;
+  }
+  flush_requested_ = true;
+  cv_.notify_one();
+  return future;
+}
+
+void LogManager::NotifyDurable() {
+  std::lock_guard<std::mutex> lck(latch_);
+  lsn_t persistent_lsn = persistent_lsn_;
+  auto durable = std::partition(durable_waiters_.begin(), durable_waiters_.end(),
+                                [&](const auto &waiter) { return waiter.first > persistent_lsn; });
+  for (auto it = durable; it != durable_waiters_.end(); ++it) {
+    it->second.set_value();
+  }
+  durable_waiters_.erase(durable, durable_waiters_.end());
+}
+
+void LogManager::FlushBuffer() {
+  // Close the buffer being filled; records reserved from now on go to the other buffer, which the previous flush has
+  // written out, in a block starting at the next LSN. An empty buffer is left alone.
+  uint64_t state = append_state_.load();
+  do {
+    if (GetOffset(state) == 0) {
+      return;
+    }
+    base_lsns_[GetBufferIndex(state) ^ 1] = GetLsn(state);
+  } while (!append_state_.compare_exchange_weak(state, (state & ~OFFSET_MASK) ^ BUFFER_INDEX_BIT));
+
+  // Only the records reserved but not serialized yet hold the flush up.
+  auto index = GetBufferIndex(state);
+  auto end = GetOffset(state);
+  while (filled_[index].load(std::memory_order_acquire) < end) {
+    std::this_thread::yield();
+  }
+  // Frame the records as a block, in the space the buffer keeps for its header and trailer.
+  char *block = buffers_[index];
+  auto block_size = static_cast<int32_t>(LogRecord::BLOCK_HEADER_SIZE + end + LogRecord::BLOCK_TRAILER_SIZE);
+  lsn_t base_lsn = base_lsns_[index];
+  lsn_t num_records = GetLsn(state) - base_lsn;
+  memcpy(block, &block_size, sizeof(int32_t));
+  memcpy(block + sizeof(int32_t), &base_lsn, sizeof(lsn_t));
+  memcpy(block + sizeof(int32_t) + sizeof(lsn_t), &num_records, sizeof(lsn_t));
+  memcpy(block + LogRecord::BLOCK_HEADER_SIZE + end, &block_size, sizeof(int32_t));
+  disk_manager_->WriteLog(block, block_size);
+  filled_[index] = 0;
+  persistent_lsn_ = GetLsn(state) - 1;
+}
+
+/*
+ * the trailer of the last block leads to its header, which tells the next LSN, so only the end of the log is read. A
+ * log that ends in a block torn by a crash is walked block by block from the start instead, up to the torn block.
+ */
+auto LogManager::ReadLogTail() -> lsn_t {
+  int log_size = disk_manager_->GetLogSize();
+  lsn_t next_lsn = 0;
+  char trailer[LogRecord::BLOCK_TRAILER_SIZE];
+  if (log_size >= LogRecord::BLOCK_TRAILER_SIZE &&
+      disk_manager_->ReadLog(trailer, LogRecord::BLOCK_TRAILER_SIZE, log_size - LogRecord::BLOCK_TRAILER_SIZE)) {
+    int32_t block_size;
+    memcpy(&block_size, trailer, sizeof(int32_t));
+    if (block_size > 0 && ReadBlockHeader(log_size - block_size, log_size, &next_lsn) == block_size) {
+      return next_lsn;
+    }
+  }
+  int block_size;
+  for (int offset = 0; (block_size = ReadBlockHeader(offset, log_size, &next_lsn)) > 0; offset += block_size) {
+  }
+  return next_lsn;
+}
+
+auto LogManager::ReadBlockHeader(int offset, int log_size, lsn_t *next_lsn) -> int {
+  if (offset < 0 || log_size - offset < LogRecord::BLOCK_HEADER_SIZE + LogRecord::BLOCK_TRAILER_SIZE) {
+    return 0;
+  }
+  char header[LogRecord::BLOCK_HEADER_SIZE];
+  if (!disk_manager_->ReadLog(header, LogRecord::BLOCK_HEADER_SIZE, offset)) {
+    return 0;
+  }
+  int32_t block_size;
+  lsn_t base_lsn;
+  lsn_t num_records;
+  memcpy(&block_size, header, sizeof(int32_t));
+  memcpy(&base_lsn, header + sizeof(int32_t), sizeof(lsn_t));
+  memcpy(&num_records, header + sizeof(int32_t) + sizeof(lsn_t), sizeof(lsn_t));
+  if (block_size < LogRecord::BLOCK_HEADER_SIZE + LogRecord::BLOCK_TRAILER_SIZE || block_size > LOG_BUFFER_SIZE ||
+      block_size > log_size - offset) {
+    return 0;
+  }
+  // A block is complete once its trailer repeats its size.
+  char trailer[LogRecord::BLOCK_TRAILER_SIZE];
+  int32_t trailer_size;
+  int trailer_offset = offset + block_size - LogRecord::BLOCK_TRAILER_SIZE;
+  if (!disk_manager_->ReadLog(trailer, LogRecord::BLOCK_TRAILER_SIZE, trailer_offset)) {
+    return 0;
+  }
+  memcpy(&trailer_size, trailer, sizeof(int32_t));
+  if (trailer_size != block_size) {
+    return 0;
+  }
+  *next_lsn = base_lsn + num_records;
+  return block_size;
+}
+
+/*
+ * serialize the header, then the fields of the record type, as laid out in log_record.h
+ */
+void LogManager::SerializeLogRecord(const LogRecord &log_record, lsn_t base_lsn, char *data) {
+  size_t pos = LogRecord::PutVarint(data, log_record.BodySize(log_record.lsn_, base_lsn));
+  data[pos++] = static_cast<char>(static_cast<uint8_t>(log_record.log_record_type_) |
+                                  (log_record.compensation_ ? LogRecord::COMPENSATION_BIT : 0));
+  pos += LogRecord::PutVarint(data + pos, log_record.lsn_ - base_lsn);
+  pos += LogRecord::PutVarint(data + pos, log_record.txn_id_ + 1);
+  pos += LogRecord::PutVarint(data + pos, log_record.PrevLsnDelta(log_record.lsn_));
+  if (log_record.compensation_) {
+    pos += LogRecord::PutVarint(data + pos, log_record.UndoNextLsnDelta(log_record.lsn_));
+  }
+
+  auto put_rid = [&](const RID &rid) {
+    pos += LogRecord::PutVarint(data + pos, rid.GetPageId() + 1);
+    pos += LogRecord::PutVarint(data + pos, rid.GetSlotNum());
+  };
+  auto put_bytes = [&](const char *bytes, size_t length) {
+    pos += LogRecord::PutVarint(data + pos, length);
+    if (length > 0) {
+      memcpy(data + pos, bytes, length);
+      pos += length;
+    }
+  };
+  switch (log_record.log_record_type_) {
+    case LogRecordType::INSERT:
+      put_rid(log_record.insert_rid_);
+      put_bytes(log_record.insert_tuple_.GetData(), log_record.insert_tuple_.GetLength());
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      put_rid(log_record.delete_rid_);
+      put_bytes(log_record.delete_tuple_.GetData(), log_record.delete_tuple_.GetLength());
+      break;
+    case LogRecordType::UPDATE:
+      put_rid(log_record.update_rid_);
+      pos += LogRecord::PutVarint(data + pos, log_record.update_prefix_);
+      pos += LogRecord::PutVarint(data + pos, log_record.update_suffix_);
+      put_bytes(log_record.old_range_.data(), log_record.old_range_.size());
+      put_bytes(log_record.new_range_.data(), log_record.new_range_.size());
+      break;
+    case LogRecordType::NEWPAGE:
+      pos += LogRecord::PutVarint(data + pos, log_record.prev_page_id_ + 1);
+      pos += LogRecord::PutVarint(data + pos, log_record.page_id_ + 1);
+      break;
+    case LogRecordType::CHECKPOINT:
+      pos += LogRecord::PutVarint(data + pos, log_record.begin_lsn_ + 1);
+      pos += LogRecord::PutVarint(data + pos, log_record.parts_left_);
+      pos += LogRecord::PutVarint(data + pos, log_record.active_txns_.size());
+      for (const auto &[txn_id, last_lsn] : log_record.active_txns_) {
+        pos += LogRecord::PutVarint(data + pos, txn_id + 1);
+        pos += LogRecord::PutVarint(data + pos, last_lsn + 1);
+      }
+      pos += LogRecord::PutVarint(data + pos, log_record.dirty_pages_.size());
+      for (const auto &[page_id, rec_lsn] : log_record.dirty_pages_) {
+        pos += LogRecord::PutVarint(data + pos, page_id + 1);
+        pos += LogRecord::PutVarint(data + pos, rec_lsn + 1);
+      }
+      break;
+    default:
+      break;
+  }
+  BUSTUB_ASSERT(pos == static_cast<size_t>(log_record.size_), "a log record must fill the space reserved for it");
+}
 
 }  // namespace bustub
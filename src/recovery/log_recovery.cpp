@@ -12,29 +12,618 @@
 
 #include "recovery/log_recovery.h"
 
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <future>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <unordered_set>
+
+#include "common/logger.h"
 #include "storage/page/table_page.h"
 
 namespace bustub {
 /*
- * deserialize a log record from log buffer
+ * a block is complete once its trailer repeats the size in its header
+ */
+auto LogRecovery::DeserializeBlockHeader(const char *data, int size, lsn_t *base_lsn) -> int {
+  if (size < LogRecord::BLOCK_HEADER_SIZE) {
+    return 0;
+  }
+  int32_t block_size;
+  memcpy(&block_size, data, sizeof(int32_t));
+  // Space that was never written reads as zeroes.
+  if (block_size < LogRecord::BLOCK_HEADER_SIZE + LogRecord::BLOCK_TRAILER_SIZE || block_size > LOG_BUFFER_SIZE) {
+    return -1;
+  }
+  if (block_size > size) {
+    return 0;
+  }
+  int32_t trailer_size;
+  memcpy(&trailer_size, data + block_size - LogRecord::BLOCK_TRAILER_SIZE, sizeof(int32_t));
+  if (trailer_size != block_size) {
+    return -1;
+  }
+  memcpy(base_lsn, data + sizeof(int32_t), sizeof(lsn_t));
+  return block_size;
+}
+
+/*
+ * deserialize a log record from log buffer, laid out as in log_record.h
  * @return: true means deserialize succeed, otherwise can't deserialize cause
  * incomplete log record
  */
-auto LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) -> bool { return false; }
+auto LogRecovery::DeserializeLogRecord(const char *data, int size, lsn_t base_lsn, LogRecord *log_record) -> bool {
+  const char *end = data + size;
+  const char *pos = data;
+  bool ok = true;
+  auto get_varint = [&]() -> uint64_t {
+    uint64_t value = 0;
+    size_t length = ok ? LogRecord::GetVarint(pos, end, &value) : 0;
+    ok = ok && length > 0;
+    pos += length;
+    return value;
+  };
+
+  uint64_t body_size = get_varint();
+  // A zero length is where the log ends, e.g. in space that was never written.
+  if (!ok || body_size == 0 || body_size > static_cast<uint64_t>(end - pos)) {
+    return false;
+  }
+  end = pos + body_size;
+  log_record->size_ = static_cast<int32_t>(end - data);
+  auto type = static_cast<uint8_t>(*pos++);
+  log_record->log_record_type_ = static_cast<LogRecordType>(type & ~LogRecord::COMPENSATION_BIT);
+  log_record->compensation_ = (type & LogRecord::COMPENSATION_BIT) != 0;
+  log_record->lsn_ = base_lsn + static_cast<lsn_t>(get_varint());
+  log_record->txn_id_ = static_cast<txn_id_t>(get_varint()) - 1;
+  auto prev_lsn_delta = static_cast<lsn_t>(get_varint());
+  log_record->prev_lsn_ = prev_lsn_delta == 0 ? INVALID_LSN : log_record->lsn_ - prev_lsn_delta;
+  log_record->undo_next_lsn_ = INVALID_LSN;
+  if (log_record->compensation_) {
+    auto undo_next_lsn_delta = static_cast<lsn_t>(get_varint());
+    log_record->undo_next_lsn_ = undo_next_lsn_delta == 0 ? INVALID_LSN : log_record->lsn_ - undo_next_lsn_delta;
+  }
+
+  auto get_rid = [&]() {
+    auto page_id = static_cast<page_id_t>(get_varint()) - 1;
+    auto slot_num = static_cast<uint32_t>(get_varint());
+    return RID(page_id, slot_num);
+  };
+  auto get_bytes = [&](std::string *bytes) {
+    uint64_t length = get_varint();
+    ok = ok && length <= static_cast<uint64_t>(end - pos);
+    if (ok) {
+      bytes->assign(pos, length);
+      pos += length;
+    }
+  };
+  auto get_tuple = [&](Tuple *tuple) {
+    std::string bytes;
+    get_bytes(&bytes);
+    auto length = static_cast<uint32_t>(bytes.size());
+    bytes.insert(0, reinterpret_cast<const char *>(&length), sizeof(uint32_t));
+    tuple->DeserializeFrom(bytes.data());
+  };
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      log_record->insert_rid_ = get_rid();
+      get_tuple(&log_record->insert_tuple_);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      log_record->delete_rid_ = get_rid();
+      get_tuple(&log_record->delete_tuple_);
+      break;
+    case LogRecordType::UPDATE:
+      log_record->update_rid_ = get_rid();
+      log_record->update_prefix_ = static_cast<uint32_t>(get_varint());
+      log_record->update_suffix_ = static_cast<uint32_t>(get_varint());
+      get_bytes(&log_record->old_range_);
+      get_bytes(&log_record->new_range_);
+      break;
+    case LogRecordType::NEWPAGE:
+      log_record->prev_page_id_ = static_cast<page_id_t>(get_varint()) - 1;
+      log_record->page_id_ = static_cast<page_id_t>(get_varint()) - 1;
+      break;
+    case LogRecordType::CHECKPOINT: {
+      log_record->begin_lsn_ = static_cast<lsn_t>(get_varint()) - 1;
+      log_record->parts_left_ = static_cast<uint32_t>(get_varint());
+      log_record->active_txns_.clear();
+      for (uint64_t count = get_varint(); ok && count > 0; --count) {
+        auto txn_id = static_cast<txn_id_t>(get_varint()) - 1;
+        log_record->active_txns_[txn_id] = static_cast<lsn_t>(get_varint()) - 1;
+      }
+      log_record->dirty_pages_.clear();
+      for (uint64_t count = get_varint(); ok && count > 0; --count) {
+        auto page_id = static_cast<page_id_t>(get_varint()) - 1;
+        log_record->dirty_pages_[page_id] = static_cast<lsn_t>(get_varint()) - 1;
+      }
+      break;
+    }
+    case LogRecordType::BEGIN:
+    case LogRecordType::COMMIT:
+    case LogRecordType::ABORT:
+      break;
+    default:
+      return false;
+  }
+  return ok && pos == end;
+}
 
 /*
  *redo phase on TABLE PAGE level(table/table_page.h)
- *read log file from the beginning to end (you must prefetch log records into
- *log buffer to reduce unnecessary I/O operations), remember to compare page's
- *LSN with log_record's sequence number, and also build active_txn_ table &
- *lsn_mapping_ table
+ *first read the log from the last checkpoint on to build active_txn_ & lsn_mapping_ table, starting from the
+ *checkpoint's active transaction table, then read it again from the point redo has to start at, which the
+ *checkpoint's dirty page table tells, and replay each record on its page in a worker chosen by page id, comparing the
+ *page's LSN with the record's. Both passes read the log sequentially, prefetching RECOVERY_READ_SIZE bytes at a time.
  */
-void LogRecovery::Redo() {}
+void LogRecovery::Redo() {
+  int analysis_offset = FindLastCheckpoint(&mapped_base_lsn_);
+  mapped_offset_ = analysis_offset;
+  LogRecord checkpoint;
+  // The records of a checkpoint read so far; a checkpoint cut short by a crash is left for the one before.
+  LogRecord checkpoint_parts;
+  // The checkpoint may list transactions whose COMMIT or ABORT record analysis has read already.
+  std::unordered_set<txn_id_t> ended_txns;
+  ScanLog(analysis_offset, [&](LogRecord *log_record, const LogPosition &position) {
+    lsn_mapping_[log_record->lsn_] = position;
+    switch (log_record->log_record_type_) {
+      case LogRecordType::CHECKPOINT:
+        if (checkpoint_parts.begin_lsn_ != log_record->begin_lsn_) {
+          checkpoint_parts = *log_record;
+        } else {
+          checkpoint_parts.active_txns_.insert(log_record->active_txns_.begin(), log_record->active_txns_.end());
+          checkpoint_parts.dirty_pages_.insert(log_record->dirty_pages_.begin(), log_record->dirty_pages_.end());
+        }
+        if (log_record->parts_left_ == 0) {
+          checkpoint = checkpoint_parts;
+          // A transaction that logged nothing since analysis started is only known from the checkpoint.
+          for (const auto &[txn_id, last_lsn] : checkpoint.active_txns_) {
+            if (ended_txns.count(txn_id) == 0) {
+              auto active = active_txn_.emplace(txn_id, last_lsn).first;
+              active->second = std::max(active->second, last_lsn);
+            }
+          }
+        }
+        break;
+      case LogRecordType::COMMIT:
+      case LogRecordType::ABORT:
+        active_txn_.erase(log_record->txn_id_);
+        ended_txns.insert(log_record->txn_id_);
+        break;
+      default:
+        active_txn_[log_record->txn_id_] = log_record->lsn_;
+        break;
+    }
+  });
+  if (lsn_mapping_.empty()) {
+    return;
+  }
+
+  // Changes logged before the checkpoint began are on disk unless their page was dirty then and they are no older than
+  // the page's recLSN. Redo starts at the oldest change that may not be.
+  auto &dirty_pages = checkpoint.dirty_pages_;
+  lsn_t begin_lsn = checkpoint.lsn_ == INVALID_LSN ? 0 : checkpoint.begin_lsn_;
+  lsn_t redo_lsn = begin_lsn;
+  if (checkpoint.lsn_ != INVALID_LSN) {
+    for (const auto &[page_id, rec_lsn] : dirty_pages) {
+      redo_lsn = std::min(redo_lsn, rec_lsn);
+    }
+  }
+  // Redo reads the log from the block holding that change, which may come before the checkpoint; the records before it
+  // in the block are skipped below.
+  int redo_offset;
+  {
+    std::lock_guard<std::mutex> lck(mapping_latch_);
+    MapLogBack(redo_lsn);
+    auto redo_position = lsn_mapping_.find(redo_lsn);
+    redo_offset = redo_position == lsn_mapping_.end() ? mapped_offset_ : redo_position->second.block_offset_;
+  }
+
+  std::vector<RedoQueue> queues(NumWorkers());
+  std::vector<std::thread> workers;
+  for (auto &queue : queues) {
+    workers.emplace_back([&] { RunRedoWorker(&queue); });
+  }
+  auto dispatch = [&](page_id_t page_id, const LogRecord &log_record) {
+    if (log_record.lsn_ < begin_lsn) {
+      auto dirty_page = dirty_pages.find(page_id);
+      if (dirty_page == dirty_pages.end() || log_record.lsn_ < dirty_page->second) {
+        return;
+      }
+    }
+    Dispatch(page_id, log_record, &queues);
+  };
+  ScanLog(redo_offset, [&](LogRecord *log_record, const LogPosition & /*position*/) {
+    switch (log_record->log_record_type_) {
+      case LogRecordType::INSERT:
+        dispatch(log_record->insert_rid_.GetPageId(), *log_record);
+        break;
+      case LogRecordType::MARKDELETE:
+      case LogRecordType::APPLYDELETE:
+      case LogRecordType::ROLLBACKDELETE:
+        dispatch(log_record->delete_rid_.GetPageId(), *log_record);
+        break;
+      case LogRecordType::UPDATE:
+        dispatch(log_record->update_rid_.GetPageId(), *log_record);
+        break;
+      case LogRecordType::NEWPAGE:
+        // Both the new page and the page it is linked after change.
+        dispatch(log_record->page_id_, *log_record);
+        if (log_record->prev_page_id_ != INVALID_PAGE_ID) {
+          dispatch(log_record->prev_page_id_, *log_record);
+        }
+        break;
+      default:
+        break;
+    }
+  });
+
+  for (auto &queue : queues) {
+    std::lock_guard<std::mutex> lck(queue.latch_);
+    queue.done_ = true;
+    queue.cv_.notify_all();
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void LogRecovery::ScanLog(int offset, const std::function<void(LogRecord *, const LogPosition &)> &visit) {
+  auto read_chunk = [this](int offset) {
+    std::vector<char> chunk(RECOVERY_READ_SIZE);
+    if (!disk_manager_->ReadLog(chunk.data(), RECOVERY_READ_SIZE, offset)) {
+      chunk.clear();
+    }
+    return chunk;
+  };
+  // The bytes of the log from file offset window_offset on, which start with a block: a block cut off at the end of
+  // one read is completed by the next.
+  std::vector<char> window;
+  int window_offset = offset;
+  int read_offset = offset;
+  auto next_chunk = std::async(std::launch::async, read_chunk, read_offset);
+  while (true) {
+    auto chunk = next_chunk.get();
+    if (chunk.empty()) {
+      break;
+    }
+    read_offset += RECOVERY_READ_SIZE;
+    next_chunk = std::async(std::launch::async, read_chunk, read_offset);
+    window.insert(window.end(), chunk.begin(), chunk.end());
+
+    size_t pos = 0;
+    int block_size;
+    LogPosition position{};
+    while ((block_size = DeserializeBlockHeader(window.data() + pos, static_cast<int>(window.size() - pos),
+                                                &position.base_lsn_)) > 0) {
+      position.block_offset_ = window_offset + static_cast<int>(pos);
+      ScanBlock(window.data() + pos, block_size, position, visit);
+      pos += block_size;
+    }
+    // Past the last complete block is where the log ends, possibly in a block torn by a crash.
+    if (block_size < 0) {
+      break;
+    }
+    window.erase(window.begin(), window.begin() + pos);
+    window_offset += static_cast<int>(pos);
+  }
+}
+
+void LogRecovery::ScanBlock(const char *data, int block_size, LogPosition position,
+                            const std::function<void(LogRecord *, const LogPosition &)> &visit) {
+  LogRecord log_record;
+  const char *record = data + LogRecord::BLOCK_HEADER_SIZE;
+  const char *end = data + block_size - LogRecord::BLOCK_TRAILER_SIZE;
+  while (record < end) {
+    if (!DeserializeLogRecord(record, static_cast<int>(end - record), position.base_lsn_, &log_record)) {
+      LOG_WARN("log block at offset %d holds a malformed record", position.block_offset_);
+      break;
+    }
+    position.offset_ = position.block_offset_ + static_cast<int>(record - data);
+    visit(&log_record, position);
+    record += log_record.size_;
+  }
+}
+
+auto LogRecovery::ReadBlockBefore(int end_offset, std::vector<char> *block, lsn_t *base_lsn) -> int {
+  if (end_offset < LogRecord::BLOCK_HEADER_SIZE + LogRecord::BLOCK_TRAILER_SIZE) {
+    return -1;
+  }
+  char trailer[LogRecord::BLOCK_TRAILER_SIZE];
+  if (!disk_manager_->ReadLog(trailer, LogRecord::BLOCK_TRAILER_SIZE, end_offset - LogRecord::BLOCK_TRAILER_SIZE)) {
+    return -1;
+  }
+  int32_t block_size;
+  memcpy(&block_size, trailer, sizeof(int32_t));
+  if (block_size <= 0 || block_size > end_offset || block_size > LOG_BUFFER_SIZE) {
+    return -1;
+  }
+  int offset = end_offset - block_size;
+  block->resize(block_size);
+  if (!disk_manager_->ReadLog(block->data(), block_size, offset) ||
+      DeserializeBlockHeader(block->data(), block_size, base_lsn) != block_size) {
+    return -1;
+  }
+  return offset;
+}
+
+/*
+ * the trailer of each block leads back to its start, so the log is read backwards from its end, a block at a time,
+ * only as far as the last checkpoint logged whole. A log that ends in a block torn by a crash is read from the start.
+ */
+auto LogRecovery::FindLastCheckpoint(lsn_t *base_lsn) -> int {
+  std::vector<char> block;
+  lsn_t begin_lsn = INVALID_LSN;
+  for (int offset = disk_manager_->GetLogSize(); offset > 0;) {
+    offset = ReadBlockBefore(offset, &block, base_lsn);
+    if (offset < 0) {
+      break;
+    }
+    if (begin_lsn == INVALID_LSN) {
+      ScanBlock(block.data(), static_cast<int>(block.size()), LogPosition{offset, *base_lsn, offset},
+                [&](LogRecord *log_record, const LogPosition & /*position*/) {
+                  if (log_record->log_record_type_ == LogRecordType::CHECKPOINT && log_record->parts_left_ == 0) {
+                    begin_lsn = log_record->begin_lsn_;
+                  }
+                });
+    }
+    // Every record of the checkpoint, and every change logged since it began, is in this block or after it.
+    if (begin_lsn != INVALID_LSN && *base_lsn <= begin_lsn) {
+      return offset;
+    }
+  }
+  *base_lsn = 0;
+  return 0;
+}
+
+void LogRecovery::MapLogBack(lsn_t lsn) {
+  std::vector<char> block;
+  while (mapped_offset_ > 0 && lsn < mapped_base_lsn_) {
+    lsn_t base_lsn;
+    int offset = ReadBlockBefore(mapped_offset_, &block, &base_lsn);
+    if (offset < 0) {
+      LOG_WARN("no log block ends at offset %d", mapped_offset_);
+      return;
+    }
+    ScanBlock(block.data(), static_cast<int>(block.size()), LogPosition{offset, base_lsn, offset},
+              [&](LogRecord *log_record, const LogPosition &position) { lsn_mapping_[log_record->lsn_] = position; });
+    mapped_offset_ = offset;
+    mapped_base_lsn_ = base_lsn;
+  }
+}
 
 /*
  *undo phase on TABLE PAGE level(table/table_page.h)
- *iterate through active txn map and undo each operation
+ *iterate through active txn map and undo each operation, with the transactions spread over the threads. Each change
+ *undone is logged as a CLR, and each transaction rolled back ends with an ABORT record, so that a crash during undo
+ *leaves the next recovery only the changes not undone yet.
  */
-void LogRecovery::Undo() {}
+void LogRecovery::Undo() {
+  std::vector<std::pair<txn_id_t, lsn_t>> losers(active_txn_.begin(), active_txn_.end());
+  std::atomic<size_t> next_loser{0};
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < std::min(NumWorkers(), losers.size()); ++i) {
+    workers.emplace_back([&] {
+      for (auto loser = next_loser++; loser < losers.size(); loser = next_loser++) {
+        UndoTransaction(losers[loser].first, losers[loser].second);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  active_txn_.clear();
+}
+
+void LogRecovery::Dispatch(page_id_t page_id, const LogRecord &log_record, std::vector<RedoQueue> *queues) {
+  auto &queue = (*queues)[static_cast<size_t>(page_id) % queues->size()];
+  std::unique_lock<std::mutex> lck(queue.latch_);
+  queue.cv_.wait(lck, [&] { return queue.records_.size() < REDO_QUEUE_CAPACITY; });
+  queue.records_.emplace_back(page_id, log_record);
+  queue.cv_.notify_all();
+}
+
+void LogRecovery::RunRedoWorker(RedoQueue *queue) {
+  std::deque<std::pair<page_id_t, LogRecord>> records;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lck(queue->latch_);
+      queue->cv_.wait(lck, [&] { return !queue->records_.empty() || queue->done_; });
+      if (queue->records_.empty()) {
+        return;
+      }
+      records.swap(queue->records_);
+      queue->cv_.notify_all();
+    }
+    for (auto &[page_id, log_record] : records) {
+      RedoRecord(page_id, &log_record);
+    }
+    records.clear();
+  }
+}
+
+auto LogRecovery::NumWorkers() const -> size_t {
+  return std::max<size_t>(1, std::min(num_threads_, buffer_pool_manager_->GetPoolSize()));
+}
+
+/*
+ * a worker pins one page at a time, so when every frame it could use is pinned, e.g. in one instance of a parallel
+ * buffer pool, the other workers are about to unpin theirs
+ */
+auto LogRecovery::FetchWorkerPage(page_id_t page_id) -> Page * {
+  Page *page;
+  while ((page = buffer_pool_manager_->FetchPage(page_id)) == nullptr) {
+    std::this_thread::yield();
+  }
+  return page;
+}
+
+void LogRecovery::RedoRecord(page_id_t page_id, LogRecord *log_record) {
+  auto *page = reinterpret_cast<TablePage *>(FetchWorkerPage(page_id));
+  page->WLatch();
+  bool dirty = false;
+  if (log_record->log_record_type_ == LogRecordType::NEWPAGE && page_id != log_record->page_id_) {
+    // Linking the new page changes no LSN; a page never gets unlinked, so the link is safe to set again.
+    if (page->GetNextPageId() != log_record->page_id_) {
+      page->SetNextPageId(log_record->page_id_);
+      dirty = true;
+    }
+  } else if (page->GetLSN() < log_record->lsn_ ||
+             (log_record->log_record_type_ == LogRecordType::NEWPAGE &&
+              (page->GetTablePageId() != page_id || page->GetPrevPageId() != log_record->prev_page_id_))) {
+    // A page that never reached the disk reads as zeroes, page LSN included, so it is initialized unless its header
+    // shows that it was.
+    RID rid;
+    Tuple tuple;
+    switch (log_record->log_record_type_) {
+      case LogRecordType::INSERT:
+        page->InsertTuple(log_record->insert_tuple_, &rid, nullptr, nullptr, nullptr);
+        BUSTUB_ASSERT(rid == log_record->insert_rid_, "a replayed insert must take the slot it took before");
+        break;
+      case LogRecordType::MARKDELETE:
+        page->MarkDelete(log_record->delete_rid_, nullptr, nullptr, nullptr);
+        break;
+      case LogRecordType::APPLYDELETE:
+        page->ApplyDelete(log_record->delete_rid_, nullptr, nullptr);
+        break;
+      case LogRecordType::ROLLBACKDELETE:
+        page->RollbackDelete(log_record->delete_rid_, nullptr, nullptr);
+        break;
+      case LogRecordType::UPDATE:
+        page->GetTuple(log_record->update_rid_, &tuple, nullptr, nullptr);
+        page->UpdateTuple(log_record->RedoUpdate(tuple), &tuple, log_record->update_rid_, nullptr, nullptr, nullptr);
+        break;
+      case LogRecordType::NEWPAGE:
+        page->Init(page_id, PAGE_SIZE, log_record->prev_page_id_, nullptr, nullptr);
+        break;
+      default:
+        break;
+    }
+    page->SetLSN(log_record->lsn_);
+    dirty = true;
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, dirty);
+}
+
+void LogRecovery::UndoTransaction(txn_id_t txn_id, lsn_t last_lsn) {
+  LogRecord log_record;
+  lsn_t prev_lsn = last_lsn;
+  lsn_t lsn = last_lsn;
+  while (lsn != INVALID_LSN) {
+    if (!ReadLogRecord(lsn, &log_record)) {
+      LOG_WARN("log record %d of a transaction to undo is missing", lsn);
+      return;
+    }
+    // An earlier recovery undid the changes from here back to the CLR's undoNextLSN already.
+    if (log_record.compensation_) {
+      lsn = log_record.undo_next_lsn_;
+      continue;
+    }
+    UndoRecord(&log_record, &prev_lsn);
+    lsn = log_record.prev_lsn_;
+  }
+  LogRecord abort(txn_id, prev_lsn, LogRecordType::ABORT);
+  log_manager_->AppendLogRecord(&abort);
+}
+
+void LogRecovery::UndoRecord(LogRecord *log_record, lsn_t *prev_lsn) {
+  page_id_t page_id;
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      page_id = log_record->insert_rid_.GetPageId();
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      page_id = log_record->delete_rid_.GetPageId();
+      break;
+    case LogRecordType::UPDATE:
+      page_id = log_record->update_rid_.GetPageId();
+      break;
+    default:
+      // A new page is left in the table, empty once the tuples inserted into it are undone.
+      return;
+  }
+  auto *page = reinterpret_cast<TablePage *>(FetchWorkerPage(page_id));
+  // Other losers may change other tuples of the same page at the same time.
+  page->WLatch();
+  // The CLR records the change that undoes the record's, which redo replays like any other.
+  txn_id_t txn_id = log_record->txn_id_;
+  LogRecord clr;
+  RID rid;
+  Tuple tuple;
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      page->ApplyDelete(log_record->insert_rid_, nullptr, nullptr);
+      clr = LogRecord(txn_id, *prev_lsn, LogRecordType::APPLYDELETE, log_record->insert_rid_,
+                      log_record->insert_tuple_);
+      break;
+    case LogRecordType::MARKDELETE:
+      page->RollbackDelete(log_record->delete_rid_, nullptr, nullptr);
+      clr = LogRecord(txn_id, *prev_lsn, LogRecordType::ROLLBACKDELETE, log_record->delete_rid_,
+                      log_record->delete_tuple_);
+      break;
+    case LogRecordType::APPLYDELETE:
+      page->InsertTuple(log_record->delete_tuple_, &rid, nullptr, nullptr, nullptr);
+      clr = LogRecord(txn_id, *prev_lsn, LogRecordType::INSERT, rid, log_record->delete_tuple_);
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      page->MarkDelete(log_record->delete_rid_, nullptr, nullptr, nullptr);
+      clr = LogRecord(txn_id, *prev_lsn, LogRecordType::MARKDELETE, log_record->delete_rid_,
+                      log_record->delete_tuple_);
+      break;
+    case LogRecordType::UPDATE: {
+      page->GetTuple(log_record->update_rid_, &tuple, nullptr, nullptr);
+      Tuple undone = log_record->UndoUpdate(tuple);
+      page->UpdateTuple(undone, &tuple, log_record->update_rid_, nullptr, nullptr, nullptr);
+      clr = LogRecord(txn_id, *prev_lsn, LogRecordType::UPDATE, log_record->update_rid_, tuple, undone);
+      break;
+    }
+    default:
+      break;
+  }
+  clr.SetUndoNextLSN(log_record->prev_lsn_);
+  *prev_lsn = log_manager_->AppendLogRecord(&clr);
+  page->SetLSN(*prev_lsn);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
+
+auto LogRecovery::ReadLogRecord(lsn_t lsn, LogRecord *log_record) -> bool {
+  LogPosition position;
+  {
+    std::lock_guard<std::mutex> lck(mapping_latch_);
+    // A loser may go back past the last checkpoint, where analysis started.
+    MapLogBack(lsn);
+    auto mapped = lsn_mapping_.find(lsn);
+    if (mapped == lsn_mapping_.end()) {
+      return false;
+    }
+    position = mapped->second;
+  }
+  int offset = position.offset_;
+  // Most records fit in a small read; the length prefix tells how much more to read for the others.
+  std::vector<char> data(CACHE_LINE_SIZE);
+  if (!disk_manager_->ReadLog(data.data(), static_cast<int>(data.size()), offset)) {
+    return false;
+  }
+  uint64_t body_size;
+  auto prefix_size = LogRecord::GetVarint(data.data(), data.data() + data.size(), &body_size);
+  if (prefix_size == 0) {
+    return false;
+  }
+  if (prefix_size + body_size > data.size()) {
+    data.resize(prefix_size + body_size);
+    if (!disk_manager_->ReadLog(data.data(), static_cast<int>(data.size()), offset)) {
+      return false;
+    }
+  }
+  return DeserializeLogRecord(data.data(), static_cast<int>(data.size()), position.base_lsn_, log_record);
+}
 
 }  // namespace bustub
@@ -0,0 +1,273 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// async_io.cpp
+//
+// Identification: src/storage/disk/async_io.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/async_io.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include "common/logger.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+ThreadPoolAsyncIo::ThreadPoolAsyncIo(DiskManager *disk_manager, size_t num_threads) : disk_manager_(disk_manager) {
+  for (size_t i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPoolAsyncIo::RunWorker, this);
+  }
+}
+
+ThreadPoolAsyncIo::~ThreadPoolAsyncIo() {
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPoolAsyncIo::Submit(std::vector<PageIoRequest> *requests) {
+  {
+    std::lock_guard<std::mutex> lck(latch_);
+    for (auto &request : *requests) {
+      queue_.push_back(std::move(request));
+    }
+  }
+  cv_.notify_all();
+}
+
+void ThreadPoolAsyncIo::RunWorker() {
+  std::unique_lock<std::mutex> lck(latch_);
+  while (true) {
+    cv_.wait(lck, [&] { return stop_ || !queue_.empty(); });
+    // Callbacks may queue follow-up I/O, so the queue is drained even when stopping.
+    if (queue_.empty()) {
+      break;
+    }
+    auto request = std::move(queue_.front());
+    queue_.pop_front();
+    lck.unlock();
+    if (request.is_write_) {
+      disk_manager_->WritePageData(request.page_id_, request.data_);
+    } else {
+      disk_manager_->ReadPage(request.page_id_, request.data_);
+    }
+    if (request.callback_) {
+      request.callback_();
+    }
+    lck.lock();
+  }
+}
+
+static auto IoUringSetup(unsigned entries, io_uring_params *params) -> int {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static auto IoUringEnter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags) -> int {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+auto UringAsyncIo::Create(DiskManager *disk_manager, int db_fd, unsigned queue_depth) -> std::unique_ptr<UringAsyncIo> {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int ring_fd = IoUringSetup(queue_depth, &params);
+  if (ring_fd < 0) {
+    return nullptr;
+  }
+  std::unique_ptr<UringAsyncIo> async_io(new UringAsyncIo(disk_manager, db_fd, ring_fd));
+  if (!async_io->MapRings(params.sq_entries, params.cq_entries, &params)) {
+    return nullptr;
+  }
+  async_io->reaper_ = std::thread(&UringAsyncIo::RunReaper, async_io.get());
+  return async_io;
+}
+
+UringAsyncIo::UringAsyncIo(DiskManager *disk_manager, int db_fd, int ring_fd)
+    : disk_manager_(disk_manager), db_fd_(db_fd), ring_fd_(ring_fd) {}
+
+auto UringAsyncIo::MapRings(unsigned sq_entries, unsigned cq_entries, const void *params) -> bool {
+  const auto *p = static_cast<const io_uring_params *>(params);
+  sq_ring_size_ = p->sq_off.array + sq_entries * sizeof(unsigned);
+  cq_ring_size_ = p->cq_off.cqes + cq_entries * sizeof(io_uring_cqe);
+  sqes_size_ = sq_entries * sizeof(io_uring_sqe);
+
+  sq_ring_ =
+      mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    sq_ring_ = nullptr;
+    return false;
+  }
+  cq_ring_ =
+      mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+  if (cq_ring_ == MAP_FAILED) {
+    cq_ring_ = nullptr;
+    return false;
+  }
+  sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (sqes_ == MAP_FAILED) {
+    sqes_ = nullptr;
+    return false;
+  }
+
+  auto *sq = static_cast<char *>(sq_ring_);
+  sq_head_ = reinterpret_cast<unsigned *>(sq + p->sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned *>(sq + p->sq_off.tail);
+  sq_mask_ = *reinterpret_cast<unsigned *>(sq + p->sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned *>(sq + p->sq_off.array);
+  auto *cq = static_cast<char *>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned *>(cq + p->cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *>(cq + p->cq_off.tail);
+  cq_mask_ = *reinterpret_cast<unsigned *>(cq + p->cq_off.ring_mask);
+  cqes_ = cq + p->cq_off.cqes;
+  // The completion queue is at least as large as the submission queue, so bounding the I/Os in flight by the latter
+  // means completions never overflow.
+  queue_depth_ = sq_entries;
+  return true;
+}
+
+UringAsyncIo::~UringAsyncIo() {
+  if (reaper_.joinable()) {
+    {
+      std::unique_lock<std::mutex> lck(latch_);
+      // Callbacks may submit follow-up I/O, so wait until everything has settled before stopping the reaper with a
+      // request it recognizes by its empty user data.
+      idle_cv_.wait(lck, [&] { return in_flight_ == 0 && backlog_.empty(); });
+      stop_ = true;
+      unsigned tail = *sq_tail_;
+      auto index = tail & sq_mask_;
+      auto *sqe = &static_cast<io_uring_sqe *>(sqes_)[index];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_NOP;
+      sq_array_[index] = index;
+      __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+      ++in_flight_;
+      while (IoUringEnter(ring_fd_, 1, 0, 0) < 0 && errno == EINTR) {
+      }
+    }
+    reaper_.join();
+  }
+  if (sqes_ != nullptr) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ != nullptr) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_ != nullptr) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+  close(ring_fd_);
+}
+
+void UringAsyncIo::Submit(std::vector<PageIoRequest> *requests) {
+  std::lock_guard<std::mutex> lck(latch_);
+  for (auto &request : *requests) {
+    backlog_.push_back(std::move(request));
+  }
+  SubmitBacklog();
+}
+
+void UringAsyncIo::SubmitBacklog() {
+  unsigned tail = *sq_tail_;
+  unsigned to_submit = 0;
+  while (!backlog_.empty() && in_flight_ < queue_depth_) {
+    // The request travels through the kernel as the user data of its entry and is freed by the reaper.
+    auto *request = new PageIoRequest(std::move(backlog_.front()));
+    backlog_.pop_front();
+    auto index = tail & sq_mask_;
+    auto *sqe = &static_cast<io_uring_sqe *>(sqes_)[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = request->is_write_ ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = db_fd_;
+    sqe->addr = reinterpret_cast<uint64_t>(request->data_);
+    sqe->len = PAGE_SIZE;
+    sqe->off = static_cast<uint64_t>(request->page_id_) * PAGE_SIZE;
+    sqe->user_data = reinterpret_cast<uint64_t>(request);
+    sq_array_[index] = index;
+    ++tail;
+    ++to_submit;
+    ++in_flight_;
+  }
+  if (to_submit == 0) {
+    return;
+  }
+  __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+  while (to_submit > 0) {
+    int submitted = IoUringEnter(ring_fd_, to_submit, 0, 0);
+    if (submitted < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+        continue;
+      }
+      LOG_DEBUG("I/O error while submitting to io_uring");
+      return;
+    }
+    to_submit -= submitted;
+  }
+}
+
+void UringAsyncIo::RunReaper() {
+  std::vector<std::pair<PageIoRequest *, int>> completions;
+  bool stopping = false;
+  while (!stopping) {
+    if (IoUringEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+      LOG_DEBUG("I/O error while waiting for io_uring completions");
+    }
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      auto &cqe = static_cast<io_uring_cqe *>(cqes_)[head & cq_mask_];
+      completions.emplace_back(reinterpret_cast<PageIoRequest *>(cqe.user_data), cqe.res);
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    if (completions.empty()) {
+      continue;
+    }
+
+    for (auto &[request, result] : completions) {
+      if (request == nullptr) {
+        stopping = true;
+        continue;
+      }
+      // Short transfers, at the end of the file or after an error such as O_DIRECT refusing an unaligned buffer, are
+      // redone synchronously, which zero-fills reads past the end of the file, bounces unaligned buffers and logs real
+      // errors.
+      if (result != PAGE_SIZE) {
+        if (request->is_write_) {
+          disk_manager_->WritePageData(request->page_id_, request->data_);
+        } else {
+          disk_manager_->ReadPage(request->page_id_, request->data_);
+        }
+      }
+      if (request->callback_) {
+        request->callback_();
+      }
+      delete request;
+    }
+
+    std::lock_guard<std::mutex> lck(latch_);
+    in_flight_ -= completions.size();
+    completions.clear();
+    if (!stop_) {
+      SubmitBacklog();
+    }
+    if (in_flight_ == 0 && backlog_.empty()) {
+      idle_cv_.notify_all();
+    }
+  }
+}
+
+}  // namespace bustub
@@ -10,13 +10,18 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <condition_variable>  // NOLINT
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <mutex>  // NOLINT
 #include <string>
-#include <thread>  // NOLINT
 
 #include "common/exception.h"
 #include "common/logger.h"
@@ -26,39 +31,91 @@ namespace bustub {
 
 static char *buffer_used;
 
+static_assert(PAGE_SIZE % DIRECT_IO_ALIGNMENT == 0, "O_DIRECT transfers whole pages");
+
+/**
+ * An aligned page per thread, through which O_DIRECT transfers pages whose buffers are not aligned
+ */
+static auto BounceBuffer() -> char * {
+  struct AlignedPage {
+    alignas(DIRECT_IO_ALIGNMENT) char data_[PAGE_SIZE];
+  };
+  thread_local auto page = std::make_unique<AlignedPage>();
+  return page->data_;
+}
+
 /**
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
  */
-DiskManager::DiskManager(const std::string &db_file) : file_name_(db_file) {
+DiskManager::DiskManager(const std::string &db_file, AsyncIoBackend backend, bool direct_io)
+    : file_name_(db_file), backend_(backend) {
   std::string::size_type n = file_name_.rfind('.');
   if (n == std::string::npos) {
     LOG_DEBUG("wrong file format");
     return;
   }
   log_name_ = file_name_.substr(0, n) + ".log";
+  fsm_name_ = file_name_.substr(0, n) + ".fsm";
 
-  log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-  // directory or file does not exist
-  if (!log_io_.is_open()) {
-    log_io_.clear();
-    // create a new file
-    log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::out | std::ios::in);
-    if (!log_io_.is_open()) {
-      throw Exception("can't open dblog file");
-    }
+  // The log is only ever appended to, and everything already in it is durable.
+  log_fd_ = open(log_name_.c_str(), O_RDWR | O_APPEND | O_CREAT, 0644);
+  if (log_fd_ < 0) {
+    throw Exception("can't open dblog file");
   }
+  log_written_ = std::max(GetFileSize(log_name_), 0);
+  log_synced_ = log_written_;
 
-  std::scoped_lock scoped_db_io_latch(db_io_latch_);
-  db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
+  int direct_flag = direct_io ? O_DIRECT : 0;
+  auto open_db_file = [&](int flags) {
+    int fd = open(db_file.c_str(), flags | direct_flag, 0644);
+    // File systems without O_DIRECT, like tmpfs, refuse it with EINVAL.
+    if (fd < 0 && errno == EINVAL && direct_flag != 0) {
+      LOG_WARN("O_DIRECT is not supported for %s, falling back to buffered I/O", db_file.c_str());
+      direct_flag = 0;
+      fd = open(db_file.c_str(), flags, 0644);
+    }
+    return fd;
+  };
+  bool new_db_file = false;
+  db_fd_ = open_db_file(O_RDWR);
   // directory or file does not exist
-  if (!db_io_.is_open()) {
-    db_io_.clear();
+  if (db_fd_ < 0) {
     // create a new file
-    db_io_.open(db_file, std::ios::binary | std::ios::trunc | std::ios::out | std::ios::in);
-    if (!db_io_.is_open()) {
+    db_fd_ = open_db_file(O_RDWR | O_CREAT | O_TRUNC);
+    if (db_fd_ < 0) {
       throw Exception("can't open db file");
     }
+    new_db_file = true;
+  }
+  direct_io_ = direct_flag != 0;
+
+  // A free-space map left behind by a database file that no longer exists describes nothing.
+  fsm_fd_ = open(fsm_name_.c_str(), O_RDWR | O_CREAT | (new_db_file ? O_TRUNC : 0), 0644);
+  if (fsm_fd_ < 0) {
+    throw Exception("can't open free-space map file");
+  }
+  int fsm_size = GetFileSize(fsm_name_);
+  fsm_bitmap_.resize(std::max(fsm_size, 0));
+  if (pread(fsm_fd_, fsm_bitmap_.data(), fsm_bitmap_.size(), 0) != static_cast<ssize_t>(fsm_bitmap_.size())) {
+    LOG_DEBUG("I/O error while reading free-space map");
+  }
+  for (size_t i = 0; i < fsm_bitmap_.size() * 8; ++i) {
+    if (IsFreePage(static_cast<page_id_t>(i))) {
+      free_pages_[0].insert(static_cast<page_id_t>(i));
+      ++num_free_pages_;
+    }
+  }
+
+  if (backend_ == AsyncIoBackend::IO_URING) {
+    async_io_ = UringAsyncIo::Create(this, db_fd_, ASYNC_IO_QUEUE_DEPTH);
+    if (async_io_ == nullptr) {
+      LOG_WARN("io_uring is not available, falling back to a thread pool for asynchronous I/O");
+      backend_ = AsyncIoBackend::THREAD_POOL;
+    }
+  }
+  if (async_io_ == nullptr) {
+    async_io_ = std::make_unique<ThreadPoolAsyncIo>(this, ASYNC_IO_THREADS);
   }
   buffer_used = nullptr;
 }
@@ -67,58 +124,376 @@ DiskManager::DiskManager(const std::string &db_file) : file_name_(db_file) {
  * Close all file streams
  */
 void DiskManager::ShutDown() {
+  std::unique_ptr<AsyncIo> async_io;
   {
-    std::scoped_lock scoped_db_io_latch(db_io_latch_);
-    db_io_.close();
+    std::unique_lock async_io_latch(async_io_latch_);
+    async_io = std::move(async_io_);
+  }
+  // Completing the outstanding I/O runs callbacks that may submit more, which then happens synchronously; so the
+  // backend is drained without holding the latch, and the db file is only closed afterwards.
+  async_io.reset();
+  {
+    std::unique_lock db_io_latch(db_io_latch_);
+    if (db_fd_ >= 0) {
+      close(db_fd_);
+      db_fd_ = -1;
+    }
+  }
+  {
+    std::scoped_lock scoped_fsm_latch(fsm_latch_);
+    if (fsm_fd_ >= 0) {
+      WriteFreeSpaceMap();
+      close(fsm_fd_);
+      fsm_fd_ = -1;
+    }
+  }
+  {
+    std::scoped_lock scoped_log_latch(log_latch_);
+    if (log_fd_ >= 0) {
+      close(log_fd_);
+      log_fd_ = -1;
+    }
   }
-  log_io_.close();
 }
 
 /**
  * Write the contents of the specified page into disk file
  */
 void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
-  std::scoped_lock scoped_db_io_latch(db_io_latch_);
-  size_t offset = static_cast<size_t>(page_id) * PAGE_SIZE;
-  // set write cursor to offset
+  // Writes only exclude Compact, which must not truncate a page that is being written past its view of the file end.
+  std::shared_lock db_io_latch(db_io_latch_);
   num_writes_ += 1;
-  db_io_.seekp(offset);
-  db_io_.write(page_data, PAGE_SIZE);
-  // check for I/O error
-  if (db_io_.bad()) {
-    LOG_DEBUG("I/O error while writing");
-    return;
+  WritePageData(page_id, page_data);
+  if (page_sync_policy_ == PageSyncPolicy::ON_WRITE) {
+    SyncDbFile();
+  }
+}
+
+void DiskManager::WritePageData(page_id_t page_id, const char *page_data) {
+  if (!IsAligned(page_data)) {
+    char *bounce_buffer = BounceBuffer();
+    memcpy(bounce_buffer, page_data, PAGE_SIZE);
+    page_data = bounce_buffer;
+  }
+  auto offset = static_cast<off_t>(page_id) * PAGE_SIZE;
+  // pwrite goes straight to the kernel, so there is no stream buffer to flush to keep the disk file in sync.
+  size_t written = 0;
+  while (written < PAGE_SIZE) {
+    ssize_t rc = pwrite(db_fd_, page_data + written, PAGE_SIZE - written, offset + written);
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    // check for I/O error
+    if (rc <= 0) {
+      LOG_DEBUG("I/O error while writing");
+      return;
+    }
+    written += rc;
   }
-  // needs to flush to keep disk file in sync
-  db_io_.flush();
 }
 
 /**
  * Read the contents of the specified page into the given memory area
  */
 void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
-  std::scoped_lock scoped_db_io_latch(db_io_latch_);
-  int offset = page_id * PAGE_SIZE;
-  // check if read beyond file length
-  if (offset > GetFileSize(file_name_)) {
-    LOG_DEBUG("I/O error reading past end of file");
-    // std::cerr << "I/O error while reading" << std::endl;
-  } else {
-    // set read cursor to offset
-    db_io_.seekp(offset);
-    db_io_.read(page_data, PAGE_SIZE);
-    if (db_io_.bad()) {
+  char *buffer = IsAligned(page_data) ? page_data : BounceBuffer();
+  auto offset = static_cast<off_t>(page_id) * PAGE_SIZE;
+  size_t read_count = 0;
+  while (read_count < PAGE_SIZE) {
+    ssize_t rc = pread(db_fd_, buffer + read_count, PAGE_SIZE - read_count, offset + read_count);
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc < 0) {
       LOG_DEBUG("I/O error while reading");
       return;
     }
-    // if file ends before reading PAGE_SIZE
-    int read_count = db_io_.gcount();
-    if (read_count < PAGE_SIZE) {
+    // the file ends before the page does
+    if (rc == 0) {
       LOG_DEBUG("Read less than a page");
-      db_io_.clear();
-      // std::cerr << "Read less than a page" << std::endl;
-      memset(page_data + read_count, 0, PAGE_SIZE - read_count);
+      break;
+    }
+    read_count += rc;
+  }
+  // Pages past the end of the file have never been written, so they read as zeroes.
+  memset(buffer + read_count, 0, PAGE_SIZE - read_count);
+  if (buffer != page_data) {
+    memcpy(page_data, buffer, PAGE_SIZE);
+  }
+}
+
+auto DiskManager::IsAligned(const char *page_data) const -> bool {
+  return !direct_io_ || reinterpret_cast<uintptr_t>(page_data) % DIRECT_IO_ALIGNMENT == 0;
+}
+
+/**
+ * Hand a batch of page reads and writes to the asynchronous I/O backend
+ */
+void DiskManager::SubmitPageIo(std::vector<PageIoRequest> *requests) {
+  // Only writes exclude Compact. Reads never wait for it, so that callbacks can submit them while Compact waits for the
+  // writes those same I/O threads have yet to complete.
+  bool has_writes =
+      std::any_of(requests->begin(), requests->end(), [](const auto &request) { return request.is_write_; });
+  std::shared_lock db_io_latch(db_io_latch_, std::defer_lock);
+  if (has_writes) {
+    db_io_latch.lock();
+  }
+  std::shared_lock async_io_latch(async_io_latch_);
+  if (async_io_ == nullptr) {
+    async_io_latch.unlock();
+    if (has_writes) {
+      db_io_latch.unlock();
+    }
+    for (auto &request : *requests) {
+      if (request.is_write_) {
+        WritePage(request.page_id_, request.data_);
+      } else {
+        ReadPage(request.page_id_, request.data_);
+      }
+      if (request.callback_) {
+        request.callback_();
+      }
     }
+    return;
+  }
+  for (auto &request : *requests) {
+    if (request.is_write_) {
+      num_writes_ += 1;
+      uint64_t write_seq;
+      {
+        std::lock_guard<std::mutex> lck(pending_writes_latch_);
+        write_seq = next_write_seq_++;
+        pending_writes_.insert(write_seq);
+      }
+      request.callback_ = [this, write_seq, callback = std::move(request.callback_)] {
+        if (page_sync_policy_ == PageSyncPolicy::ON_WRITE) {
+          SyncDbFile();
+        }
+        {
+          std::lock_guard<std::mutex> lck(pending_writes_latch_);
+          pending_writes_.erase(write_seq);
+        }
+        pending_writes_cv_.notify_all();
+        if (callback) {
+          callback();
+        }
+      };
+    }
+  }
+  async_io_->Submit(requests);
+}
+
+/**
+ * Read the contents of a batch of pages, submitted in ascending page order so that the reads sweep the file once
+ */
+void DiskManager::ReadPages(const std::vector<page_id_t> &page_ids, const std::vector<char *> &page_data) {
+  std::vector<size_t> order(page_ids.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return page_ids[a] < page_ids[b]; });
+
+  std::mutex done_latch;
+  std::condition_variable done_cv;
+  size_t remaining = order.size();
+  std::vector<PageIoRequest> requests;
+  requests.reserve(order.size());
+  for (auto i : order) {
+    requests.push_back({false, page_ids[i], page_data[i], [&] {
+                          std::lock_guard<std::mutex> lck(done_latch);
+                          if (--remaining == 0) {
+                            done_cv.notify_one();
+                          }
+                        }});
+  }
+  SubmitPageIo(&requests);
+  std::unique_lock<std::mutex> lck(done_latch);
+  done_cv.wait(lck, [&] { return remaining == 0; });
+}
+
+/**
+ * Mark a page as free in the free-space map
+ */
+void DiskManager::DeallocatePage(page_id_t page_id) {
+  std::scoped_lock scoped_fsm_latch(fsm_latch_);
+  if (!IsFreePage(page_id)) {
+    free_pages_[FreePagePartition(page_id)].insert(page_id);
+    ++num_free_pages_;
+    SetFreeBit(page_id, true);
+  }
+}
+
+void DiskManager::PartitionFreePages(size_t num_partitions, size_t extent_size) {
+  std::scoped_lock scoped_fsm_latch(fsm_latch_);
+  if (num_partitions == free_pages_.size() && extent_size == fsm_extent_size_) {
+    return;
+  }
+  std::vector<std::set<page_id_t>> partitions(num_partitions);
+  fsm_extent_size_ = extent_size;
+  free_pages_.swap(partitions);
+  for (const auto &partition : partitions) {
+    for (auto page_id : partition) {
+      free_pages_[FreePagePartition(page_id)].insert(page_id);
+    }
+  }
+}
+
+/**
+ * Take the lowest page of a partition out of the free-space map, so that allocations fill the start of the file first.
+ * A freed page that is lost in a crash only leaks, but one that is still free on disk after it was handed out would be
+ * handed out again, so an allocation is made durable before it returns.
+ */
+auto DiskManager::AllocateFreePage(size_t partition) -> page_id_t {
+  std::scoped_lock scoped_fsm_latch(fsm_latch_);
+  if (partition >= free_pages_.size() || free_pages_[partition].empty()) {
+    return INVALID_PAGE_ID;
+  }
+  auto page_id = *free_pages_[partition].begin();
+  free_pages_[partition].erase(free_pages_[partition].begin());
+  --num_free_pages_;
+  SetFreeBit(page_id, false);
+  WriteFreeSpaceMap();
+  if (fdatasync(fsm_fd_) != 0) {
+    LOG_DEBUG("I/O error while syncing free-space map");
+  }
+  return page_id;
+}
+
+auto DiskManager::GetNumFreePages() -> size_t {
+  std::scoped_lock scoped_fsm_latch(fsm_latch_);
+  return num_free_pages_;
+}
+
+/**
+ * Free pages at the end of the file may have been truncated away by Compact, so the free-space map counts too
+ */
+auto DiskManager::GetPageIdBound() -> page_id_t {
+  std::scoped_lock scoped_fsm_latch(fsm_latch_);
+  struct stat stat_buf;
+  page_id_t bound = 0;
+  if (fstat(db_fd_, &stat_buf) == 0) {
+    bound = static_cast<page_id_t>((stat_buf.st_size + PAGE_SIZE - 1) / PAGE_SIZE);
+  }
+  for (const auto &partition : free_pages_) {
+    if (!partition.empty()) {
+      bound = std::max(bound, *partition.rbegin() + 1);
+    }
+  }
+  return bound;
+}
+
+/**
+ * Truncate the free pages at the end of the db file and punch holes for the other free pages
+ */
+auto DiskManager::Compact() -> size_t {
+  std::scoped_lock scoped_fsm_latch(fsm_latch_);
+  // No write may be in flight while the file is truncated, and no new one can start while db_io_latch_ is held
+  // exclusively. The in-flight writes are waited for without it, so that writers are only kept out for a moment.
+  std::unique_lock db_io_latch(db_io_latch_, std::defer_lock);
+  while (true) {
+    WaitForWrites();
+    db_io_latch.lock();
+    std::lock_guard<std::mutex> lck(pending_writes_latch_);
+    if (pending_writes_.empty()) {
+      break;
+    }
+    db_io_latch.unlock();
+  }
+  struct stat stat_buf;
+  if (fstat(db_fd_, &stat_buf) != 0 || stat_buf.st_size == 0) {
+    return 0;
+  }
+  auto num_pages = static_cast<page_id_t>((stat_buf.st_size + PAGE_SIZE - 1) / PAGE_SIZE);
+  auto last_page = num_pages;
+  while (last_page > 0 && IsFreePage(last_page - 1)) {
+    --last_page;
+  }
+  size_t reclaimed = num_pages - last_page;
+
+  if (reclaimed > 0 && ftruncate(db_fd_, static_cast<off_t>(last_page) * PAGE_SIZE) != 0) {
+    reclaimed = 0;
+    last_page = num_pages;
+  }
+#ifdef FALLOC_FL_PUNCH_HOLE
+  for (const auto &partition : free_pages_) {
+    for (auto page_id : partition) {
+      if (page_id >= last_page) {
+        break;
+      }
+      // File systems without hole punching simply keep the space.
+      auto offset = static_cast<off_t>(page_id) * PAGE_SIZE;
+      if (fallocate(db_fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, PAGE_SIZE) == 0) {
+        ++reclaimed;
+      }
+    }
+  }
+#endif
+  return reclaimed;
+}
+
+void DiskManager::SetFreeBit(page_id_t page_id, bool is_free) {
+  size_t byte = page_id / 8;
+  if (byte >= fsm_bitmap_.size()) {
+    fsm_bitmap_.resize(byte + 1);
+  }
+  if (is_free) {
+    fsm_bitmap_[byte] |= 1 << (page_id % 8);
+  } else {
+    fsm_bitmap_[byte] &= ~(1 << (page_id % 8));
+  }
+  if (fsm_dirty_begin_ == fsm_dirty_end_) {
+    fsm_dirty_begin_ = byte;
+    fsm_dirty_end_ = byte + 1;
+  } else {
+    fsm_dirty_begin_ = std::min(fsm_dirty_begin_, byte);
+    fsm_dirty_end_ = std::max(fsm_dirty_end_, byte + 1);
+  }
+}
+
+auto DiskManager::IsFreePage(page_id_t page_id) const -> bool {
+  size_t byte = page_id / 8;
+  return byte < fsm_bitmap_.size() && (fsm_bitmap_[byte] & (1 << (page_id % 8))) != 0;
+}
+
+void DiskManager::WriteFreeSpaceMap() {
+  if (fsm_dirty_begin_ == fsm_dirty_end_) {
+    return;
+  }
+  auto size = fsm_dirty_end_ - fsm_dirty_begin_;
+  if (pwrite(fsm_fd_, &fsm_bitmap_[fsm_dirty_begin_], size, static_cast<off_t>(fsm_dirty_begin_)) !=
+      static_cast<ssize_t>(size)) {
+    LOG_DEBUG("I/O error while writing free-space map");
+    return;
+  }
+  fsm_dirty_begin_ = fsm_dirty_end_ = 0;
+}
+
+/**
+ * Make the completed page writes and the free-space map durable, typically at a checkpoint
+ */
+void DiskManager::Sync() {
+  WaitForWrites();
+  SyncDbFile();
+  std::scoped_lock scoped_fsm_latch(fsm_latch_);
+  WriteFreeSpaceMap();
+  if (fdatasync(fsm_fd_) != 0) {
+    LOG_DEBUG("I/O error while syncing free-space map");
+  }
+}
+
+/**
+ * Writes complete out of order, so the wait is over once no write older than the call is pending
+ */
+void DiskManager::WaitForWrites() {
+  std::unique_lock<std::mutex> lck(pending_writes_latch_);
+  const uint64_t end_seq = next_write_seq_;
+  pending_writes_cv_.wait(lck, [&] { return pending_writes_.empty() || *pending_writes_.begin() >= end_seq; });
+}
+
+void DiskManager::SyncDbFile() {
+  num_syncs_ += 1;
+  if (fdatasync(db_fd_) != 0) {
+    LOG_DEBUG("I/O error while syncing");
   }
 }
 
@@ -142,20 +517,55 @@ void DiskManager::WriteLog(char *log_data, int size) {
     assert(flush_log_f_->wait_for(std::chrono::seconds(10)) == std::future_status::ready);
   }
 
-  num_flushes_ += 1;
-  // sequence write
-  log_io_.write(log_data, size);
-
-  // check for I/O error
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while writing log");
-    return;
+  size_t log_end;
+  {
+    std::scoped_lock scoped_log_latch(log_latch_);
+    num_flushes_ += 1;
+    // sequence write
+    int written = 0;
+    while (written < size) {
+      ssize_t rc = write(log_fd_, log_data + written, size - written);
+      if (rc < 0 && errno == EINTR) {
+        continue;
+      }
+      // check for I/O error
+      if (rc <= 0) {
+        LOG_DEBUG("I/O error while writing log");
+        return;
+      }
+      written += rc;
+    }
+    log_written_ += size;
+    log_end = log_written_;
   }
-  // needs to flush to keep disk file in sync
-  log_io_.flush();
+  // The write only reached the OS; the log is durable once it is synced.
+  SyncLog(log_end);
   flush_log_ = false;
 }
 
+void DiskManager::SyncLog(size_t log_end) {
+  std::unique_lock<std::mutex> lck(log_latch_);
+  while (log_synced_ < log_end) {
+    if (log_syncing_) {
+      log_sync_cv_.wait(lck);
+      continue;
+    }
+    // Become the leader of a group: one fdatasync covers everything written until now, including the writes of the
+    // callers waiting for the sync in progress.
+    log_syncing_ = true;
+    auto sync_end = log_written_;
+    lck.unlock();
+    num_log_syncs_ += 1;
+    if (fdatasync(log_fd_) != 0) {
+      LOG_DEBUG("I/O error while syncing log");
+    }
+    lck.lock();
+    log_synced_ = std::max(log_synced_, sync_end);
+    log_syncing_ = false;
+    log_sync_cv_.notify_all();
+  }
+}
+
 /**
  * Read the contents of the log into the given memory area
  * Always read from the beginning and perform sequence read
@@ -167,23 +577,34 @@ auto DiskManager::ReadLog(char *log_data, int size, int offset) -> bool {
     // LOG_DEBUG("file size is %d", GetFileSize(log_name_));
     return false;
   }
-  log_io_.seekp(offset);
-  log_io_.read(log_data, size);
-
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while reading log");
-    return false;
+  int read_count = 0;
+  while (read_count < size) {
+    ssize_t rc = pread(log_fd_, log_data + read_count, size - read_count, offset + read_count);
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc < 0) {
+      LOG_DEBUG("I/O error while reading log");
+      return false;
+    }
+    if (rc == 0) {
+      break;
+    }
+    read_count += rc;
   }
   // if log file ends before reading "size"
-  int read_count = log_io_.gcount();
   if (read_count < size) {
-    log_io_.clear();
     memset(log_data + read_count, 0, size - read_count);
   }
 
   return true;
 }
 
+auto DiskManager::GetLogSize() -> int {
+  std::scoped_lock scoped_log_latch(log_latch_);
+  return static_cast<int>(log_written_);
+}
+
 /**
  * Returns number of flushes made so far
  */
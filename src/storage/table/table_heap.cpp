@@ -63,7 +63,9 @@ auto TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) -> b
       cur_page->WLatch();
     } else {
       // Otherwise we have run out of valid pages. We need to create a new page.
-      auto new_page = static_cast<TablePage *>(buffer_pool_manager_->NewPage(&next_page_id));
+      // Keep the table's pages together in partitioned buffer pools.
+      auto new_page =
+          static_cast<TablePage *>(buffer_pool_manager_->NewPageNear(&next_page_id, cur_page->GetTablePageId()));
       // If we could not create a new page,
       if (new_page == nullptr) {
         // Then life sucks and we abort the transaction.
@@ -153,9 +155,9 @@ void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
 
-auto TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) -> bool {
+auto TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, BufferAccessStrategy *strategy) -> bool {
   // Find the page which contains the tuple.
-  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId(), strategy));
   // If the page could not be found, then abort the transaction.
   if (page == nullptr) {
     txn->SetState(TransactionState::ABORTED);
@@ -169,13 +171,13 @@ auto TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) -> bool
   return res;
 }
 
-auto TableHeap::Begin(Transaction *txn) -> TableIterator {
+auto TableHeap::Begin(Transaction *txn, BufferAccessStrategy *strategy) -> TableIterator {
   // Start an iterator from the first page.
   // TODO(Wuwen): Hacky fix for now. Removing empty pages is a better way to handle this.
   RID rid;
   auto page_id = first_page_id_;
   while (page_id != INVALID_PAGE_ID) {
-    auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+    auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id, strategy));
     page->RLatch();
     // If this fails because there is no tuple, then RID will be the default-constructed value, which means EOF.
     auto found_tuple = page->GetFirstTupleRid(&rid);
@@ -186,7 +188,7 @@ auto TableHeap::Begin(Transaction *txn) -> TableIterator {
     }
     page_id = page->GetNextPageId();
   }
-  return {this, rid, txn};
+  return {this, rid, txn, strategy};
 }
 
 auto TableHeap::End() -> TableIterator { return {this, RID(INVALID_PAGE_ID, 0), nullptr}; }
@@ -16,10 +16,10 @@
 
 namespace bustub {
 
-TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn)
-    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn) {
+TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn, BufferAccessStrategy *strategy)
+    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn), strategy_(strategy) {
   if (rid.GetPageId() != INVALID_PAGE_ID) {
-    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
+    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_, strategy_);
   }
 }
 
@@ -35,19 +35,21 @@ auto TableIterator::operator->() -> Tuple * {
 
 auto TableIterator::operator++() -> TableIterator & {
   BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
-  auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
+  auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId(), strategy_));
   cur_page->RLatch();
   assert(cur_page != nullptr);  // all pages are pinned
+  ReadAhead(cur_page);
 
   RID next_tuple_rid;
   if (!cur_page->GetNextTupleRid(tuple_->rid_,
                                  &next_tuple_rid)) {  // end of this page
     while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
-      auto next_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
+      auto next_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(cur_page->GetNextPageId(), strategy_));
       cur_page->RUnlatch();
       buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
       cur_page = next_page;
       cur_page->RLatch();
+      ReadAhead(cur_page);
       if (cur_page->GetFirstTupleRid(&next_tuple_rid)) {
         break;
       }
@@ -56,7 +58,7 @@ auto TableIterator::operator++() -> TableIterator & {
   tuple_->rid_ = next_tuple_rid;
 
   if (*this != table_heap_->End()) {
-    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
+    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_, strategy_);
   }
   // release until copy the tuple
   cur_page->RUnlatch();
@@ -70,4 +72,42 @@ auto TableIterator::operator++(int) -> TableIterator {
   return clone;
 }
 
+void TableIterator::ReadAhead(TablePage *page) {
+  if (strategy_ == nullptr) {
+    return;
+  }
+  BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
+  if (!read_ahead_.empty() && read_ahead_.front() == page->GetTablePageId()) {
+    read_ahead_.pop_front();
+  }
+  while (read_ahead_.size() < strategy_->GetReadAheadWindow()) {
+    page_id_t next_page_id = page->GetNextPageId();
+    if (!read_ahead_.empty()) {
+      auto last_page_id = read_ahead_.back();
+      if (!buffer_pool_manager->PrefetchPage(last_page_id, strategy_)) {
+        return;
+      }
+      // Read-ahead never waits, so neither for the latch of a page somebody is changing.
+      auto *last_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(last_page_id, strategy_));
+      if (last_page == nullptr) {
+        return;
+      }
+      bool latched = last_page->TryRLatch();
+      if (latched) {
+        next_page_id = last_page->GetNextPageId();
+        last_page->RUnlatch();
+      }
+      buffer_pool_manager->UnpinPage(last_page_id, false);
+      if (!latched) {
+        return;
+      }
+    }
+    if (next_page_id == INVALID_PAGE_ID) {
+      return;
+    }
+    buffer_pool_manager->PrefetchPage(next_page_id, strategy_);
+    read_ahead_.push_back(next_page_id);
+  }
+}
+
 }  // namespace bustub
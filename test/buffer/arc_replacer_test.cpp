@@ -0,0 +1,134 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// arc_replacer_test.cpp
+//
+// Identification: test/buffer/arc_replacer_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdio>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "buffer/arc_replacer.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+TEST(ARCReplacerTest, SampleTest) {
+  ARCReplacer arc_replacer(7, 0);
+
+  // Scenario: load pages 10-15 into frames 1-6, hit frames 1 and 2 again, then unpin them all.
+  for (frame_id_t frame_id = 1; frame_id <= 6; ++frame_id) {
+    arc_replacer.RecordMiss(frame_id, frame_id + 9);
+  }
+  arc_replacer.RecordAccess(2);
+  arc_replacer.RecordAccess(1);
+  for (frame_id_t frame_id = 1; frame_id <= 6; ++frame_id) {
+    arc_replacer.Unpin(frame_id);
+  }
+  EXPECT_EQ(6, arc_replacer.Size());
+
+  // Scenario: pages referenced once are evicted first, least recently used first.
+  int value;
+  arc_replacer.Victim(&value);
+  EXPECT_EQ(3, value);
+  arc_replacer.RecordEviction(3, 12);
+  arc_replacer.Victim(&value);
+  EXPECT_EQ(4, value);
+  arc_replacer.RecordEviction(4, 13);
+
+  // Scenario: pin elements in the replacer.
+  // Note that 3 has already been victimized, so pinning 3 should have no effect.
+  arc_replacer.Pin(3);
+  arc_replacer.Pin(5);
+  EXPECT_EQ(3, arc_replacer.Size());
+
+  // Scenario: once T1 has no evictable frame left, T2 is used.
+  arc_replacer.Victim(&value);
+  EXPECT_EQ(6, value);
+  arc_replacer.Victim(&value);
+  EXPECT_EQ(2, value);
+  arc_replacer.Victim(&value);
+  EXPECT_EQ(1, value);
+  EXPECT_FALSE(arc_replacer.Victim(&value));
+}
+
+TEST(ARCReplacerTest, GhostHitTest) {
+  ARCReplacer arc_replacer(2, 0);
+
+  // Scenario: page 10 is loaded into frame 0 and evicted, which leaves it in the ghost list B1.
+  int value;
+  arc_replacer.RecordMiss(0, 10);
+  arc_replacer.Unpin(0);
+  ASSERT_TRUE(arc_replacer.Victim(&value));
+  EXPECT_EQ(0, value);
+  arc_replacer.RecordEviction(0, 10);
+
+  // Scenario: page 10 comes back while page 11 is loaded for the first time. The ghost hit grows the target size of
+  // T1, so the page referenced once is now kept and page 10, which went to T2, is the victim.
+  arc_replacer.RecordMiss(0, 10);
+  arc_replacer.RecordMiss(1, 11);
+  arc_replacer.Unpin(0);
+  arc_replacer.Unpin(1);
+  ASSERT_TRUE(arc_replacer.Victim(&value));
+  EXPECT_EQ(0, value);
+  arc_replacer.RecordEviction(0, 10);
+
+  // Scenario: page 10 comes back again from B2, which shrinks T1 and makes page 11 the victim.
+  arc_replacer.RecordMiss(0, 10);
+  arc_replacer.Unpin(0);
+  ASSERT_TRUE(arc_replacer.Victim(&value));
+  EXPECT_EQ(1, value);
+}
+
+TEST(ARCReplacerTest, AbandonedVictimTest) {
+  ARCReplacer arc_replacer(2, 0);
+
+  // Scenario: the buffer pool gives up on a victim that got pinned, and unpins it later; it is still resident.
+  int value;
+  arc_replacer.RecordMiss(0, 10);
+  arc_replacer.RecordAccess(0);
+  arc_replacer.Unpin(0);
+  ASSERT_TRUE(arc_replacer.Victim(&value));
+  EXPECT_EQ(0, value);
+  EXPECT_EQ(0, arc_replacer.Size());
+  arc_replacer.Unpin(0);
+  EXPECT_EQ(1, arc_replacer.Size());
+
+  // Scenario: a deleted page leaves the replacer without a ghost.
+  arc_replacer.Remove(0);
+  EXPECT_EQ(0, arc_replacer.Size());
+  EXPECT_FALSE(arc_replacer.Victim(&value));
+}
+
+TEST(ARCReplacerTest, CorrelatedReferenceTest) {
+  ARCReplacer arc_replacer(3, 3);
+
+  // Scenario: page 10 is hit right after its load, like a page a scan reads several tuples from.
+  arc_replacer.RecordMiss(0, 10);
+  arc_replacer.RecordAccess(0);
+  // Scenario: page 11 is hit again after other pages were loaded, further from its load than the period.
+  arc_replacer.RecordMiss(1, 11);
+  arc_replacer.RecordMiss(2, 12);
+  arc_replacer.RecordAccess(2);
+  arc_replacer.RecordAccess(1);
+  for (frame_id_t frame_id = 0; frame_id < 3; ++frame_id) {
+    arc_replacer.Unpin(frame_id);
+  }
+
+  // Pages 10 and 12 stay in T1 and go first, page 10 first since it was loaded first; page 11 was promoted to T2.
+  int value;
+  arc_replacer.Victim(&value);
+  EXPECT_EQ(0, value);
+  arc_replacer.Victim(&value);
+  EXPECT_EQ(2, value);
+  arc_replacer.Victim(&value);
+  EXPECT_EQ(1, value);
+}
+
+}  // namespace bustub
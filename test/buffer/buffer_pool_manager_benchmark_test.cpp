@@ -0,0 +1,180 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_manager_benchmark_test.cpp
+//
+// Identification: test/buffer/buffer_pool_manager_benchmark_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "buffer/buffer_pool_manager_instance.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+// The benchmarks only print their measurements and are too slow for the test suite; run them with
+// --gtest_also_run_disabled_tests.
+
+// NOLINTNEXTLINE
+// NewPage throughput should not depend on the pool size: filling a pool of N frames must take O(N), not O(N^2).
+TEST(BufferPoolManagerBenchmarkTest, DISABLED_NewPageThroughputTest) {
+  const std::string db_name = "test.db";
+  const std::vector<size_t> pool_sizes{1024, 4096, 16384};
+
+  auto *disk_manager = new DiskManager(db_name);
+  for (auto pool_size : pool_sizes) {
+    auto *bpm = new BufferPoolManagerInstance(pool_size, disk_manager);
+
+    // Scenario: bulk load, every new page stays pinned until the pool is full.
+    page_id_t page_id;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < pool_size; ++i) {
+      ASSERT_NE(nullptr, bpm->NewPage(&page_id));
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(nullptr, bpm->NewPage(&page_id));
+
+    std::cout << "pool_size=" << pool_size << " new_pages_per_sec=" << static_cast<int64_t>(pool_size / elapsed)
+              << std::endl;
+    delete bpm;
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Hits only take an atomic pin, so hit throughput of a single instance should grow with the number of threads.
+TEST(BufferPoolManagerBenchmarkTest, DISABLED_FetchHitThroughputTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 64;
+  const int fetches_per_thread = 100000;
+  const std::vector<int> thread_counts{1, 2, 4, 8};
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  std::vector<page_id_t> page_ids;
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    page_id_t page_id;
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id));
+    bpm->UnpinPage(page_id, false);
+    page_ids.push_back(page_id);
+  }
+
+  for (auto num_threads : thread_counts) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&, t] {
+        for (int i = 0; i < fetches_per_thread; ++i) {
+          auto page_id = page_ids[(i + t) % page_ids.size()];
+          auto *page = bpm->FetchPage(page_id);
+          ASSERT_NE(nullptr, page);
+          bpm->UnpinPage(page_id, false);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "threads=" << num_threads
+              << " hits_per_sec=" << static_cast<int64_t>(num_threads * fetches_per_thread / elapsed) << std::endl;
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// With O_DIRECT, pages scanned through the pool are no longer also cached by the kernel, so the memory they take is
+// counted once; misses pay the disk latency instead of a page cache copy.
+TEST(BufferPoolManagerBenchmarkTest, DISABLED_DirectIoTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 256;
+  const page_id_t num_pages = 4096;
+  const int num_scans = 3;
+
+  for (bool direct_io : {false, true}) {
+    remove(db_name.c_str());
+    remove("test.log");
+    remove("test.fsm");
+    auto *disk_manager = new DiskManager(db_name, AsyncIoBackend::IO_URING, direct_io);
+    auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+    for (page_id_t i = 0; i < num_pages; ++i) {
+      page_id_t page_id;
+      auto *page = bpm->NewPage(&page_id);
+      ASSERT_NE(nullptr, page);
+      std::snprintf(page->GetData(), PAGE_SIZE, "page %d", page_id);
+      bpm->UnpinPage(page_id, true);
+    }
+    bpm->FlushAllPages();
+
+    // Start both modes from a cold page cache.
+    int fd = open(db_name.c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+    fsync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int scan = 0; scan < num_scans; ++scan) {
+      for (page_id_t page_id = 0; page_id < num_pages; ++page_id) {
+        auto *page = bpm->FetchPage(page_id);
+        ASSERT_NE(nullptr, page);
+        ASSERT_EQ("page " + std::to_string(page_id), std::string(page->GetData()));
+        bpm->UnpinPage(page_id, false);
+      }
+    }
+    auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    // Count the pages of the file the kernel still caches.
+    size_t cached_pages = 0;
+    auto length = static_cast<size_t>(num_pages) * PAGE_SIZE;
+    void *file = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    ASSERT_NE(MAP_FAILED, file);
+    auto system_page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    std::vector<unsigned char> residency((length + system_page_size - 1) / system_page_size);
+    if (mincore(file, length, residency.data()) == 0) {
+      for (auto resident : residency) {
+        cached_pages += resident & 1;
+      }
+      cached_pages = cached_pages * system_page_size / PAGE_SIZE;
+    }
+    munmap(file, length);
+    close(fd);
+
+    std::cout << "direct_io=" << disk_manager->IsDirectIo() << " fetch_us=" << elapsed / (num_scans * num_pages)
+              << " pool_pages=" << buffer_pool_size << " page_cache_pages=" << cached_pages
+              << " cached_pages=" << buffer_pool_size + cached_pages << std::endl;
+
+    delete bpm;
+    disk_manager->ShutDown();
+    delete disk_manager;
+  }
+  remove(db_name.c_str());
+  remove("test.log");
+  remove("test.fsm");
+}
+
+}  // namespace bustub
@@ -11,9 +11,18 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/buffer_pool_manager_instance.h"
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <cstring>
+#include <future>  // NOLINT
 #include <random>
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 #include "buffer/buffer_pool_manager.h"
 #include "gtest/gtest.h"
 
@@ -80,6 +89,8 @@ TEST(BufferPoolManagerInstanceTest, BinaryDataTest) {
   // Shutdown the disk manager and remove the temporary file we created.
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
 
   delete bpm;
   delete disk_manager;
@@ -136,9 +147,790 @@ TEST(BufferPoolManagerInstanceTest, SampleTest) {
   // Shutdown the disk manager and remove the temporary file we created.
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
 
   delete bpm;
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+// Check that pools using the other replacement policies evict unpinned pages and read them back intact
+TEST(BufferPoolManagerInstanceTest, ReplacerPolicyTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 5;
+  const size_t num_pages = buffer_pool_size * 3;
+
+  for (auto replacer_type : {ReplacerType::CLOCK, ReplacerType::LRU_K, ReplacerType::ARC}) {
+    auto *disk_manager = new DiskManager(db_name);
+    auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, nullptr, replacer_type);
+
+    // Scenario: Create three times as many pages as there are frames, unpinning each one dirty.
+    page_id_t page_id_temp;
+    for (size_t i = 0; i < num_pages; ++i) {
+      auto *page = bpm->NewPage(&page_id_temp);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ(static_cast<page_id_t>(i), page_id_temp);
+      snprintf(page->GetData(), PAGE_SIZE, "page %zu", i);
+      EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+    }
+
+    // Scenario: Every page can be fetched again with the content it was evicted with.
+    for (size_t i = 0; i < num_pages; ++i) {
+      auto *page = bpm->FetchPage(static_cast<page_id_t>(i));
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ("page " + std::to_string(i), std::string(page->GetData()));
+      EXPECT_EQ(true, bpm->UnpinPage(static_cast<page_id_t>(i), false));
+    }
+
+    // Scenario: Once every frame is pinned the replacer finds no victim.
+    for (size_t i = 0; i < buffer_pool_size; ++i) {
+      EXPECT_NE(nullptr, bpm->FetchPage(static_cast<page_id_t>(i)));
+    }
+    EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp));
+
+    disk_manager->ShutDown();
+    remove("test.db");
+    remove("test.log");
+    remove("test.fsm");
+
+    delete bpm;
+    delete disk_manager;
+  }
+}
+
+// NOLINTNEXTLINE
+// Check that a scan through an access strategy recycles its own frames and leaves the other pages resident
+TEST(BufferPoolManagerInstanceTest, AccessStrategyTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+  const page_id_t num_pages = 40;
+  const page_id_t num_hot_pages = 5;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  page_id_t page_id_temp;
+  for (page_id_t i = 0; i < num_pages; ++i) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+  bpm->FlushAllPages();
+
+  // Scenario: Fill the pool with clean pages, the hot pages last, so that the replacer evicts the others first.
+  for (page_id_t i = num_pages - static_cast<page_id_t>(buffer_pool_size - num_hot_pages); i < num_pages; ++i) {
+    ASSERT_NE(nullptr, bpm->FetchPage(i));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Scenario: The hot pages are changed in memory only, so the change is lost if they get evicted.
+  for (page_id_t i = 0; i < num_hot_pages; ++i) {
+    auto *page = bpm->FetchPage(i);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "hot");
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Scenario: Scan all the other pages, which are four times as many as there are frames, through a strategy.
+  BufferAccessStrategy strategy;
+  for (page_id_t i = num_hot_pages; i < num_pages; ++i) {
+    ASSERT_NE(nullptr, bpm->FetchPage(i, &strategy));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Scenario: The hot pages were never evicted.
+  for (page_id_t i = 0; i < num_hot_pages; ++i) {
+    auto *page = bpm->FetchPage(i);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(0, strcmp(page->GetData(), "hot"));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that pages are read ahead of a bulk reader into frames of its ring
+TEST(BufferPoolManagerInstanceTest, ReadAheadTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+  const page_id_t num_pages = 30;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  page_id_t page_id_temp;
+  for (page_id_t i = 0; i < num_pages; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", i);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Make the last pages created the only resident ones.
+  bpm->FlushAllPages();
+  for (page_id_t i = num_pages - static_cast<page_id_t>(buffer_pool_size); i < num_pages; ++i) {
+    ASSERT_NE(nullptr, bpm->FetchPage(i));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  auto is_resident = [&](page_id_t page_id) {
+    for (size_t i = 0; i < buffer_pool_size; ++i) {
+      if (bpm->GetPages()[i].GetPageId() == page_id) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // Scenario: A page is read ahead into a frame right away, and reads intact once it is fetched.
+  BufferAccessStrategy strategy(4, 2);
+  ASSERT_FALSE(is_resident(3));
+  EXPECT_FALSE(bpm->PrefetchPage(3, &strategy));
+  EXPECT_TRUE(is_resident(3));
+  auto *page = bpm->FetchPage(3, &strategy);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ("page 3", std::string(page->GetData()));
+  EXPECT_EQ(true, bpm->UnpinPage(3, false));
+  EXPECT_TRUE(bpm->PrefetchPage(3, &strategy));
+
+  // Scenario: Pages are read ahead in any order, such as the order of a table's chain of pages.
+  for (page_id_t page_id : {12, 7, 1}) {
+    EXPECT_FALSE(bpm->PrefetchPage(page_id, &strategy));
+    EXPECT_TRUE(is_resident(page_id));
+  }
+  for (page_id_t page_id : {12, 7, 1}) {
+    page = bpm->FetchPage(page_id, &strategy);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ("page " + std::to_string(page_id), std::string(page->GetData()));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+  }
+
+  // Scenario: Pages that were never allocated are not read.
+  EXPECT_FALSE(bpm->PrefetchPage(num_pages, &strategy));
+  EXPECT_FALSE(is_resident(num_pages));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that the frames are page aligned in one arena, apart from the cache-line aligned page book-keeping
+TEST(BufferPoolManagerInstanceTest, FrameArenaTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 16;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  Page *pages = bpm->GetPages();
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(&pages[i]) % CACHE_LINE_SIZE);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(pages[i].GetData()) % PAGE_SIZE);
+    EXPECT_EQ(pages[0].GetData() + i * PAGE_SIZE, pages[i].GetData());
+  }
+
+  // Scenario: New pages come out of the arena zeroed, even when their frame held another page before.
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < 2 * buffer_pool_size; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(std::string(PAGE_SIZE, '\0'), std::string(page->GetData(), PAGE_SIZE));
+    memset(page->GetData(), 'x', PAGE_SIZE);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that the book-keeping of the pages is bound to the NUMA node of the frames, and that any node number is safe
+TEST(BufferPoolManagerInstanceTest, NumaPlacementTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 16;
+  constexpr size_t mask_bits = sizeof(unsigned long) * 8;  // NOLINT
+
+  auto *disk_manager = new DiskManager(db_name);
+  // Scenario: nodes past the bits of one mask word are rejected by the system, not shifted out of range.
+  for (int numa_node : {0, 64, 1000}) {
+    auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, 1, 0, disk_manager, nullptr, ReplacerType::LRU, 1,
+                                              numa_node);
+    page_id_t page_id_temp;
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+
+    // Scenario: where the system lets memory be bound at all, the pages are bound to node 0 like their frames.
+    unsigned long probe_mask = 1;  // NOLINT
+    void *probe = mmap(nullptr, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(MAP_FAILED, probe);
+    bool can_bind = syscall(SYS_mbind, probe, PAGE_SIZE, MPOL_BIND, &probe_mask, mask_bits, 0) == 0;
+    munmap(probe, PAGE_SIZE);
+    if (numa_node == 0 && can_bind) {
+      for (void *address : {static_cast<void *>(bpm->GetPages()), static_cast<void *>(bpm->GetPages()->GetData())}) {
+        int mode = -1;
+        unsigned long node_mask = 0;  // NOLINT
+        ASSERT_EQ(0, syscall(SYS_get_mempolicy, &mode, &node_mask, mask_bits, address, MPOL_F_ADDR));
+        EXPECT_EQ(MPOL_BIND, mode);
+        EXPECT_EQ(1, node_mask);
+      }
+    }
+    delete bpm;
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that the buffer pool grows and shrinks while it holds pages, keeping the contents of evicted pages
+TEST(BufferPoolManagerInstanceTest, ResizeTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 4;
+  const size_t max_pool_size = 8;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, nullptr, ReplacerType::LRU, max_pool_size);
+
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", page_id_temp);
+  }
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp));
+
+  // Scenario: The pool cannot grow beyond its maximum size, but up to it the new frames are free right away.
+  EXPECT_EQ(false, bpm->Resize(max_pool_size + 1));
+  EXPECT_EQ(false, bpm->Resize(0));
+  EXPECT_EQ(true, bpm->Resize(max_pool_size));
+  EXPECT_EQ(max_pool_size, bpm->GetPoolSize());
+  for (size_t i = buffer_pool_size; i < max_pool_size; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", page_id_temp);
+  }
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp));
+
+  // Scenario: Shrinking stops at the first frame that is pinned, here the one holding page 5.
+  for (page_id_t page_id = 0; page_id < static_cast<page_id_t>(max_pool_size); ++page_id) {
+    if (page_id != 5) {
+      EXPECT_EQ(true, bpm->UnpinPage(page_id, true));
+    }
+  }
+  EXPECT_EQ(false, bpm->Resize(2));
+  EXPECT_EQ(6, bpm->GetPoolSize());
+
+  // Scenario: Once it is unpinned, the pool shrinks all the way and the dirty pages it evicted are read back intact.
+  EXPECT_EQ(true, bpm->UnpinPage(5, true));
+  EXPECT_EQ(true, bpm->Resize(2));
+  EXPECT_EQ(2, bpm->GetPoolSize());
+  for (page_id_t page_id = 0; page_id < static_cast<page_id_t>(max_pool_size); ++page_id) {
+    auto *page = bpm->FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ("page " + std::to_string(page_id), std::string(page->GetData()));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+  }
+  EXPECT_NE(nullptr, bpm->FetchPage(0));
+  EXPECT_NE(nullptr, bpm->FetchPage(1));
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(true, bpm->UnpinPage(0, false));
+  EXPECT_EQ(true, bpm->UnpinPage(1, false));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that deleted pages are handed out again instead of growing the file
+TEST(BufferPoolManagerInstanceTest, PageReuseTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 4;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  page_id_t page_id_temp;
+  for (page_id_t i = 0; i < 8; ++i) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(i, page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: Resident and evicted pages alike are freed, and the lowest free page is reused first.
+  EXPECT_EQ(true, bpm->DeletePage(6));
+  EXPECT_EQ(true, bpm->DeletePage(1));
+  EXPECT_EQ(2, disk_manager->GetNumFreePages());
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(1, page_id_temp);
+  EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(6, page_id_temp);
+  EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(8, page_id_temp);
+  EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+
+  // Scenario: Page ids that were never allocated do not enter the free-space map.
+  EXPECT_EQ(true, bpm->DeletePage(100));
+  EXPECT_EQ(0, disk_manager->GetNumFreePages());
+
+  // Scenario: After a restart, new pages come after the pages in the file and the free-space map, and the pages of the
+  // earlier run can be freed again.
+  EXPECT_EQ(true, bpm->DeletePage(8));
+  bpm->FlushAllPages();
+  delete bpm;
+  disk_manager->ShutDown();
+  delete disk_manager;
+  disk_manager = new DiskManager(db_name);
+  bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(8, page_id_temp);
+  EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(9, page_id_temp);
+  EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+  EXPECT_EQ(true, bpm->DeletePage(3));
+  EXPECT_EQ(1, disk_manager->GetNumFreePages());
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  remove("test.log");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that a batch fetch pins every page, reads the misses intact and handles duplicates and a full pool
+TEST(BufferPoolManagerInstanceTest, FetchPagesTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 5;
+  const page_id_t num_pages = 20;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  page_id_t page_id_temp;
+  for (page_id_t i = 0; i < num_pages; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", i);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: A batch mixing resident pages, evicted pages and a duplicate.
+  std::vector<page_id_t> page_ids = {19, 3, 7, 3, 18};
+  auto pages = bpm->FetchPages(page_ids);
+  ASSERT_EQ(page_ids.size(), pages.size());
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    ASSERT_NE(nullptr, pages[i]);
+    EXPECT_EQ(page_ids[i], pages[i]->GetPageId());
+    EXPECT_EQ("page " + std::to_string(page_ids[i]), std::string(pages[i]->GetData()));
+  }
+  EXPECT_EQ(pages[1], pages[3]);
+  EXPECT_EQ(2, pages[1]->GetPinCount());
+
+  // Scenario: Four frames are pinned, so only the first of two more misses gets one.
+  pages = bpm->FetchPages({11, 12});
+  ASSERT_NE(nullptr, pages[0]);
+  EXPECT_EQ("page 11", std::string(pages[0]->GetData()));
+  EXPECT_EQ(nullptr, pages[1]);
+
+  // Scenario: Batches whose misses evict each other's dirty pages are read back intact.
+  for (auto page_id : page_ids) {
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, true));
+  }
+  EXPECT_EQ(true, bpm->UnpinPage(11, true));
+  for (page_id_t i = 0; i + 4 < num_pages; i += 4) {
+    pages = bpm->FetchPages({i, i + 1, i + 2, i + 3, i + 4});
+    for (page_id_t j = 0; j < 5; ++j) {
+      ASSERT_NE(nullptr, pages[j]);
+      EXPECT_EQ("page " + std::to_string(i + j), std::string(pages[j]->GetData()));
+      EXPECT_EQ(true, bpm->UnpinPage(i + j, true));
+    }
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that concurrent batch fetches whose misses evict dirty pages the other batch asks for next do not deadlock
+TEST(BufferPoolManagerInstanceTest, ConcurrentFetchPagesTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 8;
+  const page_id_t num_pages = 16;
+  const int num_threads = 4;
+  const int rounds = 2000;
+  const auto saved_interval = page_cleaner_interval;
+
+  auto *disk_manager = new DiskManager(db_name);
+  // Every victim is dirty, so every miss owes a write-back.
+  page_cleaner_interval = std::chrono::hours(1);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  page_id_t page_id_temp;
+  for (page_id_t i = 0; i < num_pages; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", i);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: batches ask for pages other batches have just evicted, and whose write-backs those still owe, and for
+  // pages they have evicted themselves.
+  auto fetch = [&](int t) {
+    std::mt19937 rng(t);
+    std::uniform_int_distribution<page_id_t> page_dist(0, num_pages - 1);
+    for (int r = 0; r < rounds; ++r) {
+      std::vector<page_id_t> page_ids = {page_dist(rng), page_dist(rng), page_dist(rng)};
+      auto pages = bpm->FetchPages(page_ids);
+      for (size_t i = 0; i < page_ids.size(); ++i) {
+        if (pages[i] == nullptr) {
+          continue;
+        }
+        EXPECT_EQ("page " + std::to_string(page_ids[i]), std::string(pages[i]->GetData()));
+        EXPECT_EQ(true, bpm->UnpinPage(page_ids[i], true));
+      }
+    }
+  };
+  std::vector<std::future<void>> fetchers;
+  for (int t = 0; t < num_threads; ++t) {
+    fetchers.push_back(std::async(std::launch::async, fetch, t));
+  }
+  for (auto &fetcher : fetchers) {
+    EXPECT_EQ(std::future_status::ready, fetcher.wait_for(std::chrono::seconds(30)));
+  }
+
+  page_cleaner_interval = saved_interval;
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, ConcurrentFetchTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 8;
+  const int num_pages = 32;
+  const int num_threads = 4;
+  const int rounds = 500;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  // Scenario: create more pages than fit in the pool, each stamped with its own page id.
+  std::vector<page_id_t> page_ids;
+  for (int i = 0; i < num_pages; ++i) {
+    page_id_t page_id;
+    auto *page = bpm->NewPage(&page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page-%d", page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+    page_ids.push_back(page_id);
+  }
+
+  // Scenario: threads fetching overlapping pages concurrently must always see the right contents, whether the page
+  // was resident, in flight, or still being written back from an evicted frame.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      char expected[PAGE_SIZE];
+      for (int r = 0; r < rounds; ++r) {
+        page_id_t page_id = page_ids[(r * (t + 1) + t) % num_pages];
+        auto *page = bpm->FetchPage(page_id);
+        if (page == nullptr) {
+          continue;
+        }
+        snprintf(expected, PAGE_SIZE, "page-%d", page_id);
+        EXPECT_EQ(0, strcmp(page->GetData(), expected));
+        EXPECT_TRUE(bpm->UnpinPage(page_id, r % 3 == 0));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that unpins only dirty pinned pages, and that concurrent unpins of one page neither lose a pin nor the flag
+TEST(BufferPoolManagerInstanceTest, UnpinTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 4;
+  const int num_threads = 4;
+  const int rounds = 1000;
+  const auto saved_interval = page_cleaner_interval;
+
+  auto *disk_manager = new DiskManager(db_name);
+  // Keep the page cleaner from clearing the dirty flags the test looks at.
+  page_cleaner_interval = std::chrono::hours(1);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  // Scenario: unpinning a page that is not pinned fails and leaves it clean.
+  page_id_t clean_page_id;
+  auto *clean_page = bpm->NewPage(&clean_page_id);
+  ASSERT_NE(nullptr, clean_page);
+  EXPECT_TRUE(bpm->UnpinPage(clean_page_id, false));
+  EXPECT_FALSE(bpm->UnpinPage(clean_page_id, true));
+  EXPECT_FALSE(clean_page->IsDirty());
+  EXPECT_EQ(0, bpm->GetDirtyPageTable().count(clean_page_id));
+
+  // Scenario: threads fetch and unpin the same page concurrently, one of them marking it dirty every time.
+  page_id_t page_id;
+  auto *page = bpm->NewPage(&page_id);
+  ASSERT_NE(nullptr, page);
+  snprintf(page->GetData(), PAGE_SIZE, "shared");
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int r = 0; r < rounds; ++r) {
+        ASSERT_EQ(page, bpm->FetchPage(page_id));
+        EXPECT_TRUE(bpm->UnpinPage(page_id, t == 0));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  // Only the pin from NewPage is left.
+  EXPECT_EQ(1, page->GetPinCount());
+  EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  EXPECT_EQ(0, page->GetPinCount());
+  EXPECT_FALSE(bpm->UnpinPage(page_id, false));
+  EXPECT_TRUE(page->IsDirty());
+  EXPECT_EQ(1, bpm->GetDirtyPageTable().count(page_id));
+
+  // Scenario: the page is written back when it is evicted, so its contents survive.
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    page_id_t page_id_temp;
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_TRUE(bpm->UnpinPage(page_id_temp, false));
+  }
+  page = bpm->FetchPage(page_id);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(0, strcmp(page->GetData(), "shared"));
+  EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+
+  page_cleaner_interval = saved_interval;
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, PageCleanerTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+  const auto saved_interval = page_cleaner_interval;
+
+  auto *disk_manager = new DiskManager(db_name);
+  page_cleaner_interval = std::chrono::hours(1);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  page_id_t page_id;
+  auto *page = bpm->NewPage(&page_id);
+  ASSERT_NE(nullptr, page);
+  snprintf(page->GetData(), PAGE_SIZE, "Hello");
+
+  // Scenario: unpinning a dirty page does not write it back synchronously.
+  EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  EXPECT_EQ(0, disk_manager->GetNumWrites());
+  EXPECT_TRUE(page->IsDirty());
+  delete bpm;
+
+  // Scenario: the page cleaner writes dirty unpinned frames back in the background.
+  page_cleaner_interval = std::chrono::milliseconds(10);
+  bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+  page = bpm->NewPage(&page_id);
+  ASSERT_NE(nullptr, page);
+  snprintf(page->GetData(), PAGE_SIZE, "World");
+  EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  for (int i = 0; i < 200 && page->IsDirty(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_FALSE(page->IsDirty());
+  // The flag is cleared before the write is issued, so the write may land a little later.
+  char buffer[PAGE_SIZE];
+  disk_manager->ReadPage(page_id, buffer);
+  for (int i = 0; i < 200 && strcmp(buffer, "World") != 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    disk_manager->ReadPage(page_id, buffer);
+  }
+  EXPECT_EQ(0, strcmp(buffer, "World"));
+
+  page_cleaner_interval = saved_interval;
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that the page cleaner never waits for a page latch while it holds frames that a miss is waiting for
+TEST(BufferPoolManagerInstanceTest, PageCleanerLatchTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+  const auto saved_interval = page_cleaner_interval;
+
+  auto *disk_manager = new DiskManager(db_name);
+  page_cleaner_interval = std::chrono::milliseconds(1);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  // Scenario: Every frame is dirty and unpinned, and the first page stays write latched, as a page a thread is still
+  // changing while it asks for a new one.
+  page_id_t page_id_temp;
+  Page *latched_page = nullptr;
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    if (i == 0) {
+      latched_page = page;
+      page->WLatch();
+    }
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+  // Give the cleaner a few passes over the pool.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  // Scenario: A new page is created while the latch is held.
+  auto new_page = std::async(std::launch::async, [&] {
+    page_id_t page_id;
+    auto *page = bpm->NewPage(&page_id);
+    if (page != nullptr) {
+      bpm->UnpinPage(page_id, false);
+    }
+    return page != nullptr;
+  });
+  bool finished = new_page.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+  EXPECT_TRUE(finished);
+  latched_page->WUnlatch();
+  EXPECT_TRUE(new_page.get());
+
+  page_cleaner_interval = saved_interval;
+  delete bpm;
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that write-back forces the log up to the LSN of a logged change, and only for pages that have one
+TEST(BufferPoolManagerInstanceTest, WriteAheadLogTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+  const auto saved_interval = page_cleaner_interval;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *log_manager = new LogManager(disk_manager);
+  page_cleaner_interval = std::chrono::hours(1);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, log_manager);
+  // Without a flush thread, the log is only written when something waits for it to be durable.
+  enable_logging = true;
+  for (int i = 0; i < 10; ++i) {
+    LogRecord log_record(0, INVALID_LSN, LogRecordType::BEGIN);
+    log_manager->AppendLogRecord(&log_record);
+  }
+  ASSERT_EQ(INVALID_LSN, log_manager->GetPersistentLSN());
+
+  // Scenario: a page without logged changes is written back without forcing the log, whatever its bytes at the offset
+  // of a table page's LSN hold.
+  page_id_t page_id;
+  auto *page = bpm->NewPage(&page_id);
+  ASSERT_NE(nullptr, page);
+  lsn_t fake_lsn = 3;
+  memcpy(page->GetData() + sizeof(page_id_t), &fake_lsn, sizeof(lsn_t));
+  EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  EXPECT_TRUE(bpm->FlushPage(page_id));
+  EXPECT_EQ(INVALID_LSN, log_manager->GetPersistentLSN());
+
+  // Scenario: a page with a logged change is only written back once the log is durable up to the change.
+  page = bpm->FetchPage(page_id);
+  ASSERT_NE(nullptr, page);
+  page->SetLSN(5);
+  EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  EXPECT_TRUE(bpm->FlushPage(page_id));
+  EXPECT_LE(5, log_manager->GetPersistentLSN());
+
+  // Scenario: the recLSN of a page is the LSN of its first logged change since it was written back, however long the
+  // page was pinned before the change.
+  page = bpm->FetchPage(page_id);
+  ASSERT_NE(nullptr, page);
+  for (int i = 0; i < 5; ++i) {
+    LogRecord log_record(0, INVALID_LSN, LogRecordType::BEGIN);
+    log_manager->AppendLogRecord(&log_record);
+  }
+  page->SetLSN(12);
+  page->SetLSN(14);
+  EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  auto dirty_page_table = bpm->GetDirtyPageTable();
+  ASSERT_EQ(1, dirty_page_table.count(page_id));
+  EXPECT_EQ(12, dirty_page_table[page_id]);
+  EXPECT_TRUE(bpm->FlushPage(page_id));
+  EXPECT_EQ(0, bpm->GetDirtyPageTable().count(page_id));
+
+  enable_logging = false;
+  page_cleaner_interval = saved_interval;
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+  delete disk_manager;
+}
+
 }  // namespace bustub
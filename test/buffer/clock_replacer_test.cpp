@@ -19,7 +19,7 @@
 
 namespace bustub {
 
-TEST(ClockReplacerTest, DISABLED_SampleTest) {
+TEST(ClockReplacerTest, SampleTest) {
   ClockReplacer clock_replacer(7);
 
   // Scenario: unpin six elements, i.e. add them to the replacer.
@@ -59,4 +59,38 @@ TEST(ClockReplacerTest, DISABLED_SampleTest) {
   EXPECT_EQ(4, value);
 }
 
+TEST(ClockReplacerTest, ConcurrentTest) {
+  const size_t num_pages = 8;
+  const int rounds = 100000;
+  ClockReplacer clock_replacer(num_pages);
+
+  // Scenario: threads keep unpinning and pinning frames while victims are taken. Victim must return, with or without a
+  // victim, however the size it sees races with the frames it sweeps over.
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 2; ++t) {
+    threads.emplace_back([&, t] {
+      for (int r = 0; r < rounds; ++r) {
+        auto frame_id = static_cast<frame_id_t>((r + t) % num_pages);
+        clock_replacer.Unpin(frame_id);
+        clock_replacer.Pin(frame_id);
+      }
+    });
+  }
+  int value;
+  for (int r = 0; r < rounds; ++r) {
+    if (clock_replacer.Victim(&value)) {
+      EXPECT_LT(value, static_cast<int>(num_pages));
+    }
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // Scenario: once every frame is pinned, there is no victim.
+  for (size_t i = 0; i < num_pages; ++i) {
+    clock_replacer.Pin(static_cast<frame_id_t>(i));
+  }
+  EXPECT_FALSE(clock_replacer.Victim(&value));
+}
+
 }  // namespace bustub
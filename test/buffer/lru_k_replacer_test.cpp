@@ -0,0 +1,157 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer_test.cpp
+//
+// Identification: test/buffer/lru_k_replacer_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdio>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "buffer/lru_k_replacer.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+TEST(LRUKReplacerTest, SampleTest) {
+  LRUKReplacer lru_k_replacer(7, 2, 0);
+
+  // Scenario: access six frames once and frame 1 a second time, then unpin them all.
+  for (frame_id_t frame_id = 1; frame_id <= 6; ++frame_id) {
+    lru_k_replacer.RecordAccess(frame_id);
+  }
+  lru_k_replacer.RecordAccess(1);
+  for (frame_id_t frame_id = 1; frame_id <= 6; ++frame_id) {
+    lru_k_replacer.Unpin(frame_id);
+  }
+  EXPECT_EQ(6, lru_k_replacer.Size());
+
+  // Scenario: frames with a single reference go first, oldest first; frame 1 has two and goes last.
+  int value;
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(2, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(3, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(4, value);
+
+  // Scenario: pin elements in the replacer.
+  // Note that 3 has already been victimized, so pinning 3 should have no effect.
+  lru_k_replacer.Pin(3);
+  lru_k_replacer.Pin(4);
+  lru_k_replacer.Pin(5);
+  EXPECT_EQ(2, lru_k_replacer.Size());
+
+  // Scenario: a second access to 5 gives it two references, more recent ones than frame 1's.
+  lru_k_replacer.RecordAccess(5);
+  lru_k_replacer.Unpin(5);
+
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(6, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(1, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(5, value);
+  EXPECT_FALSE(lru_k_replacer.Victim(&value));
+}
+
+TEST(LRUKReplacerTest, ScanResistanceTest) {
+  const size_t num_frames = 8;
+  LRUKReplacer lru_k_replacer(num_frames, 2, 0);
+
+  // Scenario: frames 0-3 hold a working set referenced twice.
+  for (int round = 0; round < 2; ++round) {
+    for (frame_id_t frame_id = 0; frame_id < 4; ++frame_id) {
+      lru_k_replacer.RecordAccess(frame_id);
+    }
+  }
+  for (frame_id_t frame_id = 0; frame_id < 4; ++frame_id) {
+    lru_k_replacer.Unpin(frame_id);
+  }
+
+  // Scenario: a scan then passes through frames 4-7 and keeps recycling them; the working set is never evicted.
+  for (frame_id_t frame_id = 4; frame_id < 8; ++frame_id) {
+    lru_k_replacer.RecordAccess(frame_id);
+    lru_k_replacer.Unpin(frame_id);
+  }
+  for (int i = 0; i < 100; ++i) {
+    int value;
+    ASSERT_TRUE(lru_k_replacer.Victim(&value));
+    EXPECT_GE(value, 4);
+    lru_k_replacer.RecordEviction(value, INVALID_PAGE_ID);
+    lru_k_replacer.RecordAccess(value);
+    lru_k_replacer.Unpin(value);
+  }
+  EXPECT_EQ(num_frames, lru_k_replacer.Size());
+}
+
+TEST(LRUKReplacerTest, CorrelatedReferenceTest) {
+  LRUKReplacer lru_k_replacer(4, 2, 3);
+
+  // Scenario: frame 0 is referenced twice back to back, which is one correlated reference.
+  lru_k_replacer.RecordAccess(0);
+  lru_k_replacer.RecordAccess(0);
+  // Scenario: frame 1 is referenced twice, further apart than the correlated reference period.
+  lru_k_replacer.RecordAccess(1);
+  lru_k_replacer.RecordAccess(2);
+  lru_k_replacer.RecordAccess(3);
+  lru_k_replacer.RecordAccess(2);
+  lru_k_replacer.RecordAccess(1);
+  for (frame_id_t frame_id = 0; frame_id < 4; ++frame_id) {
+    lru_k_replacer.Unpin(frame_id);
+  }
+
+  // Frames 0 and 3 have one reference each, and 0's is older; 2's references are correlated as well.
+  int value;
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(0, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(3, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(2, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(1, value);
+}
+
+TEST(LRUKReplacerTest, AbandonedVictimTest) {
+  LRUKReplacer lru_k_replacer(3, 2, 0);
+
+  // Scenario: frames 0 and 1 are referenced twice each, 0 first.
+  for (int round = 0; round < 2; ++round) {
+    lru_k_replacer.RecordAccess(0);
+    lru_k_replacer.RecordAccess(1);
+  }
+  lru_k_replacer.Unpin(0);
+  lru_k_replacer.Unpin(1);
+
+  // Scenario: the buffer pool gives up on victim 0, which got pinned meanwhile, and hands it back later.
+  int value;
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(0, value);
+  lru_k_replacer.Unpin(0);
+
+  // Frame 0 kept its two references, so frame 2 with a single one goes first.
+  lru_k_replacer.RecordAccess(2);
+  lru_k_replacer.Unpin(2);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(2, value);
+
+  // Scenario: frame 2 is evicted and loads another page, whose history starts from scratch.
+  lru_k_replacer.RecordEviction(2, 2);
+  lru_k_replacer.RecordAccess(2);
+  lru_k_replacer.Unpin(2);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(2, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(0, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(1, value);
+}
+
+}  // namespace bustub
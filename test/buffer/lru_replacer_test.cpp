@@ -59,4 +59,27 @@ TEST(LRUReplacerTest, SampleTest) {
   EXPECT_EQ(4, value);
 }
 
+TEST(LRUReplacerTest, RecordAccessTest) {
+  LRUReplacer lru_replacer(4);
+
+  // Scenario: frames 0-2 are unpinned in order, then frame 0 is accessed while it stays in the replacer.
+  lru_replacer.Unpin(0);
+  lru_replacer.Unpin(1);
+  lru_replacer.Unpin(2);
+  lru_replacer.RecordAccess(0);
+  // An access to a frame the replacer does not have changes nothing.
+  lru_replacer.RecordAccess(3);
+  EXPECT_EQ(3, lru_replacer.Size());
+
+  // The accessed frame is now the most recently used one.
+  int value;
+  lru_replacer.Victim(&value);
+  EXPECT_EQ(1, value);
+  lru_replacer.Victim(&value);
+  EXPECT_EQ(2, value);
+  lru_replacer.Victim(&value);
+  EXPECT_EQ(0, value);
+  EXPECT_FALSE(lru_replacer.Victim(&value));
+}
+
 }  // namespace bustub
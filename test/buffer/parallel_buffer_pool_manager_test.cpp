@@ -11,9 +11,13 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/parallel_buffer_pool_manager.h"
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <future>  // NOLINT
 #include <random>
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 #include "buffer/buffer_pool_manager.h"
 #include "gtest/gtest.h"
 
@@ -82,6 +86,8 @@ TEST(ParallelBufferPoolManagerTest, BinaryDataTest) {
   // Shutdown the disk manager and remove the temporary file we created.
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
 
   delete bpm;
   delete disk_manager;
@@ -146,6 +152,234 @@ TEST(ParallelBufferPoolManagerTest, SampleTest) {
   // Shutdown the disk manager and remove the temporary file we created.
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that new pages from concurrent threads are spread over all the instances
+TEST(ParallelBufferPoolManagerTest, NewPagePlacementTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 8;
+  const size_t num_instances = 4;
+  const size_t num_threads = 4;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new ParallelBufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  // Scenario: Consecutive new pages go to consecutive instances.
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < num_instances; ++i) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(i, page_id_temp % num_instances);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+    EXPECT_EQ(true, bpm->DeletePage(page_id_temp));
+  }
+
+  // Scenario: In page mode the near page is only a hint, and new pages near it still go round the instances.
+  for (size_t i = 0; i < num_instances; ++i) {
+    ASSERT_NE(nullptr, bpm->NewPageNear(&page_id_temp, 0));
+    EXPECT_EQ(i, page_id_temp % num_instances);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+    EXPECT_EQ(true, bpm->DeletePage(page_id_temp));
+  }
+
+  // Scenario: Threads that keep every page pinned fill the whole pool, with each instance holding its share.
+  std::vector<std::vector<page_id_t>> thread_page_ids(num_threads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      page_id_t page_id;
+      for (size_t i = 0; i < buffer_pool_size * num_instances / num_threads; ++i) {
+        if (bpm->NewPage(&page_id) != nullptr) {
+          thread_page_ids[t].push_back(page_id);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::vector<size_t> instance_pages(num_instances, 0);
+  for (auto &page_ids : thread_page_ids) {
+    for (auto page_id : page_ids) {
+      ++instance_pages[page_id % num_instances];
+    }
+  }
+  for (size_t i = 0; i < num_instances; ++i) {
+    EXPECT_EQ(buffer_pool_size, instance_pages[i]);
+  }
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp));
+
+  // Scenario: Once one instance has a free frame again, the next new page lands there wherever the search starts.
+  page_id_t freed = thread_page_ids[0][0];
+  EXPECT_EQ(true, bpm->UnpinPage(freed, false));
+  EXPECT_EQ(true, bpm->DeletePage(freed));
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(freed % num_instances, page_id_temp % num_instances);
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that extent partitioning keeps runs of pages in one instance and that near pages follow their neighbours
+TEST(ParallelBufferPoolManagerTest, PartitionModeTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 8;
+  const size_t num_instances = 2;
+  const page_id_t extent_size = PARTITION_EXTENT_SIZE;
+
+  auto *disk_manager = new DiskManager(db_name);
+  // Bind the frames to node 0, which exists on every machine.
+  auto *bpm = new ParallelBufferPoolManager(num_instances, buffer_pool_size, disk_manager, nullptr, ReplacerType::LRU,
+                                            PartitionMode::EXTENT, 1);
+
+  // Scenario: Each instance hands out the consecutive ids of its own extent.
+  page_id_t page_id_temp;
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(0, page_id_temp);
+  EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(extent_size, page_id_temp);
+  EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+
+  // Scenario: Pages created near page 0 fill its extent, then skip to the instance's next extent.
+  page_id_t near_page_id = 0;
+  for (page_id_t i = 1; i <= extent_size; ++i) {
+    auto *page = bpm->NewPageNear(&page_id_temp, near_page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(i < extent_size ? i : 2 * extent_size, page_id_temp);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+    near_page_id = page_id_temp;
+  }
+
+  // Scenario: The pages were routed to the instance that owns them.
+  for (page_id_t page_id : {1, extent_size - 1, 2 * extent_size}) {
+    auto *page = bpm->FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ("page " + std::to_string(page_id), std::string(page->GetData()));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that a batch fetch spanning all the instances returns every page in order
+TEST(ParallelBufferPoolManagerTest, FetchPagesTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 4;
+  const size_t num_instances = 3;
+  const page_id_t num_pages = 30;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new ParallelBufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  // Write the pages straight to disk, so that the batch does not depend on where NewPage placed them.
+  char data[PAGE_SIZE];
+  for (page_id_t i = 0; i < num_pages; ++i) {
+    snprintf(data, PAGE_SIZE, "page %d", i);
+    disk_manager->WritePage(i, data);
+  }
+
+  // Scenario: Every instance gets part of the batch, and the result follows the order of the request.
+  std::vector<page_id_t> page_ids = {29, 0, 14, 7, 3, 22, 1, 17};
+  auto pages = bpm->FetchPages(page_ids);
+  ASSERT_EQ(page_ids.size(), pages.size());
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    ASSERT_NE(nullptr, pages[i]);
+    EXPECT_EQ(page_ids[i], pages[i]->GetPageId());
+    EXPECT_EQ("page " + std::to_string(page_ids[i]), std::string(pages[i]->GetData()));
+    EXPECT_EQ(true, bpm->UnpinPage(page_ids[i], false));
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Check that concurrent batch fetches across the instances make progress and leave no pins behind when they stall
+TEST(ParallelBufferPoolManagerTest, ConcurrentFetchPagesTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 4;
+  const size_t num_instances = 3;
+  const page_id_t num_pages = 24;
+  const int num_threads = 4;
+  const int rounds = 1000;
+  const auto saved_interval = page_cleaner_interval;
+
+  auto *disk_manager = new DiskManager(db_name);
+  // Every victim is dirty, so misses keep stalling on each other's write-backs.
+  page_cleaner_interval = std::chrono::hours(1);
+  auto *bpm = new ParallelBufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  char data[PAGE_SIZE];
+  for (page_id_t i = 0; i < num_pages; ++i) {
+    snprintf(data, PAGE_SIZE, "page %d", i);
+    disk_manager->WritePage(i, data);
+  }
+
+  // Scenario: threads fetch random batches spanning the instances and dirty every page they get.
+  auto fetch = [&](int t) {
+    std::mt19937 rng(t);
+    std::uniform_int_distribution<page_id_t> page_dist(0, num_pages - 1);
+    for (int r = 0; r < rounds; ++r) {
+      std::vector<page_id_t> page_ids = {page_dist(rng), page_dist(rng), page_dist(rng)};
+      auto pages = bpm->FetchPages(page_ids);
+      for (size_t i = 0; i < page_ids.size(); ++i) {
+        if (pages[i] == nullptr) {
+          continue;
+        }
+        EXPECT_EQ("page " + std::to_string(page_ids[i]), std::string(pages[i]->GetData()));
+        EXPECT_EQ(true, bpm->UnpinPage(page_ids[i], true));
+      }
+    }
+  };
+  std::vector<std::future<void>> fetchers;
+  for (int t = 0; t < num_threads; ++t) {
+    fetchers.push_back(std::async(std::launch::async, fetch, t));
+  }
+  for (auto &fetcher : fetchers) {
+    EXPECT_EQ(std::future_status::ready, fetcher.wait_for(std::chrono::seconds(30)));
+  }
+
+  // Scenario: no frame was left pinned, so a batch that needs every frame of every instance gets them all.
+  std::vector<page_id_t> page_ids;
+  for (size_t i = 0; i < buffer_pool_size * num_instances; ++i) {
+    page_ids.push_back(static_cast<page_id_t>(i));
+  }
+  auto pages = bpm->FetchPages(page_ids);
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    ASSERT_NE(nullptr, pages[i]);
+    EXPECT_EQ(true, bpm->UnpinPage(page_ids[i], false));
+  }
+
+  page_cleaner_interval = saved_interval;
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
 
   delete bpm;
   delete disk_manager;
@@ -52,6 +52,8 @@ TEST(HashTablePageTest, DISABLED_DirectoryPageSampleTest) {
   bpm->UnpinPage(directory_page_id, true, nullptr);
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
   delete disk_manager;
   delete bpm;
 }
@@ -110,6 +112,8 @@ TEST(HashTablePageTest, DISABLED_BucketPageSampleTest) {
   bpm->UnpinPage(bucket_page_id, true, nullptr);
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
   delete disk_manager;
   delete bpm;
 }
@@ -0,0 +1,455 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_manager_test.cpp
+//
+// Identification: test/recovery/log_manager_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstring>
+#include <future>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction_manager.h"
+#include "gtest/gtest.h"
+#include "recovery/log_manager.h"
+#include "recovery/log_recovery.h"
+
+namespace bustub {
+
+class LogManagerTest : public ::testing::Test {
+ protected:
+  // This function is called before every test.
+  void SetUp() override {
+    remove("test.db");
+    remove("test.log");
+    remove("test.fsm");
+  }
+
+  // This function is called after every test.
+  void TearDown() override {
+    remove("test.db");
+    remove("test.log");
+    remove("test.fsm");
+  };
+
+  /** @return a tuple of the given length, filled with a byte */
+  static auto MakeTuple(uint32_t length, char fill) -> Tuple {
+    std::vector<char> data(sizeof(uint32_t) + length, fill);
+    memcpy(data.data(), &length, sizeof(uint32_t));
+    Tuple tuple;
+    tuple.DeserializeFrom(data.data());
+    return tuple;
+  }
+
+  /** Read the whole log back, checking that the blocks tile it and the records tile each block exactly. */
+  static auto ReadLog(DiskManager *disk_manager) -> std::vector<LogRecord> {
+    int log_size = disk_manager->GetLogSize();
+    std::vector<char> log(log_size);
+    EXPECT_TRUE(disk_manager->ReadLog(log.data(), log_size, 0));
+    std::vector<LogRecord> records;
+    int offset = 0;
+    int block_size;
+    lsn_t base_lsn;
+    while ((block_size = LogRecovery::DeserializeBlockHeader(log.data() + offset, log_size - offset, &base_lsn)) > 0) {
+      int pos = offset + LogRecord::BLOCK_HEADER_SIZE;
+      int end = offset + block_size - LogRecord::BLOCK_TRAILER_SIZE;
+      LogRecord record;
+      while (pos < end && LogRecovery::DeserializeLogRecord(log.data() + pos, end - pos, base_lsn, &record)) {
+        records.push_back(record);
+        pos += record.GetSize();
+      }
+      EXPECT_EQ(end, pos);
+      offset += block_size;
+    }
+    EXPECT_EQ(log_size, offset);
+    return records;
+  }
+
+  /** Read the whole log and return the LSN of each record. */
+  static auto ReadLsns(DiskManager *disk_manager) -> std::vector<lsn_t> {
+    std::vector<lsn_t> lsns;
+    for (auto &record : ReadLog(disk_manager)) {
+      lsns.push_back(record.GetLSN());
+    }
+    return lsns;
+  }
+};
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, AppendTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+
+  LogRecord begin(0, INVALID_LSN, LogRecordType::BEGIN);
+  EXPECT_EQ(0, log_manager->AppendLogRecord(&begin));
+  EXPECT_EQ(0, begin.GetLSN());
+  LogRecord insert(0, begin.GetLSN(), LogRecordType::INSERT, RID(1, 2), MakeTuple(10, 'a'));
+  EXPECT_EQ(1, log_manager->AppendLogRecord(&insert));
+  LogRecord commit(0, insert.GetLSN(), LogRecordType::COMMIT);
+  EXPECT_EQ(2, log_manager->AppendLogRecord(&commit));
+  EXPECT_EQ(3, log_manager->GetNextLSN());
+
+  // Nothing is durable until the buffer is flushed.
+  EXPECT_EQ(INVALID_LSN, log_manager->GetPersistentLSN());
+  log_manager->Flush();
+  EXPECT_EQ(2, log_manager->GetPersistentLSN());
+  EXPECT_EQ(1, disk_manager->GetNumFlushes());
+  // Flushing an empty buffer writes nothing.
+  log_manager->Flush();
+  EXPECT_EQ(1, disk_manager->GetNumFlushes());
+
+  // The flush wrote one block, framing the records.
+  auto block_size = LogRecord::BLOCK_HEADER_SIZE + begin.GetSize() + insert.GetSize() + commit.GetSize() +
+                    LogRecord::BLOCK_TRAILER_SIZE;
+  EXPECT_EQ(block_size, disk_manager->GetLogSize());
+  EXPECT_EQ((std::vector<lsn_t>{0, 1, 2}), ReadLsns(disk_manager));
+
+  // The insert carries its rid and tuple after the header.
+  auto records = ReadLog(disk_manager);
+  ASSERT_EQ(3, records.size());
+  EXPECT_EQ(LogRecordType::INSERT, records[1].GetLogRecordType());
+  EXPECT_EQ(0, records[1].GetPrevLSN());
+  EXPECT_EQ(RID(1, 2), records[1].GetInsertRID());
+  EXPECT_EQ(10, records[1].GetInsertTuple().GetLength());
+  EXPECT_EQ('a', records[1].GetInsertTuple().GetData()[9]);
+
+  // After a restart, LSNs carry on where the log left off.
+  disk_manager->ShutDown();
+  delete log_manager;
+  delete disk_manager;
+  disk_manager = new DiskManager("test.db");
+  log_manager = new LogManager(disk_manager);
+  EXPECT_EQ(3, log_manager->GetNextLSN());
+  EXPECT_EQ(2, log_manager->GetPersistentLSN());
+  LogRecord next_begin(1, INVALID_LSN, LogRecordType::BEGIN);
+  EXPECT_EQ(3, log_manager->AppendLogRecord(&next_begin));
+  log_manager->Flush();
+  EXPECT_EQ((std::vector<lsn_t>{0, 1, 2, 3}), ReadLsns(disk_manager));
+
+  // The second block is decoded on its own, from its base LSN.
+  std::vector<char> block(disk_manager->GetLogSize() - block_size);
+  ASSERT_TRUE(disk_manager->ReadLog(block.data(), static_cast<int>(block.size()), block_size));
+  lsn_t base_lsn;
+  EXPECT_EQ(block.size(), LogRecovery::DeserializeBlockHeader(block.data(), static_cast<int>(block.size()), &base_lsn));
+  EXPECT_EQ(3, base_lsn);
+  LogRecord record;
+  EXPECT_TRUE(LogRecovery::DeserializeLogRecord(block.data() + LogRecord::BLOCK_HEADER_SIZE, next_begin.GetSize(),
+                                                base_lsn, &record));
+  EXPECT_EQ(3, record.GetLSN());
+  EXPECT_EQ(1, record.GetTxnId());
+
+  // A block torn by a crash is not counted.
+  std::vector<char> torn(LogRecord::BLOCK_HEADER_SIZE, 0);
+  int32_t torn_size = 64;
+  memcpy(torn.data(), &torn_size, sizeof(int32_t));
+  disk_manager->WriteLog(torn.data(), static_cast<int>(torn.size()));
+  LogManager after_crash(disk_manager);
+  EXPECT_EQ(4, after_crash.GetNextLSN());
+
+  disk_manager->ShutDown();
+  delete log_manager;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Every record type survives the compact encoding, which logs only the changed bytes of an update.
+TEST_F(LogManagerTest, CompactEncodingTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+
+  auto old_tuple = MakeTuple(100, 'a');
+  auto new_tuple = old_tuple;
+  new_tuple.GetData()[50] = 'b';
+  new_tuple.GetData()[51] = 'c';
+  auto longer_tuple = MakeTuple(120, 'a');
+
+  std::vector<LogRecord> appended;
+  appended.emplace_back(7, INVALID_LSN, LogRecordType::BEGIN);
+  appended.emplace_back(7, 0, LogRecordType::NEWPAGE, INVALID_PAGE_ID, 3);
+  appended.emplace_back(7, 1, LogRecordType::INSERT, RID(3, 0), old_tuple);
+  appended.emplace_back(8, INVALID_LSN, LogRecordType::BEGIN);
+  appended.emplace_back(7, 2, LogRecordType::UPDATE, RID(3, 0), old_tuple, new_tuple);
+  appended.emplace_back(8, 3, LogRecordType::UPDATE, RID(3, 1), old_tuple, longer_tuple);
+  appended.emplace_back(7, 4, LogRecordType::MARKDELETE, RID(3, 0), Tuple());
+  appended.emplace_back(7, 6, LogRecordType::APPLYDELETE, RID(3, 0), new_tuple);
+  appended.emplace_back(8, 5, LogRecordType::ABORT);
+  appended.emplace_back(7, 7, LogRecordType::COMMIT);
+  appended.emplace_back(INVALID_TXN_ID, INVALID_LSN, LogRecordType::CHECKPOINT, 9,
+                        std::unordered_map<txn_id_t, lsn_t>{{9, INVALID_LSN}, {10, 8}},
+                        std::unordered_map<page_id_t, lsn_t>{{3, 1}, {4, 200}});
+  appended.emplace_back(8, 8, LogRecordType::ROLLBACKDELETE, RID(3, 1), Tuple());
+  appended.back().SetUndoNextLSN(3);
+  for (auto &record : appended) {
+    log_manager->AppendLogRecord(&record);
+  }
+  log_manager->Flush();
+
+  // Headers take a byte per field, and an update logs the two changed bytes, twice, rather than both tuples.
+  EXPECT_EQ(5, appended[0].GetSize());
+  EXPECT_LT(appended[4].GetSize(), 20);
+  EXPECT_LT(appended[5].GetSize(), 40);
+
+  auto records = ReadLog(disk_manager);
+  ASSERT_EQ(appended.size(), records.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(static_cast<lsn_t>(i), records[i].GetLSN());
+    EXPECT_EQ(appended[i].GetTxnId(), records[i].GetTxnId());
+    EXPECT_EQ(appended[i].GetPrevLSN(), records[i].GetPrevLSN());
+    EXPECT_EQ(appended[i].GetLogRecordType(), records[i].GetLogRecordType());
+    EXPECT_EQ(appended[i].GetSize(), records[i].GetSize());
+  }
+  EXPECT_EQ(INVALID_PAGE_ID, records[1].GetNewPageRecord());
+  EXPECT_EQ(3, records[1].GetNewPageId());
+  EXPECT_EQ(RID(3, 0), records[2].GetInsertRID());
+  EXPECT_EQ(0, memcmp(old_tuple.GetData(), records[2].GetInsertTuple().GetData(), old_tuple.GetLength()));
+
+  // Updates are redone and undone from the tuple on the page.
+  EXPECT_EQ(RID(3, 0), records[4].GetUpdateRID());
+  auto redone = records[4].RedoUpdate(old_tuple);
+  ASSERT_EQ(new_tuple.GetLength(), redone.GetLength());
+  EXPECT_EQ(0, memcmp(new_tuple.GetData(), redone.GetData(), new_tuple.GetLength()));
+  auto undone = records[4].UndoUpdate(new_tuple);
+  ASSERT_EQ(old_tuple.GetLength(), undone.GetLength());
+  EXPECT_EQ(0, memcmp(old_tuple.GetData(), undone.GetData(), old_tuple.GetLength()));
+  auto grown = records[5].RedoUpdate(old_tuple);
+  ASSERT_EQ(longer_tuple.GetLength(), grown.GetLength());
+  EXPECT_EQ(0, memcmp(longer_tuple.GetData(), grown.GetData(), longer_tuple.GetLength()));
+  EXPECT_EQ(100, records[5].UndoUpdate(longer_tuple).GetLength());
+
+  EXPECT_EQ(RID(3, 0), records[6].GetDeleteRID());
+  EXPECT_EQ(0, records[6].GetDeleteTuple().GetLength());
+  EXPECT_EQ(100, records[7].GetDeleteTuple().GetLength());
+
+  EXPECT_EQ(9, records[10].GetBeginLsn());
+  EXPECT_EQ((std::unordered_map<txn_id_t, lsn_t>{{9, INVALID_LSN}, {10, 8}}), records[10].GetActiveTransactions());
+  EXPECT_EQ((std::unordered_map<page_id_t, lsn_t>{{3, 1}, {4, 200}}), records[10].GetDirtyPages());
+
+  // A CLR carries where undo goes on from.
+  EXPECT_FALSE(records[10].IsCompensation());
+  EXPECT_TRUE(records[11].IsCompensation());
+  EXPECT_EQ(3, records[11].GetUndoNextLSN());
+  EXPECT_EQ(RID(3, 1), records[11].GetDeleteRID());
+
+  // A record or a block cut short is not deserialized.
+  std::vector<char> log(disk_manager->GetLogSize());
+  disk_manager->ReadLog(log.data(), static_cast<int>(log.size()), 0);
+  const char *first = log.data() + LogRecord::BLOCK_HEADER_SIZE;
+  LogRecord record;
+  EXPECT_FALSE(LogRecovery::DeserializeLogRecord(first, appended[0].GetSize() - 1, 0, &record));
+  EXPECT_TRUE(LogRecovery::DeserializeLogRecord(first, appended[0].GetSize(), 0, &record));
+  EXPECT_FALSE(LogRecovery::DeserializeLogRecord(first + record.GetSize(), 1, 0, &record));
+  lsn_t base_lsn;
+  EXPECT_EQ(0, LogRecovery::DeserializeBlockHeader(log.data(), static_cast<int>(log.size()) - 1, &base_lsn));
+  EXPECT_EQ(log.size(), LogRecovery::DeserializeBlockHeader(log.data(), static_cast<int>(log.size()), &base_lsn));
+
+  disk_manager->ShutDown();
+  delete log_manager;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// A dirty-page table larger than a log buffer is split over several CHECKPOINT records, which together hold all of it.
+TEST_F(LogManagerTest, SplitCheckpointTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+
+  std::unordered_map<txn_id_t, lsn_t> active_txns{{3, 100000}, {4, INVALID_LSN}};
+  std::unordered_map<page_id_t, lsn_t> dirty_pages;
+  for (page_id_t page_id = 0; page_id < LOG_BUFFER_SIZE / 4; ++page_id) {
+    dirty_pages[page_id + 100000] = 100000 + page_id;
+  }
+  auto appended = LogRecord::MakeCheckpoint(5, active_txns, dirty_pages);
+  ASSERT_GT(appended.size(), 1);
+  for (auto &record : appended) {
+    log_manager->AppendLogRecord(&record);
+    EXPECT_LE(record.GetSize(), LogRecord::MAX_SIZE);
+  }
+  log_manager->Flush();
+
+  auto records = ReadLog(disk_manager);
+  ASSERT_EQ(appended.size(), records.size());
+  std::unordered_map<txn_id_t, lsn_t> logged_txns;
+  std::unordered_map<page_id_t, lsn_t> logged_pages;
+  for (size_t i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(LogRecordType::CHECKPOINT, records[i].GetLogRecordType());
+    EXPECT_EQ(5, records[i].GetBeginLsn());
+    EXPECT_EQ(records.size() - 1 - i, records[i].GetPartsLeft());
+    logged_txns.insert(records[i].GetActiveTransactions().begin(), records[i].GetActiveTransactions().end());
+    logged_pages.insert(records[i].GetDirtyPages().begin(), records[i].GetDirtyPages().end());
+  }
+  EXPECT_EQ(active_txns, logged_txns);
+  EXPECT_EQ(dirty_pages, logged_pages);
+
+  disk_manager->ShutDown();
+  delete log_manager;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Concurrent appends fill the log buffers in parallel; the log must still hold every record exactly once, in LSN order.
+TEST_F(LogManagerTest, ConcurrentAppendTest) {
+  const int records_per_thread = 5000;
+  const std::vector<int> thread_counts{1, 2, 4, 8};
+
+  for (auto num_threads : thread_counts) {
+    remove("test.log");
+    auto *disk_manager = new DiskManager("test.db");
+    auto *log_manager = new LogManager(disk_manager);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&, t] {
+        auto tuple = MakeTuple(16 + t * 8, static_cast<char>('a' + t));
+        lsn_t prev_lsn = INVALID_LSN;
+        for (int i = 0; i < records_per_thread; ++i) {
+          if (i % 2 == 0) {
+            LogRecord record(t, prev_lsn, LogRecordType::BEGIN);
+            prev_lsn = log_manager->AppendLogRecord(&record);
+          } else {
+            LogRecord record(t, prev_lsn, LogRecordType::INSERT, RID(t, i), tuple);
+            prev_lsn = log_manager->AppendLogRecord(&record);
+          }
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    log_manager->Flush();
+
+    auto num_records = num_threads * records_per_thread;
+    EXPECT_EQ(num_records, log_manager->GetNextLSN());
+    EXPECT_EQ(num_records - 1, log_manager->GetPersistentLSN());
+    auto lsns = ReadLsns(disk_manager);
+    ASSERT_EQ(num_records, lsns.size());
+    for (int i = 0; i < num_records; ++i) {
+      ASSERT_EQ(i, lsns[i]);
+    }
+    // A log manager started on a log that spans many blocks finds where it left off from the last one.
+    LogManager restarted(disk_manager);
+    EXPECT_EQ(num_records, restarted.GetNextLSN());
+
+    disk_manager->ShutDown();
+    delete log_manager;
+    delete disk_manager;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, DurableFutureTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+
+  // Without a flush thread, asking for durability flushes right away.
+  LogRecord begin(0, INVALID_LSN, LogRecordType::BEGIN);
+  auto lsn = log_manager->AppendLogRecord(&begin);
+  auto future = log_manager->GetDurableFuture(lsn);
+  EXPECT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds(0)));
+  EXPECT_EQ(lsn, log_manager->GetPersistentLSN());
+
+  // With one, the flush happens on demand instead of at the next timeout.
+  log_manager->RunFlushThread();
+  EXPECT_TRUE(enable_logging);
+  LogRecord commit(0, lsn, LogRecordType::COMMIT);
+  lsn = log_manager->AppendLogRecord(&commit);
+  EXPECT_EQ(std::future_status::ready, log_manager->GetDurableFuture(lsn).wait_for(std::chrono::milliseconds(500)));
+  EXPECT_EQ(lsn, log_manager->GetPersistentLSN());
+  // An LSN that is durable already needs no flush.
+  EXPECT_EQ(std::future_status::ready, log_manager->GetDurableFuture(0).wait_for(std::chrono::seconds(0)));
+
+  // Stopping the flush thread flushes what is left.
+  LogRecord abort(1, INVALID_LSN, LogRecordType::ABORT);
+  lsn = log_manager->AppendLogRecord(&abort);
+  log_manager->StopFlushThread();
+  EXPECT_FALSE(enable_logging);
+  EXPECT_EQ(lsn, log_manager->GetPersistentLSN());
+
+  disk_manager->ShutDown();
+  delete log_manager;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+// Commits only return once their commit record is durable, and concurrent commits share log writes.
+TEST_F(LogManagerTest, GroupCommitTest) {
+  const int commits_per_thread = 200;
+  const std::vector<int> thread_counts{1, 2, 4, 8};
+
+  for (auto num_threads : thread_counts) {
+    remove("test.log");
+    auto *disk_manager = new DiskManager("test.db");
+    auto *log_manager = new LogManager(disk_manager);
+    LockManager lock_manager;
+    TransactionManager txn_manager(&lock_manager, log_manager);
+    log_manager->RunFlushThread();
+
+    auto tuple = MakeTuple(64, 'x');
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&, t] {
+        for (int i = 0; i < commits_per_thread; ++i) {
+          auto *txn = txn_manager.Begin();
+          LogRecord insert(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::INSERT, RID(t, i), tuple);
+          txn->SetPrevLSN(log_manager->AppendLogRecord(&insert));
+          txn_manager.Commit(txn);
+          EXPECT_GE(log_manager->GetPersistentLSN(), txn->GetPrevLSN());
+          delete txn;
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    log_manager->StopFlushThread();
+
+    auto num_commits = num_threads * commits_per_thread;
+    EXPECT_EQ(3 * num_commits, log_manager->GetNextLSN());
+    EXPECT_LE(disk_manager->GetNumFlushes(), num_commits);
+    if (num_threads == thread_counts.back()) {
+      EXPECT_LT(disk_manager->GetNumFlushes(), num_commits);
+    }
+    disk_manager->ShutDown();
+    delete log_manager;
+    delete disk_manager;
+  }
+
+  // Scenario: commits waiting together are made durable by one log write.
+  const int num_waiting = 8;
+  remove("test.log");
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  log_manager->RunFlushThread();
+  std::vector<lsn_t> commit_lsns;
+  for (int i = 0; i < num_waiting; ++i) {
+    LogRecord commit(i, INVALID_LSN, LogRecordType::COMMIT);
+    commit_lsns.push_back(log_manager->AppendLogRecord(&commit));
+  }
+  // A timeout flush may write the commits out before anybody waits for them, but then it is the only write.
+  auto num_flushes = disk_manager->GetNumFlushes();
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_waiting);
+  for (auto lsn : commit_lsns) {
+    futures.push_back(log_manager->GetDurableFuture(lsn));
+  }
+  for (auto &future : futures) {
+    EXPECT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds(5)));
+  }
+  EXPECT_LE(disk_manager->GetNumFlushes(), num_flushes + 1);
+  log_manager->StopFlushThread();
+  disk_manager->ShutDown();
+  delete log_manager;
+  delete disk_manager;
+}
+
+}  // namespace bustub
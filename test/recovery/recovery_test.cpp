@@ -10,7 +10,16 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <unistd.h>
+
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iterator>
 #include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "common/bustub_instance.h"
@@ -32,6 +41,7 @@ class RecoveryTest : public ::testing::Test {
   void SetUp() override {
     remove("test.db");
     remove("test.log");
+    remove("test.fsm");
   }
 
   // This function is called after every test.
@@ -39,11 +49,71 @@ class RecoveryTest : public ::testing::Test {
     LOG_INFO("Tearing down the system..");
     remove("test.db");
     remove("test.log");
+    remove("test.fsm");
   };
 };
 
+/**
+ * A buffer pool that crashes the process once a number of changed pages have been unpinned through it, after writing
+ * out every page, as if the buffer pool had evicted them all just before the crash.
+ */
+class CrashingBufferPoolManager : public BufferPoolManager {
+ public:
+  explicit CrashingBufferPoolManager(BufferPoolManager *buffer_pool_manager)
+      : buffer_pool_manager_(buffer_pool_manager) {}
+
+  /** Crash once the given number of changed pages have been unpinned from now on. */
+  void CrashAfter(int changes) { changes_left_ = changes; }
+
+  /** Call a function on the dirty-page table whenever it is read, as a checkpoint does when it begins. */
+  void OnDirtyPageTable(std::function<void(std::unordered_map<page_id_t, lsn_t> *)> callback) {
+    on_dirty_page_table_ = std::move(callback);
+  }
+
+  auto GetPoolSize() -> size_t override { return buffer_pool_manager_->GetPoolSize(); }
+
+ protected:
+  auto FetchPgImp(page_id_t page_id) -> Page * override { return buffer_pool_manager_->FetchPage(page_id); }
+  auto UnpinPgImp(page_id_t page_id, bool is_dirty) -> bool override {
+    bool unpinned = buffer_pool_manager_->UnpinPage(page_id, is_dirty);
+    if (is_dirty && --changes_left_ == 0) {
+      buffer_pool_manager_->FlushAllPages();
+      _exit(0);
+    }
+    return unpinned;
+  }
+  auto FlushPgImp(page_id_t page_id) -> bool override { return buffer_pool_manager_->FlushPage(page_id); }
+  auto NewPgImp(page_id_t *page_id) -> Page * override { return buffer_pool_manager_->NewPage(page_id); }
+  auto DeletePgImp(page_id_t page_id) -> bool override { return buffer_pool_manager_->DeletePage(page_id); }
+  void FlushAllPgsImp() override { buffer_pool_manager_->FlushAllPages(); }
+  auto GetDirtyPageTableImp() -> std::unordered_map<page_id_t, lsn_t> override {
+    auto dirty_page_table = buffer_pool_manager_->GetDirtyPageTable();
+    if (on_dirty_page_table_) {
+      on_dirty_page_table_(&dirty_page_table);
+    }
+    return dirty_page_table;
+  }
+
+ private:
+  BufferPoolManager *buffer_pool_manager_;
+  std::atomic<int> changes_left_{-1};
+  std::function<void(std::unordered_map<page_id_t, lsn_t> *)> on_dirty_page_table_;
+};
+
+/** @return the contents of a file */
+static auto ReadFile(const std::string &file_name) -> std::string {
+  std::ifstream file(file_name, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/** Replace the contents of a file, as a crash does with the writes made since the last sync. */
+static void WriteFile(const std::string &file_name, const std::string &contents) {
+  std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+  file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+}
+
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_RedoTest) {
+TEST_F(RecoveryTest, RedoTest) {
   auto *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -101,7 +171,8 @@ TEST_F(RecoveryTest, DISABLED_RedoTest) {
   delete txn;
 
   LOG_INFO("Begin recovery");
-  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
 
   ASSERT_FALSE(enable_logging);
 
@@ -132,7 +203,7 @@ TEST_F(RecoveryTest, DISABLED_RedoTest) {
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_UndoTest) {
+TEST_F(RecoveryTest, UndoTest) {
   auto *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -185,7 +256,8 @@ TEST_F(RecoveryTest, DISABLED_UndoTest) {
   delete txn;
 
   LOG_INFO("Recovery started..");
-  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
 
   ASSERT_FALSE(enable_logging);
 
@@ -211,7 +283,609 @@ TEST_F(RecoveryTest, DISABLED_UndoTest) {
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_CheckpointTest) {
+// A database that has been recovered once keeps logging after the records already in the log, so that a second crash
+// recovers both runs.
+TEST_F(RecoveryTest, RepeatedRecoveryTest) {
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  Schema schema{std::vector<Column>{col1, col2}};
+  const Tuple tuple = ConstructTuple(&schema);
+  const Tuple tuple1 = ConstructTuple(&schema);
+  const Tuple tuple2 = ConstructTuple(&schema);
+
+  LOG_INFO("Insert two tuples and crash");
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  RID rid;
+  RID rid1;
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn));
+  ASSERT_TRUE(test_table->InsertTuple(tuple1, &rid1, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+
+  LOG_INFO("Recover, insert a third tuple, write the page out and crash");
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+  bustub_instance->log_manager_->RunFlushThread();
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  RID rid2;
+  ASSERT_TRUE(test_table->InsertTuple(tuple2, &rid2, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  // The page LSN on disk now comes from the second run, which redo compares the LSNs of both runs with.
+  bustub_instance->buffer_pool_manager_->FlushPage(first_page_id);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+
+  LOG_INFO("Recover again");
+  bustub_instance = new BustubInstance("test.db");
+  log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                 bustub_instance->log_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  std::vector<std::pair<RID, const Tuple *>> expected{{rid, &tuple}, {rid1, &tuple1}, {rid2, &tuple2}};
+  for (const auto &[expected_rid, expected_tuple] : expected) {
+    Tuple found;
+    ASSERT_TRUE(test_table->GetTuple(expected_rid, &found, txn));
+    EXPECT_EQ(found.GetValue(&schema, 0).CompareEquals(expected_tuple->GetValue(&schema, 0)), CmpBool::CmpTrue);
+    EXPECT_EQ(found.GetValue(&schema, 1).CompareEquals(expected_tuple->GetValue(&schema, 1)), CmpBool::CmpTrue);
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+// Redo replays many pages in parallel and undo rolls several losers back at once; the result must not depend on how
+// many threads recovery uses.
+TEST_F(RecoveryTest, ParallelRecoveryTest) {
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::VARCHAR, 100};
+  Schema schema{std::vector<Column>{col1, col2}};
+  auto make_tuple = [&](int key, char fill) {
+    return Tuple(std::vector<Value>{Value(TypeId::INTEGER, key), Value(TypeId::VARCHAR, std::string(60, fill))},
+                 &schema);
+  };
+
+  // More threads than the buffer pool has frames are capped at the pool size.
+  for (size_t num_threads : {size_t{1}, size_t{4}, static_cast<size_t>(BUFFER_POOL_SIZE + 6)}) {
+    remove("test.db");
+    remove("test.log");
+    remove("test.fsm");
+    auto *bustub_instance = new BustubInstance("test.db");
+    bustub_instance->log_manager_->RunFlushThread();
+    auto *txn_manager = bustub_instance->transaction_manager_;
+
+    Transaction *txn = txn_manager->Begin();
+    auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                     bustub_instance->log_manager_, txn);
+    page_id_t first_page_id = test_table->GetFirstPageId();
+    txn_manager->Commit(txn);
+    delete txn;
+
+    // The value each rid must hold after recovery; a missing value means the tuple must be gone.
+    std::vector<std::pair<RID, char>> expected;
+    for (int t = 0; t < 4; ++t) {
+      txn = txn_manager->Begin();
+      for (int i = 0; i < 100; ++i) {
+        RID rid;
+        ASSERT_TRUE(test_table->InsertTuple(make_tuple(t * 100 + i, static_cast<char>('a' + t)), &rid, txn));
+        expected.emplace_back(rid, static_cast<char>('a' + t));
+      }
+      txn_manager->Commit(txn);
+      delete txn;
+    }
+
+    // A committed transaction updates every third tuple and deletes every fifth.
+    txn = txn_manager->Begin();
+    for (int key = 0; key < 400; ++key) {
+      auto &[rid, fill] = expected[key];
+      if (key % 5 == 0) {
+        ASSERT_TRUE(test_table->MarkDelete(rid, txn));
+        fill = '\0';
+      } else if (key % 3 == 0) {
+        ASSERT_TRUE(test_table->UpdateTuple(make_tuple(key, 'u'), rid, txn));
+        fill = 'u';
+      }
+    }
+    txn_manager->Commit(txn);
+    delete txn;
+
+    // Two losers: one inserts, the other updates and deletes committed tuples.
+    Transaction *inserter = txn_manager->Begin();
+    std::vector<RID> loser_rids;
+    for (int i = 0; i < 100; ++i) {
+      RID rid;
+      ASSERT_TRUE(test_table->InsertTuple(make_tuple(1000 + i, 'x'), &rid, inserter));
+      loser_rids.push_back(rid);
+    }
+    Transaction *updater = txn_manager->Begin();
+    for (int key = 0; key < 400; ++key) {
+      if (key % 5 == 0) {
+        continue;
+      }
+      if (key % 7 == 1) {
+        ASSERT_TRUE(test_table->MarkDelete(expected[key].first, updater));
+      } else if (key % 3 == 1) {
+        ASSERT_TRUE(test_table->UpdateTuple(make_tuple(key, 'y'), expected[key].first, updater));
+      }
+    }
+    bustub_instance->log_manager_->Flush();
+    delete inserter;
+    delete updater;
+    delete test_table;
+    delete bustub_instance;
+
+    bustub_instance = new BustubInstance("test.db");
+    auto *log_recovery =
+        new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                        bustub_instance->log_manager_, num_threads);
+    log_recovery->Redo();
+    EXPECT_EQ(2, log_recovery->GetActiveTransactions().size());
+    log_recovery->Undo();
+    delete log_recovery;
+
+    txn = bustub_instance->transaction_manager_->Begin();
+    test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                               bustub_instance->log_manager_, first_page_id);
+    Tuple tuple;
+    for (int key = 0; key < 400; ++key) {
+      auto &[rid, fill] = expected[key];
+      if (fill == '\0') {
+        EXPECT_FALSE(test_table->GetTuple(rid, &tuple, txn)) << key;
+        continue;
+      }
+      ASSERT_TRUE(test_table->GetTuple(rid, &tuple, txn)) << key;
+      EXPECT_EQ(CmpBool::CmpTrue, tuple.GetValue(&schema, 0).CompareEquals(Value(TypeId::INTEGER, key)));
+      EXPECT_EQ(std::string(60, fill), tuple.GetValue(&schema, 1).ToString()) << key;
+    }
+    for (const auto &rid : loser_rids) {
+      EXPECT_FALSE(test_table->GetTuple(rid, &tuple, txn));
+    }
+    bustub_instance->transaction_manager_->Commit(txn);
+    delete txn;
+    delete test_table;
+    delete bustub_instance;
+  }
+}
+
+// NOLINTNEXTLINE
+// A checkpoint is taken while a transaction keeps changing the table. Recovery redoes from the dirty-page table of the
+// checkpoint and still rolls that transaction back.
+TEST_F(RecoveryTest, FuzzyCheckpointTest) {
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::VARCHAR, 100};
+  Schema schema{std::vector<Column>{col1, col2}};
+  auto make_tuple = [&](int key, char fill) {
+    return Tuple(std::vector<Value>{Value(TypeId::INTEGER, key), Value(TypeId::VARCHAR, std::string(60, fill))},
+                 &schema);
+  };
+
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *txn_manager = bustub_instance->transaction_manager_;
+
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<std::pair<RID, char>> expected;
+  for (int key = 0; key < 200; ++key) {
+    RID rid;
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(key, 'a'), &rid, txn));
+    expected.emplace_back(rid, 'a');
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+
+  // Every dirty page is dirty since an LSN that has been logged.
+  auto dirty_pages = bustub_instance->buffer_pool_manager_->GetDirtyPageTable();
+  EXPECT_FALSE(dirty_pages.empty());
+  for (const auto &[page_id, rec_lsn] : dirty_pages) {
+    EXPECT_LE(0, rec_lsn);
+    EXPECT_LT(rec_lsn, bustub_instance->log_manager_->GetNextLSN());
+  }
+
+  // Blocking transactions would wait for the loser forever.
+  Transaction *loser = txn_manager->Begin();
+  std::vector<RID> loser_rids(200);
+  std::thread writer([&] {
+    for (int i = 0; i < 200; ++i) {
+      EXPECT_TRUE(test_table->InsertTuple(make_tuple(1000 + i, 'x'), &loser_rids[i], loser));
+    }
+  });
+  bustub_instance->checkpoint_manager_->BeginCheckpoint();
+  writer.join();
+  bustub_instance->checkpoint_manager_->EndCheckpoint();
+
+  // Changes after the checkpoint are redone too.
+  txn = txn_manager->Begin();
+  for (int key = 0; key < 200; key += 4) {
+    ASSERT_TRUE(test_table->UpdateTuple(make_tuple(key, 'u'), expected[key].first, txn));
+    expected[key].second = 'u';
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  bustub_instance->log_manager_->Flush();
+  delete loser;
+  delete test_table;
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Redo();
+  EXPECT_EQ(1, log_recovery->GetActiveTransactions().size());
+  log_recovery->Undo();
+  delete log_recovery;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple tuple;
+  for (int key = 0; key < 200; ++key) {
+    ASSERT_TRUE(test_table->GetTuple(expected[key].first, &tuple, txn)) << key;
+    EXPECT_EQ(CmpBool::CmpTrue, tuple.GetValue(&schema, 0).CompareEquals(Value(TypeId::INTEGER, key)));
+    EXPECT_EQ(std::string(60, expected[key].second), tuple.GetValue(&schema, 1).ToString()) << key;
+  }
+  for (const auto &rid : loser_rids) {
+    EXPECT_FALSE(test_table->GetTuple(rid, &tuple, txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+// Pages are written back without a sync, which the default PageSyncPolicy::ON_CHECKPOINT leaves to the next checkpoint,
+// and are then clean, so the checkpoint's dirty-page table leaves them out. The machine crashes after the checkpoint
+// record is durable but before the checkpoint's own sync: whatever was not synced when the checkpoint began is lost.
+// Redo starts after the changes of those pages, so they must have been synced by then.
+TEST_F(RecoveryTest, CheckpointAfterWriteBackTest) {
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::VARCHAR, 100};
+  Schema schema{std::vector<Column>{col1, col2}};
+  auto make_tuple = [&](int key, char fill) {
+    return Tuple(std::vector<Value>{Value(TypeId::INTEGER, key), Value(TypeId::VARCHAR, std::string(60, fill))},
+                 &schema);
+  };
+
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *txn_manager = bustub_instance->transaction_manager_;
+  auto *disk_manager = bustub_instance->disk_manager_;
+  ASSERT_EQ(PageSyncPolicy::ON_CHECKPOINT, disk_manager->GetPageSyncPolicy());
+
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(200);
+  for (int key = 0; key < 200; ++key) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(key, 'a'), &rids[key], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  bustub_instance->checkpoint_manager_->BeginCheckpoint();
+  bustub_instance->checkpoint_manager_->EndCheckpoint();
+  std::string durable_db = ReadFile("test.db");
+
+  txn = txn_manager->Begin();
+  for (int key = 0; key < 200; ++key) {
+    ASSERT_TRUE(test_table->UpdateTuple(make_tuple(key, 'u'), rids[key], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  bustub_instance->buffer_pool_manager_->FlushAllPages();
+
+  // The database file is what the last sync made durable when the checkpoint reads its dirty-page table.
+  int num_syncs = disk_manager->GetNumSyncs();
+  CrashingBufferPoolManager observed_pool(bustub_instance->buffer_pool_manager_);
+  observed_pool.OnDirtyPageTable([&](std::unordered_map<page_id_t, lsn_t> * /*dirty_page_table*/) {
+    if (disk_manager->GetNumSyncs() > num_syncs) {
+      durable_db = ReadFile("test.db");
+    }
+  });
+  {
+    CheckpointManager checkpoint_manager(txn_manager, bustub_instance->log_manager_, &observed_pool, disk_manager);
+    checkpoint_manager.BeginCheckpoint();
+  }
+  delete test_table;
+  delete bustub_instance;
+  WriteFile("test.db", durable_db);
+
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple tuple;
+  for (int key = 0; key < 200; ++key) {
+    ASSERT_TRUE(test_table->GetTuple(rids[key], &tuple, txn)) << key;
+    EXPECT_EQ(std::string(60, 'u'), tuple.GetValue(&schema, 1).ToString()) << key;
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+// A checkpoint whose dirty-page table does not fit in a log buffer is logged over several records, and recovery reads
+// the whole checkpoint back from them.
+TEST_F(RecoveryTest, LargeCheckpointTest) {
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::VARCHAR, 100};
+  Schema schema{std::vector<Column>{col1, col2}};
+  auto make_tuple = [&](int key, char fill) {
+    return Tuple(std::vector<Value>{Value(TypeId::INTEGER, key), Value(TypeId::VARCHAR, std::string(60, fill))},
+                 &schema);
+  };
+
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *txn_manager = bustub_instance->transaction_manager_;
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(200);
+  for (int key = 0; key < 200; ++key) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(key, 'a'), &rids[key], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  Transaction *loser = txn_manager->Begin();
+  std::vector<RID> loser_rids(20);
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(1000 + i, 'x'), &loser_rids[i], loser));
+  }
+
+  // Pages that are not in the pool pad the dirty-page table out to more than a log buffer holds.
+  CrashingBufferPoolManager padded_pool(bustub_instance->buffer_pool_manager_);
+  padded_pool.OnDirtyPageTable([](std::unordered_map<page_id_t, lsn_t> *dirty_page_table) {
+    for (page_id_t page_id = 0; page_id < LOG_BUFFER_SIZE / 4; ++page_id) {
+      dirty_page_table->emplace(1000000 + page_id, 0);
+    }
+  });
+  lsn_t begin_lsn = bustub_instance->log_manager_->GetNextLSN();
+  {
+    CheckpointManager checkpoint_manager(txn_manager, bustub_instance->log_manager_, &padded_pool,
+                                         bustub_instance->disk_manager_);
+    checkpoint_manager.BeginCheckpoint();
+  }
+  EXPECT_LT(begin_lsn + 1, bustub_instance->log_manager_->GetNextLSN());
+  bustub_instance->log_manager_->Flush();
+  delete loser;
+  delete test_table;
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Redo();
+  EXPECT_EQ(1, log_recovery->GetActiveTransactions().size());
+  log_recovery->Undo();
+  delete log_recovery;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple tuple;
+  for (int key = 0; key < 200; ++key) {
+    ASSERT_TRUE(test_table->GetTuple(rids[key], &tuple, txn)) << key;
+    EXPECT_EQ(CmpBool::CmpTrue, tuple.GetValue(&schema, 0).CompareEquals(Value(TypeId::INTEGER, key)));
+  }
+  for (const auto &rid : loser_rids) {
+    EXPECT_FALSE(test_table->GetTuple(rid, &tuple, txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+// Analysis reads the log from the last checkpoint on, so the log before it may be gone, as long as no page needs its
+// changes redone and no loser needs its changes undone. The test destroys the first block of the log to make sure it
+// is never read: a loser whose records come after that block, but before the checkpoint, is only known from the
+// checkpoint, and undo reads its records back from before the checkpoint.
+TEST_F(RecoveryTest, AnalysisFromCheckpointTest) {
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::VARCHAR, 100};
+  Schema schema{std::vector<Column>{col1, col2}};
+  auto make_tuple = [&](int key, char fill) {
+    return Tuple(std::vector<Value>{Value(TypeId::INTEGER, key), Value(TypeId::VARCHAR, std::string(60, fill))},
+                 &schema);
+  };
+
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *txn_manager = bustub_instance->transaction_manager_;
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(200);
+  for (int key = 0; key < 200; ++key) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(key, 'a'), &rids[key], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  bustub_instance->log_manager_->Flush();
+
+  Transaction *loser = txn_manager->Begin();
+  std::vector<RID> loser_rids(20);
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(1000 + i, 'x'), &loser_rids[i], loser));
+  }
+  bustub_instance->log_manager_->Flush();
+
+  // The first checkpoint writes every page back, so the second one has no dirty pages to redo from before it.
+  bustub_instance->checkpoint_manager_->BeginCheckpoint();
+  bustub_instance->checkpoint_manager_->EndCheckpoint();
+  bustub_instance->checkpoint_manager_->BeginCheckpoint();
+  bustub_instance->checkpoint_manager_->EndCheckpoint();
+
+  txn = txn_manager->Begin();
+  for (int key = 0; key < 200; key += 4) {
+    ASSERT_TRUE(test_table->UpdateTuple(make_tuple(key, 'u'), rids[key], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  bustub_instance->log_manager_->Flush();
+  delete loser;
+  delete test_table;
+  delete bustub_instance;
+
+  {
+    std::fstream log("test.log", std::ios::binary | std::ios::in | std::ios::out);
+    const int32_t no_block = 0;
+    log.write(reinterpret_cast<const char *>(&no_block), sizeof(int32_t));
+  }
+
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Redo();
+  EXPECT_EQ(1, log_recovery->GetActiveTransactions().size());
+  log_recovery->Undo();
+  delete log_recovery;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple tuple;
+  for (int key = 0; key < 200; ++key) {
+    ASSERT_TRUE(test_table->GetTuple(rids[key], &tuple, txn)) << key;
+    EXPECT_EQ(std::string(60, key % 4 == 0 ? 'u' : 'a'), tuple.GetValue(&schema, 1).ToString()) << key;
+  }
+  for (const auto &rid : loser_rids) {
+    EXPECT_FALSE(test_table->GetTuple(rid, &tuple, txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+// Recovery crashes halfway through rolling back a loser, after the pages it has undone so far reached the disk. The next
+// recovery must not undo those changes again: the loser shrank tuples, so undoing a shrink twice would corrupt them.
+TEST_F(RecoveryTest, CrashDuringUndoTest) {
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::VARCHAR, 100};
+  Schema schema{std::vector<Column>{col1, col2}};
+  auto make_tuple = [&](int key, char fill, size_t length) {
+    return Tuple(std::vector<Value>{Value(TypeId::INTEGER, key), Value(TypeId::VARCHAR, std::string(length, fill))},
+                 &schema);
+  };
+
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *txn_manager = bustub_instance->transaction_manager_;
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(200);
+  for (int key = 0; key < 200; ++key) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(key, 'a', 60), &rids[key], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+
+  // The loser inserts tuples, then shrinks every committed one.
+  Transaction *loser = txn_manager->Begin();
+  std::vector<RID> loser_rids(20);
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(1000 + i, 'x', 60), &loser_rids[i], loser));
+  }
+  for (int key = 0; key < 200; ++key) {
+    ASSERT_TRUE(test_table->UpdateTuple(make_tuple(key, 'y', 40), rids[key], loser));
+  }
+  bustub_instance->log_manager_->Flush();
+  delete loser;
+  delete test_table;
+  delete bustub_instance;
+
+  EXPECT_EXIT(
+      {
+        auto *crashing_instance = new BustubInstance("test.db");
+        CrashingBufferPoolManager crashing_pool(crashing_instance->buffer_pool_manager_);
+        LogRecovery log_recovery(crashing_instance->disk_manager_, &crashing_pool, crashing_instance->log_manager_);
+        log_recovery.Redo();
+        crashing_pool.CrashAfter(100);
+        log_recovery.Undo();
+      },
+      ::testing::ExitedWithCode(0), "");
+
+  // The loser has no ABORT record yet, so it is rolled back again, from where the crash stopped it: only the 120
+  // changes left are undone, each logging a CLR, and then the ABORT record is logged.
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Redo();
+  EXPECT_EQ(1, log_recovery->GetActiveTransactions().size());
+  lsn_t undo_lsn = bustub_instance->log_manager_->GetNextLSN();
+  log_recovery->Undo();
+  EXPECT_EQ(undo_lsn + 121, bustub_instance->log_manager_->GetNextLSN());
+  delete log_recovery;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple tuple;
+  for (int key = 0; key < 200; ++key) {
+    ASSERT_TRUE(test_table->GetTuple(rids[key], &tuple, txn)) << key;
+    EXPECT_EQ(CmpBool::CmpTrue, tuple.GetValue(&schema, 0).CompareEquals(Value(TypeId::INTEGER, key)));
+    EXPECT_EQ(std::string(60, 'a'), tuple.GetValue(&schema, 1).ToString()) << key;
+  }
+  for (const auto &rid : loser_rids) {
+    EXPECT_FALSE(test_table->GetTuple(rid, &tuple, txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  bustub_instance->log_manager_->Flush();
+  delete bustub_instance;
+
+  // Once its ABORT record is in the log, the loser is done with.
+  bustub_instance = new BustubInstance("test.db");
+  log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                 bustub_instance->log_manager_);
+  log_recovery->Redo();
+  EXPECT_TRUE(log_recovery->GetActiveTransactions().empty());
+  delete log_recovery;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, CheckpointTest) {
   auto *bustub_instance = new BustubInstance("test.db");
 
   EXPECT_FALSE(enable_logging);
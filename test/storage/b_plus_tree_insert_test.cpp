@@ -76,6 +76,7 @@ TEST(BPlusTreeTests, DISABLED_InsertTest1) {
   delete bpm;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
 }
 
 TEST(BPlusTreeTests, DISABLED_InsertTest2) {
@@ -144,5 +145,6 @@ TEST(BPlusTreeTests, DISABLED_InsertTest2) {
   delete bpm;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
 }
 }  // namespace bustub
@@ -10,7 +10,14 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
 #include <cstring>
+#include <filesystem>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "common/exception.h"
 #include "gtest/gtest.h"
@@ -24,12 +31,14 @@ class DiskManagerTest : public ::testing::Test {
   void SetUp() override {
     remove("test.db");
     remove("test.log");
+    remove("test.fsm");
   }
 
   // This function is called after every test.
   void TearDown() override {
     remove("test.db");
     remove("test.log");
+    remove("test.fsm");
   };
 };
 
@@ -55,6 +64,43 @@ TEST_F(DiskManagerTest, ReadWritePageTest) {
   dm.ShutDown();
 }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, ConcurrentReadWritePageTest) {
+  const int num_threads = 4;
+  const int pages_per_thread = 64;
+  std::string db_file("test.db");
+  auto dm = DiskManager(db_file);
+
+  // Every thread writes and reads back its own pages, with no latch between them.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      char buf[PAGE_SIZE];
+      char data[PAGE_SIZE];
+      for (int i = 0; i < pages_per_thread; ++i) {
+        page_id_t page_id = i * num_threads + t;
+        std::memset(data, 'a' + t, sizeof(data));
+        dm.WritePage(page_id, data);
+        dm.ReadPage(page_id, buf);
+        EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(num_threads * pages_per_thread, dm.GetNumWrites());
+
+  // Pages past the end of the file read as zeroes.
+  char buf[PAGE_SIZE];
+  char zeroes[PAGE_SIZE] = {0};
+  std::memset(buf, 'x', sizeof(buf));
+  dm.ReadPage(num_threads * pages_per_thread + 10, buf);
+  EXPECT_EQ(std::memcmp(buf, zeroes, sizeof(buf)), 0);
+
+  dm.ShutDown();
+}
+
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ReadWriteLogTest) {
   char buf[16] = {0};
@@ -72,6 +118,305 @@ TEST_F(DiskManagerTest, ReadWriteLogTest) {
   dm.ShutDown();
 }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, GroupLogSyncTest) {
+  const int num_threads = 8;
+  const int writes_per_thread = 20;
+  std::string db_file("test.db");
+  auto dm = DiskManager(db_file);
+
+  // Every write returns durable, but concurrent writes may share a sync. Each thread alternates between two buffers,
+  // as a log manager swapping its buffers does.
+  std::vector<std::thread> threads;
+  std::vector<std::vector<char>> buffers(2 * num_threads, std::vector<char>(16));
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < writes_per_thread; ++i) {
+        auto &buffer = buffers[2 * t + i % 2];
+        std::snprintf(buffer.data(), buffer.size(), "thread %d", t);
+        dm.WriteLog(buffer.data(), buffer.size());
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(num_threads * writes_per_thread, dm.GetNumFlushes());
+  EXPECT_GE(dm.GetNumFlushes(), dm.GetNumLogSyncs());
+  EXPECT_GT(dm.GetNumLogSyncs(), 0);
+
+  // The writes were appended whole, one after another.
+  char buf[16];
+  for (int i = 0; i < num_threads * writes_per_thread; ++i) {
+    ASSERT_TRUE(dm.ReadLog(buf, sizeof(buf), i * sizeof(buf)));
+    EXPECT_EQ(0, std::strncmp(buf, "thread ", 7));
+  }
+  EXPECT_FALSE(dm.ReadLog(buf, sizeof(buf), num_threads * writes_per_thread * sizeof(buf)));
+
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, PageSyncPolicyTest) {
+  char data[PAGE_SIZE] = {0};
+  std::string db_file("test.db");
+  auto dm = DiskManager(db_file);
+
+  // By default page writes are only made durable by Sync.
+  EXPECT_EQ(PageSyncPolicy::ON_CHECKPOINT, dm.GetPageSyncPolicy());
+  dm.WritePage(0, data);
+  dm.WritePage(1, data);
+  EXPECT_EQ(0, dm.GetNumSyncs());
+  dm.Sync();
+  EXPECT_EQ(1, dm.GetNumSyncs());
+
+  // Otherwise every write, synchronous or not, is synced before it completes.
+  dm.SetPageSyncPolicy(PageSyncPolicy::ON_WRITE);
+  dm.WritePage(2, data);
+  EXPECT_EQ(2, dm.GetNumSyncs());
+  std::atomic<int> done{0};
+  std::vector<PageIoRequest> requests;
+  requests.push_back({true, 3, data, [&] { done = dm.GetNumSyncs(); }});
+  dm.SubmitPageIo(&requests);
+  while (done == 0) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(3, done);
+
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, FreeSpaceMapTest) {
+  std::string db_file("test.db");
+  {
+    auto dm = DiskManager(db_file);
+    EXPECT_EQ(INVALID_PAGE_ID, dm.AllocateFreePage(0));
+    dm.DeallocatePage(9);
+    dm.DeallocatePage(4);
+    dm.DeallocatePage(7);
+    dm.DeallocatePage(4);
+    EXPECT_EQ(3, dm.GetNumFreePages());
+
+    // The map is written out in one go by Sync, not on every change.
+    EXPECT_EQ(0, std::filesystem::file_size("test.fsm"));
+    dm.Sync();
+    EXPECT_EQ(2, std::filesystem::file_size("test.fsm"));
+
+    // Each partition hands out its own lowest page first.
+    dm.PartitionFreePages(2, 1);
+    EXPECT_EQ(7, dm.AllocateFreePage(1));
+    EXPECT_EQ(2, dm.GetNumFreePages());
+    dm.ShutDown();
+  }
+
+  // The map survives a restart.
+  {
+    auto dm = DiskManager(db_file);
+    EXPECT_EQ(2, dm.GetNumFreePages());
+    EXPECT_EQ(4, dm.AllocateFreePage(0));
+    EXPECT_EQ(9, dm.AllocateFreePage(0));
+    EXPECT_EQ(INVALID_PAGE_ID, dm.AllocateFreePage(0));
+    dm.DeallocatePage(1);
+    dm.ShutDown();
+  }
+
+  // But not the database file it describes.
+  remove("test.db");
+  {
+    auto dm = DiskManager(db_file);
+    EXPECT_EQ(0, dm.GetNumFreePages());
+    dm.ShutDown();
+  }
+}
+
+// NOLINTNEXTLINE
+// A page handed out again must not be free on disk after a crash, or it would be handed out a second time
+TEST_F(DiskManagerTest, FreeSpaceMapCrashTest) {
+  std::string db_file("test.db");
+  char data[PAGE_SIZE] = {0};
+  {
+    auto dm = DiskManager(db_file);
+    dm.WritePage(5, data);
+    dm.DeallocatePage(3);
+    dm.DeallocatePage(5);
+    dm.Sync();
+    dm.ShutDown();
+  }
+
+  // The process dies right after reusing a page, without a Sync or ShutDown.
+  EXPECT_EXIT(
+      {
+        auto *dm = new DiskManager(db_file);
+        if (dm->AllocateFreePage(0) == 3) {
+          _exit(0);
+        }
+        _exit(1);
+      },
+      ::testing::ExitedWithCode(0), "");
+
+  auto dm = DiskManager(db_file);
+  EXPECT_EQ(1, dm.GetNumFreePages());
+  EXPECT_EQ(5, dm.AllocateFreePage(0));
+  EXPECT_EQ(INVALID_PAGE_ID, dm.AllocateFreePage(0));
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, CompactTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  std::string db_file("test.db");
+  auto dm = DiskManager(db_file);
+  std::strncpy(data, "A test string.", sizeof(data));
+  for (page_id_t page_id = 0; page_id < 8; ++page_id) {
+    dm.WritePage(page_id, data);
+  }
+  dm.DeallocatePage(2);
+  dm.DeallocatePage(6);
+  dm.DeallocatePage(7);
+
+  // Pages 6 and 7 are cut off the end; page 2 becomes a hole where the file system supports it.
+  EXPECT_GE(dm.Compact(), 2);
+  struct stat stat_buf;
+  ASSERT_EQ(0, stat("test.db", &stat_buf));
+  EXPECT_EQ(6 * PAGE_SIZE, stat_buf.st_size);
+
+  // The pages in use are untouched and the free ones are still free.
+  for (page_id_t page_id : {0, 1, 3, 4, 5}) {
+    dm.ReadPage(page_id, buf);
+    EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  }
+  EXPECT_EQ(3, dm.GetNumFreePages());
+
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, AsyncPageIoTest) {
+  for (auto backend : {AsyncIoBackend::THREAD_POOL, AsyncIoBackend::IO_URING}) {
+    remove("test.db");
+    std::string db_file("test.db");
+    auto dm = DiskManager(db_file, backend);
+    // More pages than the io_uring queue depth, so that some requests wait for a free slot.
+    const page_id_t num_pages = 3 * ASYNC_IO_QUEUE_DEPTH;
+    std::vector<std::vector<char>> pages(num_pages, std::vector<char>(PAGE_SIZE));
+    std::atomic<int> done{0};
+
+    std::vector<PageIoRequest> requests;
+    for (page_id_t page_id = 0; page_id < num_pages; ++page_id) {
+      std::snprintf(pages[page_id].data(), PAGE_SIZE, "page %d", page_id);
+      requests.push_back({true, page_id, pages[page_id].data(), [&] { ++done; }});
+    }
+    dm.SubmitPageIo(&requests);
+    // Sync returns only once the writes submitted before it have landed.
+    dm.Sync();
+    std::vector<char> buf(PAGE_SIZE);
+    for (page_id_t page_id = 0; page_id < num_pages; ++page_id) {
+      dm.ReadPage(page_id, buf.data());
+      EXPECT_EQ(0, std::memcmp(buf.data(), pages[page_id].data(), PAGE_SIZE));
+    }
+    while (done < num_pages) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ(num_pages, dm.GetNumWrites());
+
+    // Read everything back, plus a page past the end of the file, which reads as zeroes. The reads are submitted from
+    // a callback, as follow-up I/O is.
+    std::vector<std::vector<char>> buffers(num_pages + 1, std::vector<char>(PAGE_SIZE, 'x'));
+    done = 0;
+    requests.clear();
+    requests.push_back({false, 0, buffers[0].data(), [&] {
+                          std::vector<PageIoRequest> follow_up;
+                          for (page_id_t page_id = 1; page_id <= num_pages; ++page_id) {
+                            follow_up.push_back({false, page_id, buffers[page_id].data(), [&] { ++done; }});
+                          }
+                          dm.SubmitPageIo(&follow_up);
+                          ++done;
+                        }});
+    dm.SubmitPageIo(&requests);
+    while (done < num_pages + 1) {
+      std::this_thread::yield();
+    }
+    for (page_id_t page_id = 0; page_id < num_pages; ++page_id) {
+      EXPECT_EQ(0, std::memcmp(buffers[page_id].data(), pages[page_id].data(), PAGE_SIZE));
+    }
+    EXPECT_EQ(std::vector<char>(PAGE_SIZE, 0), buffers[num_pages]);
+
+    dm.ShutDown();
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, DirectIoTest) {
+  std::string db_file("test.db");
+  auto dm = DiskManager(db_file, AsyncIoBackend::IO_URING, true);
+  if (!dm.IsDirectIo()) {
+    dm.ShutDown();
+    GTEST_SKIP() << "O_DIRECT is not supported here";
+  }
+
+  // Aligned buffers go straight to the disk; unaligned ones, like these stack buffers, are bounced.
+  struct AlignedPage {
+    alignas(DIRECT_IO_ALIGNMENT) char data_[PAGE_SIZE];
+  };
+  auto aligned = std::make_unique<AlignedPage>();
+  std::vector<char> unaligned_buf(PAGE_SIZE + 1);
+  char *unaligned = unaligned_buf.data() + 1;
+  std::strncpy(aligned->data_, "An aligned page.", PAGE_SIZE);
+  std::strncpy(unaligned, "An unaligned page.", PAGE_SIZE);
+  dm.WritePage(0, aligned->data_);
+  dm.WritePage(1, unaligned);
+
+  char buf[PAGE_SIZE] = {0};
+  dm.ReadPage(0, unaligned);
+  EXPECT_STREQ("An aligned page.", unaligned);
+  dm.ReadPage(1, aligned->data_);
+  EXPECT_STREQ("An unaligned page.", aligned->data_);
+
+  // Asynchronous I/O takes care of unaligned buffers as well.
+  std::atomic<bool> done{false};
+  std::vector<PageIoRequest> requests;
+  requests.push_back({false, 0, unaligned, [&] { done = true; }});
+  dm.SubmitPageIo(&requests);
+  while (!done) {
+    std::this_thread::yield();
+  }
+  EXPECT_STREQ("An aligned page.", unaligned);
+
+  // A page past the end of the file still reads as zeroes.
+  std::memset(buf, 'x', sizeof(buf));
+  dm.ReadPage(5, buf);
+  EXPECT_EQ(std::vector<char>(PAGE_SIZE, 0), std::vector<char>(buf, buf + PAGE_SIZE));
+
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, DestructorShutDownTest) {
+  auto count_fds = [] {
+    size_t count = 0;
+    for ([[maybe_unused]] const auto &entry : std::filesystem::directory_iterator("/proc/self/fd")) {
+      ++count;
+    }
+    return count;
+  };
+  size_t fds = count_fds();
+  {
+    // A disk manager that is shut down twice, or not at all, closes its files once.
+    auto dm = DiskManager("test.db");
+    char data[PAGE_SIZE] = {0};
+    dm.WritePage(0, data);
+    dm.ShutDown();
+    dm.ShutDown();
+  }
+  {
+    auto dm = DiskManager("test.db");
+    EXPECT_LT(fds, count_fds());
+  }
+  EXPECT_EQ(fds, count_fds());
+}
+
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ThrowBadFileTest) { EXPECT_THROW(DiskManager("dev/null\\/foo/bar/baz/test.db"), Exception); }
 
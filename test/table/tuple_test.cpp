@@ -14,6 +14,7 @@
 #include <cstdio>
 #include <iostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "buffer/buffer_pool_manager_instance.h"
@@ -71,4 +72,84 @@ TEST(TupleTest, DISABLED_TableHeapTest) {
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+// Check that a scan reads ahead along its table's chain of pages, not the pages with the ids that follow
+TEST(TupleTest, TableHeapReadAheadTest) {
+  const size_t buffer_pool_size = 20;
+  const int tuples_per_table = 60;
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}, Column{"b", TypeId::VARCHAR, 1000}}};
+  auto make_tuple = [&](int i) {
+    return Tuple{std::vector<Value>{Value(TypeId::INTEGER, i), Value(TypeId::VARCHAR, std::string(1000, 'x'))},
+                 &schema};
+  };
+
+  auto *disk_manager = new DiskManager("test.db");
+  auto *lock_manager = new LockManager();
+  auto *transaction = new Transaction(0);
+
+  // Scenario: two tables filled at the same time get interleaved pages.
+  auto *buffer_pool_manager = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+  auto *first = new TableHeap(buffer_pool_manager, lock_manager, nullptr, transaction);
+  auto *second = new TableHeap(buffer_pool_manager, lock_manager, nullptr, transaction);
+  std::vector<page_id_t> first_pages;
+  std::vector<page_id_t> second_pages;
+  for (int i = 0; i < tuples_per_table; ++i) {
+    RID rid;
+    ASSERT_TRUE(first->InsertTuple(make_tuple(i), &rid, transaction));
+    if (first_pages.empty() || first_pages.back() != rid.GetPageId()) {
+      first_pages.push_back(rid.GetPageId());
+    }
+    ASSERT_TRUE(second->InsertTuple(make_tuple(i), &rid, transaction));
+    if (second_pages.empty() || second_pages.back() != rid.GetPageId()) {
+      second_pages.push_back(rid.GetPageId());
+    }
+  }
+  ASSERT_GT(first_pages.size(), 4);
+  EXPECT_EQ(first_pages[0] + 2, first_pages[1]);
+  buffer_pool_manager->FlushAllPages();
+  auto first_page_id = first->GetFirstPageId();
+  delete first;
+  delete second;
+  delete buffer_pool_manager;
+
+  // Scenario: scanning the first table from a cold pool keeps the next page of its chain in flight and never reads a
+  // page of the second table.
+  buffer_pool_manager = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+  first = new TableHeap(buffer_pool_manager, lock_manager, nullptr, first_page_id);
+  auto is_resident = [&](page_id_t page_id) {
+    for (size_t i = 0; i < buffer_pool_size; ++i) {
+      if (buffer_pool_manager->GetPages()[i].GetPageId() == page_id) {
+        return true;
+      }
+    }
+    return false;
+  };
+  std::unordered_map<page_id_t, page_id_t> next_pages;
+  for (size_t i = 0; i + 1 < first_pages.size(); ++i) {
+    next_pages[first_pages[i]] = first_pages[i + 1];
+  }
+  BufferAccessStrategy strategy(8, 2);
+  int i = 0;
+  for (auto itr = first->Begin(transaction, &strategy); itr != first->End(); ++itr, ++i) {
+    EXPECT_EQ(i, itr->GetValue(&schema, 0).GetAs<int32_t>());
+    if (i > 0 && next_pages.count(itr->GetRid().GetPageId()) > 0) {
+      EXPECT_TRUE(is_resident(next_pages[itr->GetRid().GetPageId()]));
+    }
+    for (auto page_id : second_pages) {
+      EXPECT_FALSE(is_resident(page_id));
+    }
+  }
+  EXPECT_EQ(tuples_per_table, i);
+
+  delete first;
+  delete buffer_pool_manager;
+  delete transaction;
+  delete lock_manager;
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+  delete disk_manager;
+}
+
 }  // namespace bustub